@@ -23,13 +23,22 @@ NOTE: NimBLE addresses are in INVERSE ORDER!
 We will accomodate that fact in these methods.
 *************************************************/
 
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "NimBLEAddress::getNative() relies on a little endian target"
+#endif
+
+
 /**
  * @brief Create an address from the native ESP32 representation.
- * @param [in] address The native representation.
+ * @param [in] address The native representation, its type is kept.
  */
-NimBLEAddress::NimBLEAddress(ble_addr_t address) {
-    memcpy(m_address, address.val, 6);
-} // BLEAddress
+NimBLEAddress::NimBLEAddress(const ble_addr_t &address) {
+    m_address = 0;
+    for(int i = 5; i >= 0; i--) {
+        m_address = (m_address << 8) | address.val[i];
+    }
+    m_address |= (uint64_t)address.type << 48;
+} // NimBLEAddress
 
 
 /**
@@ -42,49 +51,85 @@ NimBLEAddress::NimBLEAddress(ble_addr_t address) {
  * which is 17 characters in length.
  *
  * @param [in] stringAddress The hex representation of the address.
+ * @param [in] type The address type.
  */
-NimBLEAddress::NimBLEAddress(std::string stringAddress) {
+NimBLEAddress::NimBLEAddress(std::string stringAddress, uint8_t type) {
+    m_address = (uint64_t)type << 48;
     if (stringAddress.length() != 17) return;
 
     int data[6];
     sscanf(stringAddress.c_str(), "%x:%x:%x:%x:%x:%x", &data[5], &data[4], &data[3], &data[2], &data[1], &data[0]);
-    m_address[0] = (uint8_t) data[0];
-    m_address[1] = (uint8_t) data[1];
-    m_address[2] = (uint8_t) data[2];
-    m_address[3] = (uint8_t) data[3];
-    m_address[4] = (uint8_t) data[4];
-    m_address[5] = (uint8_t) data[5];
-} // BLEAddress
+    for(int i = 5; i >= 0; i--) {
+        m_address |= (uint64_t)(uint8_t)data[i] << (8 * i);
+    }
+} // NimBLEAddress
 
 
 /**
  * @brief Constructor for compatibility with bluedrioid esp library.
- * @param [in] esp_bd_addr_t struct containing the address.
+ * @param [in] esp_bd_addr_t struct containing the address, most significant byte first.
+ * @param [in] type The address type.
  */
-NimBLEAddress::NimBLEAddress(esp_bd_addr_t address) {
-    NimBLEUtils::memrcpy(m_address, address, 6);
+NimBLEAddress::NimBLEAddress(esp_bd_addr_t address, uint8_t type) {
+    m_address = (uint64_t)type << 48;
+    for(int i = 0; i < ESP_BD_ADDR_LEN; i++) {
+        m_address |= (uint64_t)address[i] << (8 * (ESP_BD_ADDR_LEN - 1 - i));
+    }
 } // NimBLEAddress
 
 
 /**
- * @brief Determine if this address equals another.
+ * @brief Determine if this address equals another, ignoring the address types.
+ * Use == to also compare the types.
  * @param [in] otherAddress The other address to compare against.
  * @return True if the addresses are equal.
  */
-bool NimBLEAddress::equals(NimBLEAddress otherAddress) {
-    return memcmp(otherAddress.getNative(), m_address, 6) == 0;
+bool NimBLEAddress::equals(const NimBLEAddress &otherAddress) const {
+    return (uint64_t)*this == (uint64_t)otherAddress;
 } // equals
 
 
 /**
  * @brief Return the native representation of the address.
- * @return The native representation of the address.
+ * @return A pointer to the 6 address bytes in native (little endian) order.
  */
 uint8_t *NimBLEAddress::getNative() {
-    return m_address;
+    return reinterpret_cast<uint8_t*>(&m_address);
 } // getNative
 
 
+/**
+ * @brief Get the address in the host stack representation.
+ * @return The address and its type.
+ */
+ble_addr_t NimBLEAddress::getBase() const {
+    ble_addr_t addr;
+    addr.type = getType();
+    for(int i = 0; i < 6; i++) {
+        addr.val[i] = (uint8_t)(m_address >> (8 * i));
+    }
+    return addr;
+} // getBase
+
+
+/**
+ * @brief Get the type of the address.
+ * @return BLE_ADDR_PUBLIC, BLE_ADDR_RANDOM, BLE_ADDR_PUBLIC_ID or BLE_ADDR_RANDOM_ID.
+ */
+uint8_t NimBLEAddress::getType() const {
+    return (uint8_t)(m_address >> 48);
+} // getType
+
+
+/**
+ * @brief Convert the address to a 48 bit integer without its type, e.g. to use it as a key.
+ * @return The address with the most significant byte first, as written by toString().
+ */
+NimBLEAddress::operator uint64_t() const {
+    return m_address & 0xFFFFFFFFFFFFULL;
+} // operator uint64_t
+
+
 /**
  * @brief Convert a BLE address to a string.
  *
@@ -96,13 +141,27 @@ uint8_t *NimBLEAddress::getNative() {
  *
  * @return The string representation of the address.
  */
-std::string NimBLEAddress::toString() {
-    auto size = 18;
-    char *res = (char*)malloc(size);
-    snprintf(res, size, "%02x:%02x:%02x:%02x:%02x:%02x", m_address[5], m_address[4], m_address[3], m_address[2], m_address[1], m_address[0]);
-    std::string ret(res);
-    free(res);
-    return ret;
-    
+std::string NimBLEAddress::toString() const {
+    char buf[NIMBLE_ADDRESS_STR_LEN];
+    return std::string(toString(buf));
+} // toString
+
+
+/**
+ * @brief Format the address into a caller buffer, without allocating.
+ * @param [out] buf A buffer of at least NIMBLE_ADDRESS_STR_LEN bytes.
+ * @return buf, holding the address in the format xx:xx:xx:xx:xx:xx.
+ */
+char* NimBLEAddress::toString(char* buf) const {
+    static const char hex[] = "0123456789abcdef";
+    char* p = buf;
+
+    for(int i = 5; i >= 0; i--) {
+        uint8_t byte = (uint8_t)(m_address >> (8 * i));
+        *p++ = hex[byte >> 4];
+        *p++ = hex[byte & 0x0F];
+        *p++ = i > 0 ? ':' : '\0';
+    }
+    return buf;
 } // toString
 #endif
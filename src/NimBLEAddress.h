@@ -20,6 +20,7 @@
 #include "nimble/ble.h"
 
 #include <string>
+#include <functional>
 
 typedef enum {
     BLE_ADDR_TYPE_PUBLIC        = 0x00,
@@ -36,24 +37,65 @@ typedef uint8_t esp_ble_addr_type_t ;
 /// Bluetooth device address
 typedef uint8_t esp_bd_addr_t[ESP_BD_ADDR_LEN];
 
+/// Size of the buffer needed by NimBLEAddress::toString(char*), including the terminator.
+#define NIMBLE_ADDRESS_STR_LEN 18
+
 
 /**
  * @brief A %BLE device address.
  *
  * Every %BLE device has a unique address which can be used to identify it and form connections.
+ * The address and its type are packed in one 64 bit value, the address in the low 48 bits in
+ * native (little endian) order and the type above it, so copying, comparing and hashing an
+ * address are integer operations.
  */
 class NimBLEAddress {
 public:
-    NimBLEAddress(ble_addr_t address);
-    NimBLEAddress(esp_bd_addr_t address);
-    NimBLEAddress(std::string stringAddress);
-    bool           equals(NimBLEAddress otherAddress);
+    /**
+     * @brief Create a null public address.
+     */
+    constexpr NimBLEAddress() : m_address(0) {}
+    /**
+     * @brief Create an address from its 48 bit value, e.g. NimBLEAddress(0xA4C138000001).
+     * @param [in] address The address with the most significant byte first, as written by toString().
+     * @param [in] type The address type.
+     */
+    constexpr explicit NimBLEAddress(uint64_t address, uint8_t type = BLE_ADDR_PUBLIC)
+        : m_address((address & 0xFFFFFFFFFFFFULL) | ((uint64_t)type << 48)) {}
+    NimBLEAddress(const ble_addr_t &address);
+    NimBLEAddress(esp_bd_addr_t address, uint8_t type = BLE_ADDR_PUBLIC);
+    NimBLEAddress(std::string stringAddress, uint8_t type = BLE_ADDR_PUBLIC);
+    bool           equals(const NimBLEAddress &otherAddress) const;
     uint8_t*       getNative();
-    std::string    toString();
+    ble_addr_t     getBase() const;
+    uint8_t        getType() const;
+    /**
+     * @brief Get the packed address and type, e.g. to use it as a key.
+     */
+    constexpr uint64_t getKey() const { return m_address; }
+    std::string    toString() const;
+    char*          toString(char* buf) const;
+    operator       uint64_t() const;
+
+    constexpr bool operator==(const NimBLEAddress &other) const { return m_address == other.m_address; }
+    constexpr bool operator!=(const NimBLEAddress &other) const { return m_address != other.m_address; }
+    constexpr bool operator<(const NimBLEAddress &other) const { return m_address < other.m_address; }
 
 private:
-    uint8_t        m_address[6];
+    uint64_t       m_address;
+};
+
+
+namespace std {
+/**
+ * @brief Hash of an address for the unordered containers.
+ */
+template<> struct hash<NimBLEAddress> {
+    size_t operator()(const NimBLEAddress &address) const {
+        return std::hash<uint64_t>()(address.getKey());
+    }
 };
+}
 
 #endif /* CONFIG_BT_ENABLED */
 #endif /* COMPONENTS_NIMBLEADDRESS_H_ */
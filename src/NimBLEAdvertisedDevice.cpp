@@ -35,25 +35,40 @@ static const char* LOG_TAG = "NimBLEAdvertisedDevice";
  * @brief Constructor
  */
 NimBLEAdvertisedDevice::NimBLEAdvertisedDevice() {
+    reset();
+} // NimBLEAdvertisedDevice
+
+
+/**
+ * @brief Forget the device so it can be reused for another one, the payload storage is kept.
+ */
+void NimBLEAdvertisedDevice::reset() {
+    m_address          = NimBLEAddress();
     m_advType          = 0;
-    m_appearance       = 0;
     m_deviceType       = 0;
-    m_manufacturerData = "";
-    m_name             = "";
     m_rssi             = -9999;
-    m_serviceData      = "";
-    m_txPower          = 0;
     m_pScan            = nullptr;
+    m_addressType      = 0;
+    m_advLength        = 0;
+    m_payloadLength    = 0;
+    m_primPhy          = BLE_HCI_LE_PHY_1M;
+    m_secPhy           = 0;
+    m_sid              = 0xFF;
+    m_lastSeen         = 0;
 
-    m_haveAppearance       = false;
-    m_haveManufacturerData = false;
-    m_haveName             = false;
-    m_haveRSSI             = false;
-    m_haveServiceData      = false;
-    m_haveServiceUUID      = false;
-    m_haveTXPower          = false;
+    m_haveRSSI         = false;
+} // reset
 
-} // NimBLEAdvertisedDevice
+
+/**
+ * @brief Set the size of the payload storage, the stored payload is discarded.
+ * @param [in] size The room for the advertisement and scan response data.
+ */
+void NimBLEAdvertisedDevice::allocatePayload(uint16_t size) {
+    std::vector<uint8_t>(size).swap(m_payload);
+    m_advLength = 0;
+    m_payloadLength = 0;
+} // allocatePayload
 
 
 /**
@@ -78,7 +93,13 @@ NimBLEAddress NimBLEAdvertisedDevice::getAddress() {
  * @return The appearance of the advertised device.
  */
 uint16_t NimBLEAdvertisedDevice::getAppearance() {
-    return m_appearance;
+    uint8_t length;
+    const uint8_t* data = findField(BLE_HS_ADV_TYPE_APPEARANCE, &length);
+    if(data == nullptr || length < BLE_HS_ADV_APPEARANCE_LEN) {
+        return 0;
+    }
+
+    return data[0] | (data[1] << 8);
 } // getAppearance
 
 
@@ -87,16 +108,31 @@ uint16_t NimBLEAdvertisedDevice::getAppearance() {
  * @return The manufacturer data of the advertised device.
  */
 std::string NimBLEAdvertisedDevice::getManufacturerData() {
-    return m_manufacturerData;
+    uint8_t length;
+    const uint8_t* data = findField(BLE_HS_ADV_TYPE_MFG_DATA, &length);
+    if(data == nullptr) {
+        return "";
+    }
+
+    return std::string((const char*)data, length);
 } // getManufacturerData
 
 
 /**
  * @brief Get the name.
- * @return The name of the advertised device.
+ * @return The complete name of the advertised device, or the shortened name if that is all it advertises.
  */
 std::string NimBLEAdvertisedDevice::getName() {
-    return m_name;
+    uint8_t length;
+    const uint8_t* data = findField(BLE_HS_ADV_TYPE_COMP_NAME, &length);
+    if(data == nullptr) {
+        data = findField(BLE_HS_ADV_TYPE_INCOMP_NAME, &length);
+    }
+    if(data == nullptr) {
+        return "";
+    }
+
+    return std::string((const char*)data, length);
 } // getName
 
 
@@ -123,7 +159,14 @@ NimBLEScan* NimBLEAdvertisedDevice::getScan() {
  * @return The ServiceData of the advertised device.
  */
 std::string NimBLEAdvertisedDevice::getServiceData() {
-    return m_serviceData;
+    uint8_t uuidLength;
+    uint8_t length;
+    const uint8_t* data = findServiceData(&uuidLength, &length);
+    if(data == nullptr) {
+        return "";
+    }
+
+    return std::string((const char*)data + uuidLength, length - uuidLength);
 } //getServiceData
 
 
@@ -133,28 +176,56 @@ std::string NimBLEAdvertisedDevice::getServiceData() {
  */
  
 NimBLEUUID NimBLEAdvertisedDevice::getServiceDataUUID() {
-    return m_serviceDataUUID;
+    uint8_t uuidLength;
+    uint8_t length;
+    const uint8_t* data = findServiceData(&uuidLength, &length);
+    if(data == nullptr) {
+        return NimBLEUUID();
+    }
+
+    if(uuidLength == 2) {
+        return NimBLEUUID((uint16_t)(data[0] | (data[1] << 8)));
+    }
+    if(uuidLength == 4) {
+        return NimBLEUUID((uint32_t)(data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24)));
+    }
+    return NimBLEUUID((uint8_t*)data, 16, false);
 } // getServiceDataUUID
 
 
 /**
- * @brief Get the Service UUID.
- * @return The Service UUID of the advertised device.
+ * @brief Get a Service UUID.
+ * @param [in] index The position of the UUID in the advertised list, the first one by default.
+ * @return The Service UUID of the advertised device, a blank UUID if there is none at that index.
  */
- 
-NimBLEUUID NimBLEAdvertisedDevice::getServiceUUID() {  //TODO Remove it eventually, is no longer useful
-    return m_serviceUUIDs[0];
+NimBLEUUID NimBLEAdvertisedDevice::getServiceUUID(uint8_t index) {
+    NimBLEUUID uuid;
+    findServiceUUID(index, &uuid);
+    return uuid;
 } // getServiceUUID
 
 
+/**
+ * @brief Get the number of advertised Service UUIDs.
+ * @return The number of Service UUIDs of all sizes in the advertisement and scan response.
+ */
+uint8_t NimBLEAdvertisedDevice::getServiceUUIDCount() {
+    uint8_t count = 0;
+    while(findServiceUUID(count, nullptr)) {
+        count++;
+    }
+    return count;
+} // getServiceUUIDCount
+
+
 /**
  * @brief Check advertised serviced for existence required UUID
  * @return Return true if service is advertised
  */
 bool NimBLEAdvertisedDevice::isAdvertisingService(NimBLEUUID uuid){
-    for (int i = 0; i < m_serviceUUIDs.size(); i++) {
-        NIMBLE_LOGI(LOG_TAG, "Comparing UUIDS: %s %s", m_serviceUUIDs[i].toString().c_str(), uuid.toString().c_str());
-        if (m_serviceUUIDs[i].equals(uuid)) return true;
+    NimBLEUUID advUuid;
+    for (uint8_t i = 0; findServiceUUID(i, &advUuid); i++) {
+        if (advUuid.equals(uuid)) return true;
     }
     return false;
 }
@@ -165,7 +236,13 @@ bool NimBLEAdvertisedDevice::isAdvertisingService(NimBLEUUID uuid){
  * @return The TX Power of the advertised device.
  */
 int8_t NimBLEAdvertisedDevice::getTXPower() {
-    return m_txPower;
+    uint8_t length;
+    const uint8_t* data = findField(BLE_HS_ADV_TYPE_TX_PWR_LVL, &length);
+    if(data == nullptr || length < BLE_HS_ADV_TX_PWR_LVL_LEN) {
+        return 0;
+    }
+
+    return (int8_t)data[0];
 } // getTXPower
 
 
@@ -174,7 +251,8 @@ int8_t NimBLEAdvertisedDevice::getTXPower() {
  * @return True if there is an appearance value present.
  */
 bool NimBLEAdvertisedDevice::haveAppearance() {
-    return m_haveAppearance;
+    uint8_t length;
+    return findField(BLE_HS_ADV_TYPE_APPEARANCE, &length) != nullptr;
 } // haveAppearance
 
 
@@ -183,7 +261,8 @@ bool NimBLEAdvertisedDevice::haveAppearance() {
  * @return True if there is manufacturer data present.
  */
 bool NimBLEAdvertisedDevice::haveManufacturerData() {
-    return m_haveManufacturerData;
+    uint8_t length;
+    return findField(BLE_HS_ADV_TYPE_MFG_DATA, &length) != nullptr;
 } // haveManufacturerData
 
 
@@ -192,7 +271,9 @@ bool NimBLEAdvertisedDevice::haveManufacturerData() {
  * @return True if there is a name value present.
  */
 bool NimBLEAdvertisedDevice::haveName() {
-    return m_haveName;
+    uint8_t length;
+    return findField(BLE_HS_ADV_TYPE_COMP_NAME, &length) != nullptr ||
+           findField(BLE_HS_ADV_TYPE_INCOMP_NAME, &length) != nullptr;
 } // haveName
 
 
@@ -210,7 +291,9 @@ bool NimBLEAdvertisedDevice::haveRSSI() {
  * @return True if there is a service data value present.
  */
 bool NimBLEAdvertisedDevice::haveServiceData() {
-    return m_haveServiceData;
+    uint8_t uuidLength;
+    uint8_t length;
+    return findServiceData(&uuidLength, &length) != nullptr;
 } // haveServiceData
 
 
@@ -219,7 +302,7 @@ bool NimBLEAdvertisedDevice::haveServiceData() {
  * @return True if there is a service UUID value present.
  */
 bool NimBLEAdvertisedDevice::haveServiceUUID() {
-    return m_haveServiceUUID;
+    return findServiceUUID(0, nullptr);
 } // haveServiceUUID
 
 
@@ -228,139 +311,104 @@ bool NimBLEAdvertisedDevice::haveServiceUUID() {
  * @return True if there is a transmission power value present.
  */
 bool NimBLEAdvertisedDevice::haveTXPower() {
-    return m_haveTXPower;
+    uint8_t length;
+    return findField(BLE_HS_ADV_TYPE_TX_PWR_LVL, &length) != nullptr;
 } // haveTXPower
 
 
 /**
- * @brief Parse the advertising pay load.
- *
- * The pay load is a buffer of bytes that is either 31 bytes long or terminated by
- * a 0 length value.  Each entry in the buffer has the format:
- * [length][type][data...]
- *
- * The length does not include itself but does include everything after it until the next record.  A record
- * with a length value of 0 indicates a terminator.
+ * @brief Find a field in the advertising pay load.
  *
+ * The pay load is the advertisement data followed by the scan response data.
  * https://www.bluetooth.com/specifications/assigned-numbers/generic-access-profile
+ *
+ * @param [in] type The AD type to look for.
+ * @param [out] length The length of the field data.
+ * @return A pointer to the data of the first field of that type or nullptr if not present.
  */
- void NimBLEAdvertisedDevice::parseAdvertisement(ble_hs_adv_fields *fields) {
-    //char s[BLE_HS_ADV_MAX_SZ];
-    uint8_t *u8p;
-    uint8_t length;
-    int i;
+const uint8_t* NimBLEAdvertisedDevice::findField(uint8_t type, uint8_t* length) {
+    return NimBLEUtils::findAdvField(m_payload.data(), m_payloadLength, type, length);
+} // findField
 
-    if (fields->uuids16 != NULL) {
-        for (i = 0; i < fields->num_uuids16; i++) {
-            setServiceUUID(NimBLEUUID(fields->uuids16[i].value));
-        }
-    }
-
-    if (fields->uuids32 != NULL) {
-        for (i = 0; i < fields->num_uuids32; i++) {
-            setServiceUUID(NimBLEUUID(fields->uuids32[i].value));
-        }
-    }
-
-    if (fields->uuids128 != NULL) {
-        for (i = 0; i < fields->num_uuids128; i++) {
-            setServiceUUID(NimBLEUUID(&fields->uuids128[i]));
-        }
-    }
 
-    if (fields->name != NULL) {
-        setName(std::string(reinterpret_cast<char*>(fields->name), fields->name_len));
-    }
-
-    if (fields->tx_pwr_lvl_is_present) {
-        setTXPower(fields->tx_pwr_lvl);
-    }
-
-    if (fields->svc_data_uuid16 != NULL) {
+/**
+ * @brief Find the service data field, for a 16, 32 or 128 bit UUID.
+ * @param [out] uuidLength The length of the UUID at the start of the field data.
+ * @param [out] length The length of the field data including the UUID.
+ * @return A pointer to the field data or nullptr if not present.
+ */
+const uint8_t* NimBLEAdvertisedDevice::findServiceData(uint8_t* uuidLength, uint8_t* length) {
+    static const uint8_t types[] = {BLE_HS_ADV_TYPE_SVC_DATA_UUID16,
+                                    BLE_HS_ADV_TYPE_SVC_DATA_UUID32,
+                                    BLE_HS_ADV_TYPE_SVC_DATA_UUID128};
+    static const uint8_t uuidLengths[] = {2, 4, 16};
 
-        u8p = fields->svc_data_uuid16;
-        length = fields->svc_data_uuid16_len;
-        
-        if (length < 2) {
-            NIMBLE_LOGE(LOG_TAG,"Length too small for ESP_BLE_AD_TYPE_SERVICE_DATA");
-        }
-        else{
-            uint16_t uuid = *(uint16_t*)u8p;
-            setServiceDataUUID(NimBLEUUID(uuid));
-            if (length > 2) {
-                setServiceData(std::string(reinterpret_cast<char*>(u8p + 2), length - 2));
-            }
+    for(int i = 0; i < 3; i++) {
+        const uint8_t* data = findField(types[i], length);
+        if(data != nullptr && *length >= uuidLengths[i]) {
+            *uuidLength = uuidLengths[i];
+            return data;
         }
     }
 
-    if (fields->svc_data_uuid32 != NULL) {
+    return nullptr;
+} // findServiceData
 
-        u8p = fields->svc_data_uuid16;
-        length = fields->svc_data_uuid16_len;
-        
-        if (length < 4) {
-            NIMBLE_LOGE(LOG_TAG,"Length too small for ESP_BLE_AD_TYPE_32SERVICE_DATA");
-        }
-        
-        uint32_t uuid = *(uint32_t*) u8p;
-        setServiceDataUUID(NimBLEUUID(uuid));
-        if (length > 4) {
-            setServiceData(std::string(reinterpret_cast<char*>(u8p + 4), length - 4));
-        }
-    }
-    
-    if (fields->svc_data_uuid128 != NULL) {
 
-        u8p = fields->svc_data_uuid16;
-        length = fields->svc_data_uuid16_len;
-        
-        if (length < 16) {
-            NIMBLE_LOGE(LOG_TAG,"Length too small for ESP_BLE_AD_TYPE_128SERVICE_DATA");
+/**
+ * @brief Find an advertised service UUID.
+ *
+ * The 16, 32 and 128 bit UUID lists, complete or not, are searched in the order they appear.
+ *
+ * @param [in] index The position of the UUID in the advertised lists.
+ * @param [out] uuid The UUID found, may be nullptr to only check that it exists.
+ * @return True if there is a UUID at that index.
+ */
+bool NimBLEAdvertisedDevice::findServiceUUID(uint8_t index, NimBLEUUID* uuid) {
+    size_t pos = 0;
+    uint8_t type;
+    uint8_t fieldLength;
+    const uint8_t* field;
+
+    while((field = NimBLEUtils::nextAdvField(m_payload.data(), m_payloadLength, &pos, &type, &fieldLength)) != nullptr) {
+        uint8_t size;
+        switch(type) {
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS16:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS16:
+                size = 2;
+                break;
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS32:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS32:
+                size = 4;
+                break;
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS128:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS128:
+                size = 16;
+                break;
+            default:
+                continue;
         }
 
-        setServiceDataUUID(NimBLEUUID(u8p, (size_t)16, false));
-        if (length > 16) {
-            setServiceData(std::string(reinterpret_cast<char*>(u8p + 16), length - 16));
-        }
-    }
-
-    if (fields->appearance_is_present) {
-        NIMBLE_LOGD(LOG_TAG, "    appearance=0x%04x", fields->appearance);
-        setAppearance(fields->appearance);
-    }
-    
-/**** TODO: create storage and fucntions for these parameters
-    if (fields->public_tgt_addr != NULL) {
-        NIMBLE_LOGD(LOG_TAG, "    public_tgt_addr=");
-        u8p = fields->public_tgt_addr;
-        for (i = 0; i < fields->num_public_tgt_addrs; i++) {
-            NIMBLE_LOGD(LOG_TAG, "public_tgt_addr=%s ", addr_str(u8p));
-            u8p += BLE_HS_ADV_PUBLIC_TGT_ADDR_ENTRY_LEN;
+        uint8_t count = fieldLength / size;
+        if(index < count) {
+            if(uuid != nullptr) {
+                const uint8_t* data = field + index * size;
+                if(size == 2) {
+                    *uuid = NimBLEUUID((uint16_t)(data[0] | (data[1] << 8)));
+                } else if(size == 4) {
+                    *uuid = NimBLEUUID((uint32_t)(data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24)));
+                } else {
+                    *uuid = NimBLEUUID((uint8_t*)data, 16, false);
+                }
+            }
+            return true;
         }
-        NIMBLE_LOGD(LOG_TAG, "\n");
-    }
-    
-    if (fields->slave_itvl_range != NULL) {
-        NIMBLE_LOGD(LOG_TAG, "    slave_itvl_range=");
-        print_bytes(fields->slave_itvl_range, BLE_HS_ADV_SLAVE_ITVL_RANGE_LEN);
-        NIMBLE_LOGD(LOG_TAG, "\n");
+        index -= count;
     }
 
-    if (fields->adv_itvl_is_present) {
-        NIMBLE_LOGD(LOG_TAG, "    adv_itvl=0x%04x\n", fields->adv_itvl);
-    }
+    return false;
+} // findServiceUUID
 
-    if (fields->uri != NULL) {
-        NIMBLE_LOGD(LOG_TAG, "    uri=");
-        print_bytes(fields->uri, fields->uri_len);
-        NIMBLE_LOGD(LOG_TAG, "\n");
-    }
-*/
-    if (fields->mfg_data != NULL) {
-        setManufacturerData(std::string(reinterpret_cast<char*>(fields->mfg_data), fields->mfg_data_len));
-    }
- } //parseAdvertisement
- 
 
 /**
  * @brief Set the address of the advertised device.
@@ -380,42 +428,6 @@ void NimBLEAdvertisedDevice::setAdvType(uint8_t advType) {
 } // setAdvType
 
 
-/**
- * @brief Set the appearance for this device.
- * @param [in] The discovered appearance.
- */
-void NimBLEAdvertisedDevice::setAppearance(uint16_t appearance) {
-    m_appearance     = appearance;
-    m_haveAppearance = true;
-    NIMBLE_LOGD(LOG_TAG,"- appearance: %d", m_appearance);
-} // setAppearance
-
-
-/**
- * @brief Set the manufacturer data for this device.
- * @param [in] The discovered manufacturer data.
- */
-void NimBLEAdvertisedDevice::setManufacturerData(std::string manufacturerData) {
-    m_manufacturerData     = manufacturerData;
-    m_haveManufacturerData = true;
-
-    char* pHex = NimBLEUtils::buildHexData(nullptr, (uint8_t*) m_manufacturerData.data(), (uint8_t) m_manufacturerData.length());
-    NIMBLE_LOGD(LOG_TAG,"- manufacturer data: %s", pHex);
-    free(pHex);
-} // setManufacturerData
-
-
-/**
- * @brief Set the name for this device.
- * @param [in] name The discovered name.
- */
-void NimBLEAdvertisedDevice::setName(std::string name) {
-    m_name     = name;
-    m_haveName = true;
-    NIMBLE_LOGD(LOG_TAG,"- setName(): name: %s", m_name.c_str());
-} // setName
-
-
 /**
  * @brief Set the RSSI for this device.
  * @param [in] rssi The discovered RSSI.
@@ -436,58 +448,6 @@ void NimBLEAdvertisedDevice::setScan(NimBLEScan* pScan) {
 } // setScan
 
 
-/**
- * @brief Set the Service UUID for this device.
- * @param [in] serviceUUID The discovered serviceUUID
- */
- 
-void NimBLEAdvertisedDevice::setServiceUUID(const char* serviceUUID) {
-    return setServiceUUID(NimBLEUUID(serviceUUID));
-} // setServiceUUID
-
-
-/**
- * @brief Set the Service UUID for this device.
- * @param [in] serviceUUID The discovered serviceUUID
- */
-void NimBLEAdvertisedDevice::setServiceUUID(NimBLEUUID serviceUUID) {
-    m_serviceUUIDs.push_back(serviceUUID);
-    m_haveServiceUUID = true;
-    NIMBLE_LOGD(LOG_TAG,"- addServiceUUID(): serviceUUID: %s", serviceUUID.toString().c_str());
-} // setServiceUUID
-
-
-/**
- * @brief Set the ServiceData value.
- * @param [in] data ServiceData value.
- */
-void NimBLEAdvertisedDevice::setServiceData(std::string serviceData) {
-    m_haveServiceData = true;         // Set the flag that indicates we have service data.
-    m_serviceData     = serviceData;  // Save the service data that we received.
-} //setServiceData
-
-
-/**
- * @brief Set the ServiceDataUUID value.
- * @param [in] data ServiceDataUUID value.
- */
-void NimBLEAdvertisedDevice::setServiceDataUUID(NimBLEUUID uuid) {
-    m_haveServiceData = true;         // Set the flag that indicates we have service data.
-    m_serviceDataUUID = uuid;
-} // setServiceDataUUID
-
-
-/**
- * @brief Set the power level for this device.
- * @param [in] txPower The discovered power level.
- */
-void NimBLEAdvertisedDevice::setTXPower(int8_t txPower) {
-    m_txPower     = txPower;
-    m_haveTXPower = true;
-    NIMBLE_LOGD(LOG_TAG,"- txPower: %d", m_txPower);
-} // setTXPower
-
-
 /**
  * @brief Create a string representation of this device.
  * @return A string representation of this device.
@@ -528,7 +488,7 @@ std::string NimBLEAdvertisedDevice::toString() {
 
 
 uint8_t* NimBLEAdvertisedDevice::getPayload() {
-    return m_payload;
+    return m_payload.data();
 }
 
 
@@ -547,10 +507,68 @@ size_t NimBLEAdvertisedDevice::getPayloadLength() {
 }
 
 
-void NimBLEAdvertisedDevice::setAdvertisementResult(uint8_t* payload, uint8_t length){
-    m_payload = payload;
-    m_payloadLength = length;
-}
+/**
+ * @brief Get the PHY the device advertised on.
+ * @return BLE_HCI_LE_PHY_1M or BLE_HCI_LE_PHY_CODED.
+ */
+uint8_t NimBLEAdvertisedDevice::getPrimaryPhy() {
+    return m_primPhy;
+} // getPrimaryPhy
+
+
+/**
+ * @brief Get the PHY of the extended advertising data.
+ * @return BLE_HCI_LE_PHY_1M, BLE_HCI_LE_PHY_2M, BLE_HCI_LE_PHY_CODED or 0 for a legacy advertisement.
+ */
+uint8_t NimBLEAdvertisedDevice::getSecondaryPhy() {
+    return m_secPhy;
+} // getSecondaryPhy
+
+
+/**
+ * @brief Get the advertising set ID of an extended advertisement.
+ * @return The set ID, 0xFF for a legacy advertisement.
+ */
+uint8_t NimBLEAdvertisedDevice::getSetId() {
+    return m_sid;
+} // getSetId
+
+
+/**
+ * @brief Store the advertisement or scan response data of this device.
+ *
+ * The data is copied into the payload buffer sized by the scan, the advertisement data first followed
+ * by the scan response data.  Data that does not fit is truncated.  A new advertisement keeps the last scan response and vice versa.
+ * Fields are only parsed when a getter is called.
+ *
+ * @param [in] payload The data received.
+ * @param [in] length The length of the data.
+ * @param [in] isScanResponse True if the data is a scan response.
+ */
+void NimBLEAdvertisedDevice::setPayload(const uint8_t* payload, uint16_t length, bool isScanResponse) {
+    size_t size = m_payload.size();
+    uint8_t* pData = m_payload.data();
+
+    if(isScanResponse) {
+        if(length > size - m_advLength) {
+            length = size - m_advLength;
+        }
+        memcpy(pData + m_advLength, payload, length);
+        m_payloadLength = m_advLength + length;
+        return;
+    }
+
+    size_t rspLength = m_payloadLength - m_advLength;
+    if(length > size - rspLength) {
+        length = size - rspLength;
+    }
+    if(rspLength > 0 && length != m_advLength) {
+        memmove(pData + length, pData + m_advLength, rspLength);
+    }
+    memcpy(pData, payload, length);
+    m_advLength = length;
+    m_payloadLength = length + rspLength;
+} // setPayload
 
 #endif /* CONFIG_BT_ENABLED */
 
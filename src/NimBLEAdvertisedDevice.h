@@ -21,11 +21,21 @@
 #include "NimBLEScan.h"
 #include "NimBLEUUID.h"
 
+#include "nimble/hci_common.h"
 #include "host/ble_hs_adv.h"
 
 #include <map>
 #include <vector> 
 
+#if !defined(CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN)
+#define CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN 1650
+#endif
+
+/// Storage for the advertisement data followed by the scan response data of a device.
+#define NIMBLE_ADV_PAYLOAD_LEGACY_SZ    (BLE_HS_ADV_MAX_SZ * 2)
+/// Storage of a device when extended scanning is enabled.
+#define NIMBLE_ADV_PAYLOAD_EXT_SZ       (CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN + BLE_HS_ADV_MAX_SZ)
+
 
 class NimBLEScan;
 /**
@@ -46,12 +56,16 @@ public:
     NimBLEScan*     getScan();
     std::string     getServiceData();
     NimBLEUUID      getServiceDataUUID();
-    NimBLEUUID      getServiceUUID();
+    NimBLEUUID      getServiceUUID(uint8_t index = 0);
+    uint8_t         getServiceUUIDCount();
     int8_t          getTXPower();
     uint8_t*        getPayload();
     size_t          getPayloadLength();
     uint8_t         getAddressType();
     void setAddressType(uint8_t type);
+    uint8_t         getPrimaryPhy();
+    uint8_t         getSecondaryPhy();
+    uint8_t         getSetId();
 
 
     bool        isAdvertisingService(NimBLEUUID uuid);
@@ -68,45 +82,33 @@ public:
 private:
     friend class NimBLEScan;
 
-    void parseAdvertisement(ble_hs_adv_fields *fields);
+    void reset();
+    void allocatePayload(uint16_t size);
     void setAddress(NimBLEAddress address);
     void setAdvType(uint8_t advType);
-    void setAdvertisementResult(uint8_t* payload, uint8_t length);
-    void setAppearance(uint16_t appearance);
-    void setManufacturerData(std::string manufacturerData);
-    void setName(std::string name);
+    void setPayload(const uint8_t* payload, uint16_t length, bool isScanResponse);
     void setRSSI(int rssi);
     void setScan(NimBLEScan* pScan);
-    void setServiceData(std::string data);
-    void setServiceDataUUID(NimBLEUUID uuid);
-    void setServiceUUID(const char* serviceUUID);
-    void setServiceUUID(NimBLEUUID serviceUUID);
-    void setTXPower(int8_t txPower);
-
-    bool m_haveAppearance;
-    bool m_haveManufacturerData;
-    bool m_haveName;
-    bool m_haveRSSI;
-    bool m_haveServiceData;
-    bool m_haveServiceUUID;
-    bool m_haveTXPower;
-
-
-    NimBLEAddress  m_address = NimBLEAddress("\0\0\0\0\0\0");
+
+    const uint8_t*  findField(uint8_t type, uint8_t* length);
+    const uint8_t*  findServiceData(uint8_t* uuidLength, uint8_t* length);
+    bool            findServiceUUID(uint8_t index, NimBLEUUID* uuid);
+
+    bool            m_haveRSSI;
+
+    NimBLEAddress   m_address;
     uint8_t         m_advType;
-    uint16_t        m_appearance;
     int             m_deviceType;
-    std::string     m_manufacturerData;
-    std::string     m_name;
     NimBLEScan*     m_pScan;
     int             m_rssi;
-    std::vector<NimBLEUUID> m_serviceUUIDs;
-    int8_t          m_txPower;
-    std::string     m_serviceData;
-    NimBLEUUID      m_serviceDataUUID;
-    uint8_t*        m_payload;
-    size_t          m_payloadLength = 0;
+    std::vector<uint8_t> m_payload;         // Sized by the scan result store, see allocatePayload().
+    uint16_t        m_advLength = 0;        // Length of the advertisement data at the start of m_payload.
+    size_t          m_payloadLength = 0;    // Length of the advertisement and scan response data.
     uint8_t         m_addressType;
+    uint8_t         m_primPhy = BLE_HCI_LE_PHY_1M;
+    uint8_t         m_secPhy = 0;           // 0 for a legacy advertisement.
+    uint8_t         m_sid = 0xFF;           // Advertising set ID, 0xFF for a legacy advertisement.
+    uint32_t        m_lastSeen = 0;         // Time of the last report in milliseconds since boot.
 };
 
 /**
@@ -127,6 +129,17 @@ public:
      */
     //virtual void onResult(NimBLEAdvertisedDevice advertisedDevice);
     virtual void onResult(NimBLEAdvertisedDevice* advertisedDevice) = 0;
+
+    /**
+     * @brief Called when presence tracking is enabled and a device is seen after being absent.
+     */
+    virtual void onArrived(NimBLEAdvertisedDevice* advertisedDevice) {}
+
+    /**
+     * @brief Called when presence tracking is enabled and a device was not seen for the departure timeout
+     * or is evicted from the scan results.
+     */
+    virtual void onDeparted(NimBLEAdvertisedDevice* advertisedDevice) {}
 };
 
 #endif /* CONFIG_BT_ENABLED */
@@ -29,11 +29,44 @@ static const char* LOG_TAG = "NimBLEClient";
 
 #include "NimBLELog.h"
 
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+#include "store/config/ble_store_config.h"
+#endif
+
 #include <string>
 #include <unordered_set>
 
+// Declared in the private host headers.
+extern "C" int ble_hs_hci_util_set_data_len(uint16_t conn_handle, uint16_t tx_octets, uint16_t tx_time);
+extern "C" uint16_t ble_hs_hci_max_acl_payload_sz(void);
+
 static const char* LOG_TAG = "NimBLEClient";
 
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+#define NIMBLE_GATT_CACHE_VERSION 1
+
+/**
+ * Layout of the blob kept in the GATT cache store for each peer.
+ * The header is followed by one entry per service, characteristic and descriptor
+ * in discovery order, so each characteristic follows its service and each descriptor
+ * follows its characteristic.
+ */
+struct NimBLEGattCacheHeader {
+    uint8_t     version;
+    uint8_t     dbHash[16];
+    uint16_t    count;
+};
+
+struct NimBLEGattCacheEntry {
+    uint8_t     type;   // 's'ervice, 'c'haracteristic or 'd'escriptor
+    union {
+        struct ble_gatt_svc svc;
+        struct ble_gatt_chr chr;
+        struct ble_gatt_dsc dsc;
+    };
+};
+#endif
+
 /*
  * Design
  * ------
@@ -61,6 +94,7 @@ NimBLEClient::NimBLEClient()
     m_conn_id          = BLE_HS_CONN_HANDLE_NONE;
     m_haveServices     = false;
     m_isConnected      = false;
+    m_txCmplSem        = xSemaphoreCreateBinary();
 } // NimBLEClient
 
 
@@ -81,6 +115,8 @@ NimBLEClient::~NimBLEClient() {
     if(m_deleteCallbacks) {
         delete m_pClientCallbacks;
     }
+    
+    vSemaphoreDelete(m_txCmplSem);
 } // ~NimBLEClient
 
 
@@ -90,6 +126,10 @@ NimBLEClient::~NimBLEClient() {
 void NimBLEClient::clearServices() {
     NIMBLE_LOGD(LOG_TAG, ">> clearServices");
     // Delete all the services.
+    m_notifyMap.clear();
+    if(NimBLEDevice::m_pNotifyQueue != nullptr) {
+        NimBLEDevice::m_pNotifyQueue->purge(this);
+    }
     for (auto &myPair : m_servicesMap) {
        delete myPair.second;
     }
@@ -155,18 +195,17 @@ bool NimBLEClient::connect(NimBLEAddress address, uint8_t type, bool refreshServ
         clearServices();
     }
     
-    m_peerAddress = address;
-    ble_addr_t peerAddrt;
-    memcpy(&peerAddrt.val, address.getNative(),6);
-    peerAddrt.type = type;
+    m_peerAddress = NimBLEAddress((uint64_t)address, type);
+    ble_addr_t peerAddrt = m_peerAddress.getBase();
     
     m_semaphoreOpenEvt.take("connect");
     
     /* Try to connect the the advertiser.  Allow 30 seconds (30000 ms) for
-     * timeout. Loop on BLE_HS_EBUSY if the scan hasn't stopped yet.
+     * timeout unless changed with setConnectTimeout(). Loop on BLE_HS_EBUSY
+     * if the scan hasn't stopped yet.
      */
     do{
-        rc = ble_gap_connect(BLE_OWN_ADDR_PUBLIC, &peerAddrt, 30000, NULL,
+        rc = ble_gap_connect(m_ownAddrType, &peerAddrt, m_connectTimeout, NULL,
                             NimBLEClient::handleGapEvent, this);
     }while(rc == BLE_HS_EBUSY);
                          
@@ -187,8 +226,8 @@ bool NimBLEClient::connect(NimBLEAddress address, uint8_t type, bool refreshServ
         return false;
     }
 
-    if (!m_haveServices) {
-        if (!retrieveServices()) {
+    if (!m_haveServices && !m_lazyDiscovery) {
+        if (!retrieveServices(!refreshServices)) {
             // error getting services, make sure we disconnect and release any resources before returning
             disconnect();
             clearServices();
@@ -204,6 +243,49 @@ bool NimBLEClient::connect(NimBLEAddress address, uint8_t type, bool refreshServ
 } // connect
 
 
+/**
+ * @brief Connect to the partner (BLE Server) without blocking.
+ * The callback is invoked from the host task when the connection is established or has failed.
+ * The peer database is not discovered, use discoverAsync() or the lazy lookups afterwards.
+ * @param [in] address The address of the partner.
+ * @param [in] type The address type of the partner.
+ * @param [in] completeCb The function called when the connection attempt completes.
+ * @param [in] arg Value passed to the callback.
+ * @return 0 if the connection was started, otherwise the host error code.
+ */
+int NimBLEClient::connectAsync(NimBLEAddress address, uint8_t type, client_complete_cb completeCb, void* arg) {
+    NIMBLE_LOGD(LOG_TAG, ">> connectAsync(%s)", address.toString().c_str());
+    
+    if(!NimBLEDevice::m_synced) {
+        NIMBLE_LOGE(LOG_TAG, "Host reset, wait for sync.");
+        return BLE_HS_ENOTSYNCED;
+    }
+    
+    if(m_isConnected || m_waitingToConnect) {
+        return BLE_HS_EALREADY;
+    }
+    
+    m_peerAddress = NimBLEAddress((uint64_t)address, type);
+    ble_addr_t peerAddrt = m_peerAddress.getBase();
+    
+    m_connectCb = completeCb;
+    m_connectCbArg = arg;
+    m_waitingToConnect = true;
+    
+    int rc = ble_gap_connect(m_ownAddrType, &peerAddrt, m_connectTimeout, NULL,
+                             NimBLEClient::handleGapEvent, this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Error: Failed to connect to device; rc=%d %s",
+                    rc, NimBLEUtils::returnCodeToString(rc));
+        m_connectCb = nullptr;
+        m_waitingToConnect = false;
+    }
+    
+    NIMBLE_LOGD(LOG_TAG, "<< connectAsync()");
+    return rc;
+} // connectAsync
+
+
 /**
  * @brief Called when a characteristic or descriptor requires encryption or authentication to access it.
  * This will pair with the device and bond if enabled.
@@ -226,6 +308,229 @@ bool NimBLEClient::secureConnection() {
     
     return true;
 }
+
+
+/**
+ * @brief Set the client to discover the peer database lazily.
+ * When enabled connect() does not discover the database, services and characteristics are
+ * discovered by UUID the first time they are requested and descriptors when they are needed.
+ * getServices() then only contains the services found so far.
+ * @param [in] lazy True to enable lazy discovery, must be set before connecting.
+ */
+void NimBLEClient::setLazyDiscovery(bool lazy) {
+    m_lazyDiscovery = lazy;
+} // setLazyDiscovery
+
+
+/**
+ * @brief Set the address type used by this device when connecting.
+ * @param [in] type BLE_OWN_ADDR_PUBLIC (default), BLE_OWN_ADDR_RANDOM, BLE_OWN_ADDR_RPA_PUBLIC_DEFAULT
+ * or BLE_OWN_ADDR_RPA_RANDOM_DEFAULT.
+ */
+void NimBLEClient::setOwnAddrType(uint8_t type) {
+    m_ownAddrType = type;
+} // setOwnAddrType
+
+
+/**
+ * @brief Set the link parameters requested once connected to a named profile.
+ * @param [in] profile The profile, LINK_PROFILE_DEFAULT leaves the link as the controllers negotiated it.
+ */
+void NimBLEClient::setLinkProfile(link_profile profile) {
+    setLinkProfile(NimBLELinkProfile::preset(profile));
+} // setLinkProfile
+
+
+/**
+ * @brief Set the link parameters requested once connected.
+ * The PHY, data length and MTU are requested right after the connection is established, the
+ * connection completes once the MTU is exchanged. The interval is requested after the PHY update.
+ * When already connected the parameters are requested straight away, the MTU can only be
+ * exchanged once per connection.
+ * @param [in] profile The parameters, a zero field leaves that parameter unchanged.
+ */
+void NimBLEClient::setLinkProfile(const NimBLELinkProfile &profile) {
+    m_linkProfile = profile;
+    if(m_isConnected) {
+        applyLinkProfile(false);
+    }
+} // setLinkProfile
+
+
+/**
+ * @brief Get the effective parameters of the connection.
+ * @return The parameters, the defaults of a new connection when not connected.
+ */
+NimBLELinkInfo NimBLEClient::getLinkInfo() {
+    NimBLELinkInfo info = {};
+    info.mtu = BLE_ATT_MTU_DFLT;
+    info.dataLen = 27;
+    info.txPhy = BLE_GAP_LE_PHY_1M;
+    info.rxPhy = BLE_GAP_LE_PHY_1M;
+    
+    if(!m_isConnected) {
+        return info;
+    }
+    
+    info.mtu = getMTU();
+    info.dataLen = m_dataLen;
+    
+    uint8_t txPhy, rxPhy;
+    if(ble_gap_read_le_phy(m_conn_id, &txPhy, &rxPhy) == 0) {
+        info.txPhy = txPhy;
+        info.rxPhy = rxPhy;
+    }
+    
+    struct ble_gap_conn_desc desc;
+    if(ble_gap_conn_find(m_conn_id, &desc) == 0) {
+        info.itvl = desc.conn_itvl;
+        info.latency = desc.conn_latency;
+        info.supervisionTimeout = desc.supervision_timeout;
+    }
+    
+    return info;
+} // getLinkInfo
+
+
+/**
+ * @brief Request the parameters of the link profile from the controller and the peer.
+ * @param [in] connecting True when called as the connection is established.
+ * @return True if the connection completes later, from the MTU exchange callback.
+ */
+bool NimBLEClient::applyLinkProfile(bool connecting) {
+    const NimBLELinkProfile &p = m_linkProfile;
+    int rc;
+    
+    if(p.dataLen != 0) {
+        // Air time of the largest packet on the 1M PHY, the coded PHY needs the maximum.
+        uint16_t txTime = (p.phyMask & BLE_GAP_LE_PHY_CODED_MASK) ? BLE_HCI_SET_DATALEN_TX_TIME_MAX 
+                                                                  : (p.dataLen + 14) * 8;
+        rc = ble_hs_hci_util_set_data_len(m_conn_id, p.dataLen, txTime);
+        if(rc == 0) {
+            m_dataLen = p.dataLen;
+        } else {
+            NIMBLE_LOGW(LOG_TAG, "Cannot set the data length; rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        }
+    }
+    
+    m_phyPending = false;
+    if(p.phyMask != 0) {
+        rc = ble_gap_set_prefered_le_phy(m_conn_id, p.phyMask, p.phyMask, p.phyOpts);
+        if(rc == 0) {
+            m_phyPending = true;
+        } else {
+            NIMBLE_LOGW(LOG_TAG, "Cannot set the PHY; rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        }
+    }
+    
+    if(!m_phyPending) {
+        requestConnParams();
+    }
+    
+    if(p.mtu == 0 || getMTU() > BLE_ATT_MTU_DFLT) {
+        return false;
+    }
+    
+    // The exchange offers the preferred MTU of the host.  It is raised only while the request
+    // is built, the request fixes the MTU of this link so the other links and roles keep theirs.
+    uint16_t preferredMtu = ble_att_preferred_mtu();
+    if(p.mtu > preferredMtu) {
+        ble_att_set_preferred_mtu(p.mtu);
+    }
+    
+    rc = ble_gattc_exchange_mtu(m_conn_id, NimBLEClient::mtuExchangeCB, this);
+    
+    if(p.mtu > preferredMtu) {
+        ble_att_set_preferred_mtu(preferredMtu);
+    }
+    
+    if(rc != 0) {
+        NIMBLE_LOGW(LOG_TAG, "Cannot exchange the MTU; rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+    
+    m_exchangingMtu = connecting;
+    return connecting;
+} // applyLinkProfile
+
+
+/**
+ * @brief Request the connection interval, latency and supervision timeout of the link profile.
+ */
+void NimBLEClient::requestConnParams() {
+    const NimBLELinkProfile &p = m_linkProfile;
+    if(p.itvlMax == 0) {
+        return;
+    }
+    
+    struct ble_gap_upd_params params;
+    params.itvl_min = p.itvlMin != 0 ? p.itvlMin : p.itvlMax;
+    params.itvl_max = p.itvlMax;
+    params.latency = p.latency;
+    // The timeout must cover 2 intervals including the skipped events, in 10 ms units.
+    uint32_t minTimeout = (uint32_t)(1 + p.latency) * p.itvlMax / 4 + 1;
+    params.supervision_timeout = p.supervisionTimeout > minTimeout ? p.supervisionTimeout : minTimeout;
+    // Let the connection events use the whole interval, in 0.625 ms units.
+    params.min_ce_len = 0;
+    params.max_ce_len = p.itvlMax * 2;
+    
+    int rc = ble_gap_update_params(m_conn_id, &params);
+    if(rc != 0) {
+        NIMBLE_LOGW(LOG_TAG, "Cannot update the connection parameters; rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+    }
+} // requestConnParams
+
+
+/**
+ * @brief Callback of the MTU exchange started by the link profile.
+ * @return 0.
+ */
+int NimBLEClient::mtuExchangeCB(uint16_t conn_handle, const struct ble_gatt_error *error, uint16_t mtu, void *arg) {
+    NimBLEClient* client = (NimBLEClient*)arg;
+    
+    if(client->getConnId() != conn_handle) {
+        return 0;
+    }
+    
+    NIMBLE_LOGI(LOG_TAG, "MTU exchange complete; status=%d mtu=%d", error->status, mtu);
+    
+    // A rejected exchange leaves the default MTU and the link is still usable, but the host
+    // also fails the exchange with BLE_HS_ENOTCONN when the link is lost.
+    if(client->m_exchangingMtu) {
+        client->m_exchangingMtu = false;
+        int rc = 0;
+        if(error->status == BLE_HS_ENOTCONN || !client->m_isConnected) {
+            rc = BLE_HS_ENOTCONN;
+        }
+        client->connectComplete(rc);
+    }
+    return 0;
+} // mtuExchangeCB
+
+
+/**
+ * @brief Report the end of a connection attempt.
+ * Calls the connectAsync() callback if one is pending, otherwise releases connect().
+ * @param [in] rc 0 on success or the error that stopped the connection.
+ */
+void NimBLEClient::connectComplete(int rc) {
+    if(m_connectCb != nullptr) {
+        client_complete_cb completeCb = m_connectCb;
+        m_connectCb = nullptr;
+        completeCb(this, rc, m_connectCbArg);
+    } else {
+        m_semaphoreOpenEvt.give(rc);
+    }
+} // connectComplete
+
+
+/**
+ * @brief Set how long a connection attempt may take before it fails.
+ * @param [in] timeoutMs The timeout in milliseconds, 30000 by default.
+ */
+void NimBLEClient::setConnectTimeout(uint32_t timeoutMs) {
+    m_connectTimeout = timeoutMs;
+} // setConnectTimeout
     
 
 /**
@@ -302,27 +607,69 @@ NimBLERemoteService* NimBLEClient::getService(const char* uuid) {
  * @return A reference to the Service or nullptr if don't know about it.
  */
 NimBLERemoteService* NimBLEClient::getService(NimBLEUUID uuid) {
-    NIMBLE_LOGD(LOG_TAG, ">> getService: uuid: %s", uuid.toString().c_str());
+    NIMBLE_LOGD(LOG_TAG, ">> getService");
 
-    if (!m_haveServices) {
+    if (!m_haveServices && !m_lazyDiscovery) {
         return nullptr;
     }
-    std::string uuidStr = uuid.toString();
-    for (auto &myPair : m_servicesMap) {
-        if (myPair.first == uuidStr) {
-            NIMBLE_LOGD(LOG_TAG, "<< getService: found the service with uuid: %s", uuid.toString().c_str());
-            return myPair.second;
-        }
-    } 
+
+    auto it = m_servicesMap.find(uuid);
+    if (it != m_servicesMap.end()) {
+        NIMBLE_LOGD(LOG_TAG, "<< getService: found");
+        return it->second;
+    }
+    
+    if (m_lazyDiscovery) {
+        return discoverService(uuid);
+    }
+    
     NIMBLE_LOGD(LOG_TAG, "<< getService: not found");
     return nullptr;
 } // getService
 
 
+/**
+ * @brief Discover a single service on the peer by UUID.
+ * Used in lazy discovery mode, the characteristics are not discovered until requested.
+ * @param [in] uuid The UUID of the service being sought.
+ * @return A reference to the Service or nullptr if the peer does not have it.
+ */
+NimBLERemoteService* NimBLEClient::discoverService(NimBLEUUID uuid) {
+    NIMBLE_LOGD(LOG_TAG, ">> discoverService: uuid: %s", uuid.toString().c_str());
+    
+    if(!m_isConnected || uuid.getNative() == nullptr) {
+        return nullptr;
+    }
+    
+    m_semaphoreSearchCmplEvt.take("discoverService");
+    
+    int rc = ble_gattc_disc_svc_by_uuid(m_conn_id, &uuid.getNative()->u,
+                                        NimBLEClient::serviceDiscoveredCB, this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_svc_by_uuid: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        m_semaphoreSearchCmplEvt.give();
+        return nullptr;
+    }
+    
+    if(m_semaphoreSearchCmplEvt.wait("discoverService") != 0) {
+        return nullptr;
+    }
+    
+    auto it = m_servicesMap.find(uuid);
+    if(it != m_servicesMap.end()) {
+        NIMBLE_LOGD(LOG_TAG, "<< discoverService: found");
+        return it->second;
+    }
+    
+    NIMBLE_LOGD(LOG_TAG, "<< discoverService: not found");
+    return nullptr;
+} // discoverService
+
+
 /**
  * @Get a pointer to the map of found services.
  */ 
-std::map<std::string, NimBLERemoteService*>* NimBLEClient::getServices() {
+NimBLEUUIDMap<NimBLERemoteService*>* NimBLEClient::getServices() {
     return &m_servicesMap;
 }
 
@@ -331,15 +678,21 @@ std::map<std::string, NimBLERemoteService*>* NimBLEClient::getServices() {
  * @brief Ask the remote %BLE server for its services.
  * A %BLE Server exposes a set of services for its partners.  Here we ask the server for its set of
  * services and wait until we have received them all.
- * We then ask for the characteristics for each service found and their desciptors.
+ * The characteristics and descriptors of each service are then discovered from the host task
+ * callbacks and the semaphore is released only once the whole database has been retrieved.
+ * If the GATT cache is enabled and the peer Database Hash matches the stored copy the
+ * discovery is skipped and the database is restored from the cache instead.
+ * @param [in] useCache Allow the database to be restored from the cache.
  * @return true on success otherwise false if an error occurred
  */ 
-bool NimBLEClient::retrieveServices() {
+bool NimBLEClient::retrieveServices(bool useCache) {
 /*
  * Design
  * ------
  * We invoke ble_gattc_disc_all_svcs.  This will request a list of the services exposed by the
  * peer BLE partner to be returned in the callback function provided.
+ * When the services are complete the callback starts the characteristic discovery of the first service,
+ * each completed service then starts the next one so no round trip waits on the application task.
  */
  
     NIMBLE_LOGD(LOG_TAG, ">> retrieveServices");
@@ -350,6 +703,20 @@ bool NimBLEClient::retrieveServices() {
         return false;
     }
 
+    uint32_t startTime = FreeRTOS::getTimeSinceStart();
+
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+    bool haveHash = readDatabaseHash();
+    if(haveHash && useCache && loadServicesCache()) {
+        m_haveServices = true;
+        NIMBLE_LOGD(LOG_TAG, "<< retrieveServices: restored from cache in %d ms", 
+                    FreeRTOS::getTimeSinceStart() - startTime);
+        return true;
+    }
+#endif
+
+    m_discProcCount = 1;
+
     m_semaphoreSearchCmplEvt.take("retrieveServices");
     
     int rc = ble_gattc_disc_all_svcs(m_conn_id, NimBLEClient::serviceDiscoveredCB, this);
@@ -361,20 +728,17 @@ bool NimBLEClient::retrieveServices() {
         return false;
     }
     
-    // wait until we have all the services
+    // wait until we have all the services, characteristics and descriptors
     // If sucessful, remember that we now have services.
     m_haveServices = (m_semaphoreSearchCmplEvt.wait("retrieveServices") == 0);
     if(m_haveServices){
-        for (auto &myPair : m_servicesMap) {
-            // if we were disconnected try to recover gracefully and release all resources
-            if(!m_isConnected || !myPair.second->retrieveCharacteristics()) {
-                NIMBLE_LOGE(LOG_TAG, "Disconnected, could not retrieve characteristics -aborting");
-                //clearServices();
-                return false;
-            }
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+        if(haveHash) {
+            storeServicesCache();
         }
-        
-        NIMBLE_LOGD(LOG_TAG, "<< retrieveServices");
+#endif
+        NIMBLE_LOGD(LOG_TAG, "<< retrieveServices: %d GATT procedures in %d ms", 
+                    m_discProcCount, FreeRTOS::getTimeSinceStart() - startTime);
         return true;
     }
     else {
@@ -407,17 +771,25 @@ int NimBLEClient::serviceDiscoveredCB(
 
     switch (error->status) {
         case 0: {
-            // Found a service - add it to the map
+            // Found a service - add it to the map, unless a lazy lookup already did.
             NimBLERemoteService* pRemoteService = new NimBLERemoteService(peer, service);
-            peer->m_servicesMap.insert(std::pair<std::string, NimBLERemoteService*>(pRemoteService->getUUID().toString(), pRemoteService));
+            if(!peer->m_servicesMap.insert(std::make_pair(pRemoteService->getUUID(), pRemoteService)).second) {
+                delete pRemoteService;
+            }
 
             break;
         }
         case BLE_HS_EDONE:{
+            // A lazy lookup found its service, unless discoverAsync() asked for the whole database.
+            if(peer->m_lazyDiscovery && peer->m_discoverCb == nullptr) {
+                // Single service requested, the characteristics will be discovered when needed.
+                peer->m_semaphoreSearchCmplEvt.give(0);
+                break;
+            }
             // All services discovered; start discovering characteristics. 
-
-            NIMBLE_LOGD(LOG_TAG,"Giving search semaphore - completed");
-            peer->m_semaphoreSearchCmplEvt.give(0);
+            NIMBLE_LOGD(LOG_TAG,"Services complete, starting characteristic discovery");
+            peer->m_discIt = peer->m_servicesMap.begin();
+            peer->discoverNextService();
             rc = 0;
             break;
         }
@@ -429,13 +801,320 @@ int NimBLEClient::serviceDiscoveredCB(
 
     if (rc != 0) {
         // pass non-zero to semaphore on error to indicate an error finding services
-        peer->m_semaphoreSearchCmplEvt.give(1); 
+        peer->discoveryComplete(rc); 
     }
     NIMBLE_LOGD(LOG_TAG,"<< Service Discovered. status: %d", rc);
     return rc;
 }
 
 
+/**
+ * @brief Start the attribute discovery of the next service waiting in the services map.
+ * Called from the host task each time a service has been completed so that the next
+ * request is sent immediately. Releases the search semaphore when all services are done
+ * or with the error code if the next procedure could not be started.
+ */
+void NimBLEClient::discoverNextService() {
+    if(m_discIt == m_servicesMap.end()) {
+        NIMBLE_LOGD(LOG_TAG,"Giving search semaphore - completed");
+        discoveryComplete(0);
+        return;
+    }
+
+    NimBLERemoteService* pService = (m_discIt++)->second;
+    int rc = pService->discoverCharacteristics();
+    if(rc != 0) {
+        discoveryComplete(rc);
+    }
+} // discoverNextService
+
+
+/**
+ * @brief Report the end of a full database discovery.
+ * Calls the discoverAsync() callback if one is pending, otherwise releases retrieveServices().
+ * @param [in] rc 0 on success or the error that stopped the discovery.
+ */
+void NimBLEClient::discoveryComplete(int rc) {
+    if(m_discoverCb == nullptr) {
+        m_semaphoreSearchCmplEvt.give(rc);
+        return;
+    }
+    
+    client_complete_cb completeCb = m_discoverCb;
+    m_discoverCb = nullptr;
+    m_haveServices = (rc == 0);
+    NIMBLE_LOGD(LOG_TAG, "Async discovery complete: rc=%d, %d GATT procedures", rc, m_discProcCount);
+    completeCb(this, rc, m_discoverCbArg);
+} // discoveryComplete
+
+
+/**
+ * @brief Start discovering the whole peer database without blocking.
+ * The callback is invoked from the host task once every service, characteristic and
+ * descriptor has been retrieved, or with the error that stopped the discovery.
+ * If the database is already known the callback is invoked immediately from the calling task.
+ * In lazy discovery mode the attributes already found by getService() and getCharacteristic()
+ * are kept, the discovery only adds the missing ones so earlier pointers stay valid.
+ * @param [in] completeCb The function called when the discovery is complete.
+ * @param [in] arg Value passed to the callback.
+ * @return 0 if the discovery was started, otherwise the host error code.
+ */
+int NimBLEClient::discoverAsync(client_complete_cb completeCb, void* arg) {
+    NIMBLE_LOGD(LOG_TAG, ">> discoverAsync");
+    
+    if(!m_isConnected) {
+        return BLE_HS_ENOTCONN;
+    }
+    
+    if(m_discoverCb != nullptr) {
+        return BLE_HS_EBUSY;
+    }
+    
+    if(m_haveServices) {
+        completeCb(this, 0, arg);
+        return 0;
+    }
+    
+    m_discoverCb = completeCb;
+    m_discoverCbArg = arg;
+    m_discProcCount = 1;
+    
+    int rc = ble_gattc_disc_all_svcs(m_conn_id, NimBLEClient::serviceDiscoveredCB, this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_all_svcs: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        m_discoverCb = nullptr;
+    }
+    
+    NIMBLE_LOGD(LOG_TAG, "<< discoverAsync");
+    return rc;
+} // discoverAsync
+
+
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+/**
+ * @brief Read the Database Hash characteristic (0x2B2A) of the peer.
+ * @return True if the peer has a database hash and it was stored in m_dbHash.
+ */
+bool NimBLEClient::readDatabaseHash() {
+    NimBLEUUID hashUUID((uint16_t)0x2B2A);
+    m_haveDbHash = false;
+    
+    m_semaphoreSearchCmplEvt.take("readDatabaseHash");
+    
+    int rc = ble_gattc_read_by_uuid(m_conn_id, 1, 0xFFFF, &hashUUID.getNative()->u,
+                                    NimBLEClient::dbHashReadCB, this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gattc_read_by_uuid: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        m_semaphoreSearchCmplEvt.give();
+        return false;
+    }
+    
+    rc = m_semaphoreSearchCmplEvt.wait("readDatabaseHash");
+    NIMBLE_LOGD(LOG_TAG, "Database hash read: rc=%d, found: %d", rc, m_haveDbHash);
+    return (rc == 0) && m_haveDbHash;
+} // readDatabaseHash
+
+
+/**
+ * @brief STATIC Callback for the database hash read.
+ */
+int NimBLEClient::dbHashReadCB(uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                struct ble_gatt_attr *attr, void *arg) 
+{
+    NimBLEClient* client = (NimBLEClient*)arg;
+    
+    // Make sure the read is for this device
+    if(client->m_conn_id != conn_handle){
+        return 0;
+    }
+    
+    switch (error->status) {
+        case 0:
+            if(OS_MBUF_PKTLEN(attr->om) == sizeof(client->m_dbHash)) {
+                os_mbuf_copydata(attr->om, 0, sizeof(client->m_dbHash), client->m_dbHash);
+                client->m_haveDbHash = true;
+            }
+            return 0;
+            
+        case BLE_HS_EDONE:
+            client->m_semaphoreSearchCmplEvt.give(0);
+            return 0;
+            
+        default:
+            // The peer does not have the characteristic or the read failed, use discovery.
+            client->m_semaphoreSearchCmplEvt.give(error->status);
+            return error->status;
+    }
+} // dbHashReadCB
+
+
+/**
+ * @brief Get the identity address of the connected peer used to key the GATT cache.
+ * Only bonded peers and peers using a public or random static address are cached, a
+ * resolvable or non-resolvable private address changes and would leave stale entries behind.
+ * @param [out] addr The identity address.
+ * @return True if the connection was found and the peer can be cached.
+ */
+bool NimBLEClient::getPeerIdAddr(ble_addr_t* addr) {
+    struct ble_gap_conn_desc desc;
+    if(ble_gap_conn_find(m_conn_id, &desc) != 0) {
+        return false;
+    }
+    
+    bool identity = desc.peer_id_addr.type == BLE_ADDR_PUBLIC ||
+                    (desc.peer_id_addr.type == BLE_ADDR_RANDOM &&
+                    (desc.peer_id_addr.val[5] & 0xC0) == 0xC0);
+    
+    if(!desc.sec_state.bonded && !identity) {
+        NIMBLE_LOGD(LOG_TAG, "Peer is not bonded and uses a private address, not using the GATT cache");
+        return false;
+    }
+    
+    *addr = desc.peer_id_addr;
+    return true;
+} // getPeerIdAddr
+
+
+/**
+ * @brief Restore the services, characteristics and descriptors from the GATT cache.
+ * The cached copy is only used if it was stored with the database hash we just read.
+ * @return True if the database was restored.
+ */
+bool NimBLEClient::loadServicesCache() {
+    ble_addr_t peerAddr;
+    NimBLEGattCacheHeader header;
+    size_t len = 0;
+    
+    if(!getPeerIdAddr(&peerAddr) || 
+        ble_store_gatt_cache_read(&peerAddr, nullptr, &len) != 0 ||
+        len < sizeof(header)) 
+    {
+        NIMBLE_LOGD(LOG_TAG, "No GATT cache for this peer");
+        return false;
+    }
+    
+    std::vector<uint8_t> buf(len);
+    if(ble_store_gatt_cache_read(&peerAddr, buf.data(), &len) != 0) {
+        return false;
+    }
+    
+    memcpy(&header, buf.data(), sizeof(header));
+    if(header.version != NIMBLE_GATT_CACHE_VERSION ||
+       len != sizeof(header) + header.count * sizeof(NimBLEGattCacheEntry) ||
+       memcmp(header.dbHash, m_dbHash, sizeof(m_dbHash)) != 0)
+    {
+        NIMBLE_LOGI(LOG_TAG, "GATT cache out of date, discovering services");
+        return false;
+    }
+    
+    NimBLERemoteService*        pService = nullptr;
+    NimBLERemoteCharacteristic* pChr = nullptr;
+    NimBLEGattCacheEntry        entry;
+    
+    for(uint16_t i = 0; i < header.count; i++) {
+        memcpy(&entry, buf.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+        
+        if(entry.type == 's') {
+            pService = new NimBLERemoteService(this, &entry.svc);
+            pService->m_haveCharacteristics = true;
+            m_servicesMap.insert(std::make_pair(pService->getUUID(), pService));
+            pChr = nullptr;
+        }
+        else if(entry.type == 'c' && pService != nullptr) {
+            pChr = new NimBLERemoteCharacteristic(pService, &entry.chr);
+            pChr->m_haveDescriptors = true;
+            pService->m_characteristicMap.insert(std::make_pair(pChr->getUUID(), pChr));
+            pService->m_characteristicMapByHandle.insert(std::pair<uint16_t, NimBLERemoteCharacteristic*>(pChr->getHandle(), pChr));
+        }
+        else if(entry.type == 'd' && pChr != nullptr) {
+            NimBLERemoteDescriptor* pDsc = new NimBLERemoteDescriptor(pChr, &entry.dsc);
+            if(!pChr->m_descriptorMap.insert(std::make_pair(pDsc->getUUID(), pDsc)).second) {
+                delete pDsc;
+            }
+        }
+        else {
+            NIMBLE_LOGE(LOG_TAG, "GATT cache corrupted, discovering services");
+            clearServices();
+            return false;
+        }
+    }
+    
+    NIMBLE_LOGI(LOG_TAG, "Restored %d services from GATT cache", m_servicesMap.size());
+    return true;
+} // loadServicesCache
+
+
+/**
+ * @brief Save the discovered database and the database hash in the GATT cache.
+ */
+void NimBLEClient::storeServicesCache() {
+    ble_addr_t peerAddr;
+    std::vector<NimBLEGattCacheEntry> entries;
+    NimBLEGattCacheEntry entry;
+    
+    if(!getPeerIdAddr(&peerAddr)) {
+        return;
+    }
+    
+    for(auto &sPair : m_servicesMap) {
+        NimBLERemoteService* pService = sPair.second;
+        if(pService->m_uuid.getNative() == nullptr) {
+            NIMBLE_LOGE(LOG_TAG, "Not storing GATT cache, service 0x%04x has no UUID", pService->m_startHandle);
+            return;
+        }
+        entry.type             = 's';
+        entry.svc.start_handle = pService->m_startHandle;
+        entry.svc.end_handle   = pService->m_endHandle;
+        entry.svc.uuid         = *pService->m_uuid.getNative();
+        entries.push_back(entry);
+        
+        for(auto &cPair : pService->m_characteristicMapByHandle) {
+            NimBLERemoteCharacteristic* pChr = cPair.second;
+            if(pChr->m_uuid.getNative() == nullptr) {
+                NIMBLE_LOGE(LOG_TAG, "Not storing GATT cache, characteristic 0x%04x has no UUID", pChr->m_handle);
+                return;
+            }
+            entry.type           = 'c';
+            entry.chr.def_handle = pChr->m_defHandle;
+            entry.chr.val_handle = pChr->m_handle;
+            entry.chr.properties = pChr->m_charProp;
+            entry.chr.uuid       = *pChr->m_uuid.getNative();
+            entries.push_back(entry);
+            
+            for(auto &dPair : pChr->m_descriptorMap) {
+                NimBLERemoteDescriptor* pDsc = dPair.second;
+                if(pDsc->m_uuid.getNative() == nullptr) {
+                    NIMBLE_LOGE(LOG_TAG, "Not storing GATT cache, descriptor 0x%04x has no UUID", pDsc->m_handle);
+                    return;
+                }
+                entry.type       = 'd';
+                entry.dsc.handle = pDsc->m_handle;
+                entry.dsc.uuid   = *pDsc->m_uuid.getNative();
+                entries.push_back(entry);
+            }
+        }
+    }
+    
+    NimBLEGattCacheHeader header;
+    header.version = NIMBLE_GATT_CACHE_VERSION;
+    header.count   = entries.size();
+    memcpy(header.dbHash, m_dbHash, sizeof(m_dbHash));
+    
+    std::vector<uint8_t> buf(sizeof(header) + entries.size() * sizeof(entry));
+    memcpy(buf.data(), &header, sizeof(header));
+    if(!entries.empty()) {
+        memcpy(buf.data() + sizeof(header), entries.data(), entries.size() * sizeof(entry));
+    }
+    
+    int rc = ble_store_gatt_cache_write(&peerAddr, buf.data(), buf.size());
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Failed to store GATT cache: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+    }
+} // storeServicesCache
+#endif // CONFIG_BT_NIMBLE_GATT_CACHE
+
+
 /**
  * @brief Get the value of a specific characteristic associated with a specific service.
  * @param [in] serviceUUID The service that owns the characteristic.
@@ -485,6 +1164,174 @@ bool NimBLEClient::setValue(NimBLEUUID serviceUUID, NimBLEUUID characteristicUUI
 
 
 
+/**
+ * @brief Read the values of several characteristics using as few requests as possible.
+ * Read Multiple responses are a plain concatenation of the values and this host does not support
+ * Read Multiple Variable Length, so only characteristics whose length is fixed by their
+ * Characteristic Presentation Format descriptor are batched.  The others, and a batch whose
+ * response does not have the expected length, are read individually.  The presentation format
+ * is read once per characteristic.
+ * The characteristics can belong to different services of this client.
+ * @param [in] characteristics The characteristics to read.
+ * @return The values in the same order, an empty string for a characteristic that could not be read.
+ */
+std::vector<std::string> NimBLEClient::readValues(const std::vector<NimBLERemoteCharacteristic*> &characteristics) {
+    NIMBLE_LOGD(LOG_TAG, ">> readValues: %d characteristics", characteristics.size());
+    
+    std::vector<NimBLERemoteCharacteristic*> batch;
+    size_t maxLen = getMTU() - 1;
+    size_t batchLen = 0;
+    
+    // Sends the current batch, anything it could not deliver is read on its own.
+    auto flush = [&]() {
+        if(batch.size() == 1 || (batch.size() > 1 && readMultiple(batch, batchLen) != 0)) {
+            for(auto &pChr : batch) {
+                pChr->readValue();
+            }
+        }
+        batch.clear();
+        batchLen = 0;
+    };
+    
+    for(auto &pChr : characteristics) {
+        if(pChr == nullptr) {
+            continue;
+        }
+        
+        size_t len = pChr->getFixedLength();
+        if(len == 0 || len > maxLen) {
+            pChr->readValue();
+            continue;
+        }
+        
+        if(batchLen + len > maxLen || 
+           batch.size() == MYNEWT_VAL(BLE_GATT_READ_MAX_ATTRS) ||
+           (batch.size() + 1) * 2 > maxLen)
+        {
+            flush();
+        }
+        batch.push_back(pChr);
+        batchLen += len;
+    }
+    flush();
+    
+    std::vector<std::string> values;
+    values.reserve(characteristics.size());
+    for(auto &pChr : characteristics) {
+        values.push_back(pChr == nullptr ? "" : pChr->m_value);
+    }
+    
+    NIMBLE_LOGD(LOG_TAG, "<< readValues");
+    return values;
+} // readValues
+
+
+/**
+ * @brief Read a batch of characteristics with a single Read Multiple request.
+ * @param [in] batch The characteristics to read, in request order, all with a fixed length.
+ * @param [in] expectedLen The sum of the fixed lengths of the values.
+ * @return 0 if the values were read and split, otherwise non-zero.
+ */
+int NimBLEClient::readMultiple(const std::vector<NimBLERemoteCharacteristic*> &batch, size_t expectedLen) {
+    uint16_t handles[MYNEWT_VAL(BLE_GATT_READ_MAX_ATTRS)];
+    uint8_t  numHandles = 0;
+    
+    for(auto &pChr : batch) {
+        handles[numHandles++] = pChr->getHandle();
+    }
+    
+    m_semaphoreReadMultEvt.take("readMultiple");
+    
+    int rc = ble_gattc_read_mult(m_conn_id, handles, numHandles, 
+                                 NimBLEClient::readMultCB, this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gattc_read_mult: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        m_semaphoreReadMultEvt.give();
+        return rc;
+    }
+    
+    rc = m_semaphoreReadMultEvt.wait("readMultiple");
+    if (rc != 0) {
+        return rc;
+    }
+    
+    if (m_readMultValue.length() != expectedLen) {
+        NIMBLE_LOGD(LOG_TAG, "Read Multiple length mismatch: %d != %d", m_readMultValue.length(), expectedLen);
+        return BLE_HS_EBADDATA;
+    }
+    
+    size_t offset = 0;
+    for(auto &pChr : batch) {
+        size_t len = pChr->m_fixedLength;
+        pChr->m_value = m_readMultValue.substr(offset, len);
+        offset += len;
+    }
+    
+    return 0;
+} // readMultiple
+
+
+/**
+ * @brief STATIC Callback for the Read Multiple procedure.
+ */
+int NimBLEClient::readMultCB(uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                struct ble_gatt_attr *attr, void *arg) 
+{
+    NimBLEClient* client = (NimBLEClient*)arg;
+    
+    if(client->m_conn_id != conn_handle){
+        return 0;
+    }
+    
+    NIMBLE_LOGD(LOG_TAG, "Read Multiple complete; status=%d", error->status);
+    
+    if (error->status == 0) {
+        uint16_t len = OS_MBUF_PKTLEN(attr->om);
+        client->m_readMultValue.resize(len);
+        os_mbuf_copydata(attr->om, 0, len, &client->m_readMultValue[0]);
+    } else {
+        client->m_readMultValue.clear();
+    }
+    
+    client->m_semaphoreReadMultEvt.give(error->status);
+    return 0;
+} // readMultCB
+
+
+/**
+ * @brief Called from the host task when the controller has sent packets of this connection.
+ * Returns the credits to the streaming writer and wakes it up, nothing is done when no stream is active.
+ * @param [in] numPkts The number of HCI ACL packets completed.
+ */
+void NimBLEClient::onTxComplete(uint16_t numPkts) {
+    if(!m_txWaiting) {
+        return;
+    }
+    
+    uint32_t inFlight = m_txSent - m_txCompleted;
+    m_txCompleted += (numPkts < inFlight) ? numPkts : inFlight;
+    xSemaphoreGive(m_txCmplSem);
+} // onTxComplete
+
+
+/**
+ * @brief Get the number of HCI ACL packets the host sends for a write command.
+ * The controller reports completed ACL packets, a write larger than its buffers is fragmented.
+ * @param [in] attLen The length of the value written.
+ * @return The number of ACL packets.
+ */
+uint16_t NimBLEClient::txFragments(size_t attLen) {
+    // ATT opcode and handle, then the L2CAP header.
+    size_t pduLen = attLen + 3 + 4;
+    uint16_t aclPayload = ble_hs_hci_max_acl_payload_sz();
+    if(aclPayload == 0) {
+        return 1;
+    }
+    return (pduLen + aclPayload - 1) / aclPayload;
+} // txFragments
+
+
 /**
  * @brief Get the current mtu of this connection.
  */
@@ -538,8 +1385,14 @@ uint16_t NimBLEClient::getMTU() {
             client->m_semaphoreOpenEvt.give(1);
             client->m_semaphoreSearchCmplEvt.give(1);
             client->m_semeaphoreSecEvt.give(1);
+            client->m_semaphoreReadMultEvt.give(1);
+            if(client->m_txWaiting) {
+                xSemaphoreGive(client->m_txCmplSem);
+            }
             
-            if (client->m_pClientCallbacks != nullptr) {
+            if(NimBLEDevice::m_pExecutor != nullptr) {
+                NimBLEDevice::m_pExecutor->post({EXEC_EVT_DISCONNECT, 0, client->m_conn_id, 0, 0, client});
+            } else if (client->m_pClientCallbacks != nullptr) {
                 client->m_pClientCallbacks->onDisconnect(client);
             }
             
@@ -550,6 +1403,19 @@ uint16_t NimBLEClient::getMTU() {
             
             client->m_isConnected = false;
             client->m_waitingToConnect=false;
+            client->m_phyPending = false;
+            
+            // An asynchronous connection still waiting for its MTU exchange has failed.
+            if(client->m_exchangingMtu) {
+                client->m_exchangingMtu = false;
+                if(client->m_connectCb != nullptr) {
+                    client->connectComplete(BLE_HS_ENOTCONN);
+                }
+            }
+            
+            if(client->m_pConnManager != nullptr) {
+                client->m_pConnManager->onDisconnect(client, event->disconnect.reason);
+            }
             
             return 0;
         } // BLE_GAP_EVENT_DISCONNECT
@@ -577,21 +1443,28 @@ uint16_t NimBLEClient::getMTU() {
 
                 //  BLEDevice::updatePeerDevice(this, true, m_gattc_if);
                 client->m_isConnected = true;
+                client->m_dataLen = 27;
                 
-                if (client->m_pClientCallbacks != nullptr) {
+                if(NimBLEDevice::m_pExecutor != nullptr) {
+                    NimBLEDevice::m_pExecutor->post({EXEC_EVT_CONNECT, 0, client->m_conn_id, 0, 0, client});
+                } else if (client->m_pClientCallbacks != nullptr) {
                     client->m_pClientCallbacks->onConnect(client);
                 }
                 // Incase of a multiconnecting device we ignore this device when scanning since we are already connected to it
                 NimBLEDevice::addIgnored(client->m_peerAddress);
-                client->m_semaphoreOpenEvt.give(0);
+                
+                // Complete once the MTU is exchanged so the discovery already uses it.
+                if(client->applyLinkProfile(true)) {
+                    return 0;
+                }
 
             } else {
                 // Connection attempt failed
                 NIMBLE_LOGE(LOG_TAG, "Error: Connection failed; status=%d",
                             event->connect.status);
-                client->m_semaphoreOpenEvt.give(event->connect.status);
             }
-
+            
+            client->connectComplete(event->connect.status);
             return 0;
         } // BLE_GAP_EVENT_CONNECT
 
@@ -600,48 +1473,82 @@ uint16_t NimBLEClient::getMTU() {
                 return 0;
             
             NIMBLE_LOGD(LOG_TAG, "Notify Recieved for handle: %d",event->notify_rx.attr_handle);
-            if(!client->m_haveServices)
+            
+            // Only characteristics with a callback are in the table, see registerForNotify().
+            auto characteristic = client->m_notifyMap.find(event->notify_rx.attr_handle);
+            if(characteristic == client->m_notifyMap.end()) {
                 return 0;
+            }
             
-            for(auto &sPair : client->m_servicesMap){
-                // Dont waste cycles searching services without this handle in their range
-                if(sPair.second->getEndHandle() < event->notify_rx.attr_handle) {
-                    continue;
-                }
-                auto cMap = sPair.second->getCharacteristicsByHandle();
-                NIMBLE_LOGD(LOG_TAG, "checking service %s for handle: %d", sPair.second->getUUID().toString().c_str(),event->notify_rx.attr_handle);
-                auto characteristic = cMap->find(event->notify_rx.attr_handle);
-                if(characteristic != cMap->end()) {
-                    NIMBLE_LOGD(LOG_TAG, "Got Notification for characteristic %s", characteristic->second->toString().c_str());
-                    
-                    if (characteristic->second->m_notifyCallback != nullptr) {
-                        NIMBLE_LOGD(LOG_TAG, "Invoking callback for notification on characteristic %s", characteristic->second->toString().c_str());
-                        characteristic->second->m_notifyCallback(characteristic->second, event->notify_rx.om->om_data, event->notify_rx.om->om_len, !event->notify_rx.indication);
-                    }
-                    
-                    break;
-                }
+            if(NimBLEDevice::m_pNotifyQueue != nullptr) {
+                // The queue now owns the mbuf, the host must not free it.
+                NimBLEDevice::m_pNotifyQueue->push(characteristic->second, event->notify_rx.om, !event->notify_rx.indication);
+                event->notify_rx.om = nullptr;
+            } else {
+                characteristic->second->m_notifyCallback(characteristic->second, event->notify_rx.om->om_data, event->notify_rx.om->om_len, !event->notify_rx.indication);
             }
             
             return 0;
         } // BLE_GAP_EVENT_NOTIFY_RX
         
-        case BLE_GAP_EVENT_L2CAP_UPDATE_REQ: {
+        case BLE_GAP_EVENT_L2CAP_UPDATE_REQ:
+        case BLE_GAP_EVENT_CONN_UPDATE_REQ: {
+            if(client->m_conn_id != event->conn_update_req.conn_handle)
+                return 0;
+            
             NIMBLE_LOGD(LOG_TAG, "Peer requesting to update connection parameters");
-            //NimBLEDevice::gapEventHandler(event, arg);
+            if(client->m_pClientCallbacks != nullptr &&
+               !client->m_pClientCallbacks->onConnParamsUpdateRequest(client, event->conn_update_req.peer_params)) 
+            {
+                return BLE_ERR_CONN_PARMS;
+            }
             return 0;
         }
         
-/*      case BLE_GAP_EVENT_CONN_UPDATE: {
+        case BLE_GAP_EVENT_CONN_UPDATE: {
+            if(client->m_conn_id != event->conn_update.conn_handle)
+                return 0;
+            
+            if(event->conn_update.status == 0) {
+                NimBLELinkInfo info = client->getLinkInfo();
+                NIMBLE_LOGI(LOG_TAG, "Connection parameters updated; itvl=%d latency=%d timeout=%d",
+                            info.itvl, info.latency, info.supervisionTimeout);
+            } else {
+                NIMBLE_LOGW(LOG_TAG, "Connection parameters update failed; status=%d", event->conn_update.status);
+            }
+            return 0;
+        }
+        
+        case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE: {
+            if(client->m_conn_id != event->phy_updated.conn_handle)
+                return 0;
+            
+            NIMBLE_LOGI(LOG_TAG, "PHY updated; status=%d tx=%d rx=%d", event->phy_updated.status, 
+                        event->phy_updated.tx_phy, event->phy_updated.rx_phy);
+            
+            // Changing the interval during the PHY procedure would collide with it.
+            if(client->m_phyPending) {
+                client->m_phyPending = false;
+                client->requestConnParams();
+            }
+            return 0;
+        }
+        
+        case BLE_GAP_EVENT_MTU: {
+            if(client->m_conn_id != event->mtu.conn_handle)
+                return 0;
+            
+            NIMBLE_LOGI(LOG_TAG, "MTU updated; mtu=%d", event->mtu.value);
             return 0;
         }
-*/
         
         case BLE_GAP_EVENT_ENC_CHANGE: {
             if(client->m_conn_id != event->enc_change.conn_handle)
                 return 0; //BLE_HS_ENOTCONN BLE_ATT_ERR_INVALID_HANDLE
             
-            if(NimBLEDevice::m_securityCallbacks != nullptr) {
+            if(NimBLEDevice::m_securityCallbacks != nullptr && NimBLEDevice::m_pExecutor != nullptr) {
+                NimBLEDevice::m_pExecutor->post({EXEC_EVT_AUTH_COMPLETE, 0, client->m_conn_id, 0, 0, client});
+            } else if(NimBLEDevice::m_securityCallbacks != nullptr) {
                 struct ble_gap_conn_desc desc;
                 rc = ble_gap_conn_find(event->conn_update.conn_handle, &desc);
                 assert(rc == 0);
@@ -668,6 +1575,12 @@ uint16_t NimBLEClient::getMTU() {
                 
             } else if (event->passkey.params.action == BLE_SM_IOACT_NUMCMP) {
                 NIMBLE_LOGD(LOG_TAG, "Passkey on device's display: %d", event->passkey.params.numcmp);
+                // The worker injects the answer once the user has confirmed.
+                if(NimBLEDevice::m_pExecutor != nullptr) {
+                    NimBLEDevice::m_pExecutor->post({EXEC_EVT_CONFIRM_PIN, 0, client->m_conn_id, 
+                                                     event->passkey.params.numcmp, 0, client});
+                    return 0;
+                }
                 pkey.action = event->passkey.params.action;
                 if(client->m_pClientCallbacks != nullptr) {
                     pkey.numcmp_accept = client->m_pClientCallbacks->onConfirmPIN(event->passkey.params.numcmp);
@@ -689,6 +1602,10 @@ uint16_t NimBLEClient::getMTU() {
             ////////    
             } else if (event->passkey.params.action == BLE_SM_IOACT_INPUT) {
                 NIMBLE_LOGD(LOG_TAG, "Enter the passkey");
+                if(NimBLEDevice::m_pExecutor != nullptr) {
+                    NimBLEDevice::m_pExecutor->post({EXEC_EVT_PASSKEY_REQUEST, 0, client->m_conn_id, 0, 0, client});
+                    return 0;
+                }
                 pkey.action = event->passkey.params.action;
                 
                 if(client->m_pClientCallbacks != nullptr) {
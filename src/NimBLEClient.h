@@ -20,13 +20,23 @@
 #include "NimBLEAdvertisedDevice.h"
 #include "NimBLERemoteService.h"
 #include "NimBLEAddress.h"
+#include "NimBLELinkProfile.h"
+
+#include "NimBLEUUIDMap.h"
 
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 class NimBLERemoteService;
+class NimBLERemoteCharacteristic;
 class NimBLEClientCallbacks;
 class NimBLEAdvertisedDevice;
+class NimBLEClient;
+class NimBLEConnManager;
+
+typedef void (*client_complete_cb)(NimBLEClient* pClient, int rc, void* arg);
 
 /**
  * @brief A model of a %BLE client.
@@ -35,20 +45,29 @@ class NimBLEClient {
 public:
     bool                                       connect(NimBLEAdvertisedDevice* device, bool refreshServices = false);
     bool                                       connect(NimBLEAddress address, uint8_t type = BLE_ADDR_TYPE_PUBLIC, bool refreshServices = false);   // Connect to the remote BLE Server
+    int                                        connectAsync(NimBLEAddress address, uint8_t type, client_complete_cb completeCb, void* arg = nullptr);
+    int                                        discoverAsync(client_complete_cb completeCb, void* arg = nullptr);
     int                                        disconnect(uint8_t reason = BLE_ERR_REM_USER_CONN_TERM);                  // Disconnect from the remote BLE Server
     NimBLEAddress                              getPeerAddress();              // Get the address of the remote BLE Server
     int                                        getRssi();                     // Get the RSSI of the remote BLE Server
-    std::map<std::string, NimBLERemoteService*>*  getServices();                 // Get a map of the services offered by the remote BLE Server
+    NimBLEUUIDMap<NimBLERemoteService*>*  getServices();                 // Get a map of the services offered by the remote BLE Server
     NimBLERemoteService*                          getService(const char* uuid);  // Get a reference to a specified service offered by the remote BLE server.
     NimBLERemoteService*                          getService(NimBLEUUID uuid);   // Get a reference to a specified service offered by the remote BLE server.
     std::string                                getValue(NimBLEUUID serviceUUID, NimBLEUUID characteristicUUID);   // Get the value of a given characteristic at a given service.
     bool                                       setValue(NimBLEUUID serviceUUID, NimBLEUUID characteristicUUID, std::string value);   // Set the value of a given characteristic at a given service.
+    std::vector<std::string>                   readValues(const std::vector<NimBLERemoteCharacteristic*> &characteristics);  // Read several characteristics with Read Multiple requests.
     bool                                       isConnected();                 // Return true if we are connected.
     void                                       setClientCallbacks(NimBLEClientCallbacks *pClientCallbacks, bool deleteCallbacks = true);
     std::string                                toString();                    // Return a string representation of this client.
     uint16_t                                   getConnId();
     uint16_t                                   getMTU();
     bool                                       secureConnection();
+    void                                       setLazyDiscovery(bool lazy);
+    void                                       setOwnAddrType(uint8_t type);
+    void                                       setConnectTimeout(uint32_t timeoutMs);
+    void                                       setLinkProfile(link_profile profile);
+    void                                       setLinkProfile(const NimBLELinkProfile &profile);
+    NimBLELinkInfo                             getLinkInfo();
 
 
 private:
@@ -56,29 +75,76 @@ private:
     ~NimBLEClient();
     friend class NimBLEDevice;
     friend class NimBLERemoteService;
+    friend class NimBLERemoteCharacteristic;
+    friend class NimBLEConnManager;
+    friend class NimBLEEventExecutor;
 
     static int          handleGapEvent(struct ble_gap_event *event, void *arg);
     static int          serviceDiscoveredCB(uint16_t conn_handle, const struct ble_gatt_error *error, const struct ble_gatt_svc *service, void *arg);
     void                clearServices();   // Clear any existing services.
-    bool                retrieveServices();  //Retrieve services from the server
+    bool                retrieveServices(bool useCache = true);  //Retrieve services from the server
+    NimBLERemoteService* discoverService(NimBLEUUID uuid);
+    void                discoverNextService();
+    void                discoveryComplete(int rc);
+    void                connectComplete(int rc);
+    bool                applyLinkProfile(bool connecting);
+    void                requestConnParams();
+    static int          mtuExchangeCB(uint16_t conn_handle, const struct ble_gatt_error *error, uint16_t mtu, void *arg);
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+    bool                readDatabaseHash();
+    static int          dbHashReadCB(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg);
+    bool                getPeerIdAddr(ble_addr_t* addr);
+    bool                loadServicesCache();
+    void                storeServicesCache();
+#endif
     void                onHostReset();
+    void                onTxComplete(uint16_t numPkts);
+    uint16_t            txFragments(size_t attLen);
+    int                 readMultiple(const std::vector<NimBLERemoteCharacteristic*> &batch, size_t expectedLen);
+    static int          readMultCB(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg);
 
-    NimBLEAddress    m_peerAddress = NimBLEAddress("\0\0\0\0\0\0");   // The BD address of the remote server.
+    NimBLEAddress    m_peerAddress;         // The BD address and address type of the remote server.
     uint16_t         m_conn_id;
     bool             m_haveServices = false;    // Have we previously obtain the set of services from the remote server.
     bool             m_isConnected = false;     // Are we currently connected.
     bool             m_waitingToConnect =false;
     bool             m_deleteCallbacks = true;
+    bool             m_lazyDiscovery = false;   // Discover only the attributes requested by the application.
+    uint8_t          m_ownAddrType = BLE_OWN_ADDR_PUBLIC;
+    uint32_t         m_connectTimeout = 30000;  // Connection attempt timeout in ms.
+    NimBLELinkProfile m_linkProfile = {};       // Requested once connected, all zero leaves the defaults.
+    uint16_t         m_dataLen = 27;            // Payload octets set with the Data Length Extension.
+    bool             m_exchangingMtu = false;   // The connection completes once the MTU exchange is done.
+    bool             m_phyPending = false;      // The interval is requested once the PHY update is done.
     //uint16_t       m_mtu = 23;
 
 
     NimBLEClientCallbacks*  m_pClientCallbacks = nullptr;
+    client_complete_cb      m_connectCb = nullptr;      // Pending connectAsync completion.
+    void*                   m_connectCbArg = nullptr;
+    client_complete_cb      m_discoverCb = nullptr;     // Pending discoverAsync completion.
+    void*                   m_discoverCbArg = nullptr;
+    NimBLEConnManager*      m_pConnManager = nullptr;   // Set when the connection manager owns this client.
 
     FreeRTOS::Semaphore     m_semaphoreOpenEvt       = FreeRTOS::Semaphore("OpenEvt");
     FreeRTOS::Semaphore     m_semaphoreSearchCmplEvt = FreeRTOS::Semaphore("SearchCmplEvt");
     FreeRTOS::Semaphore     m_semeaphoreSecEvt       = FreeRTOS::Semaphore("Security");
-
-    std::map<std::string, NimBLERemoteService*> m_servicesMap;
+    FreeRTOS::Semaphore     m_semaphoreReadMultEvt   = FreeRTOS::Semaphore("ReadMultEvt");
+    volatile uint32_t       m_txSent = 0;               // HCI ACL packets queued by the streaming writer, written by the application task.
+    volatile uint32_t       m_txCompleted = 0;          // HCI ACL packets completed by the controller, written by the host task.
+    volatile bool           m_txWaiting = false;        // A streaming writer is waiting for completed packets.
+    SemaphoreHandle_t       m_txCmplSem = nullptr;      // Wakes the streaming writer, given only while m_txWaiting.
+    portMUX_TYPE            m_txMux = portMUX_INITIALIZER_UNLOCKED;  // Claims the credit counters for one stream.
+    std::string             m_readMultValue;            // Concatenated values of the last Read Multiple response.
+
+    NimBLEUUIDMap<NimBLERemoteService*> m_servicesMap;
+    NimBLEUUIDMap<NimBLERemoteService*>::iterator m_discIt;   // Next service to be discovered.
+    std::unordered_map<uint16_t, NimBLERemoteCharacteristic*> m_notifyMap;  // Characteristics with a notify callback by value handle.
+    uint32_t                m_discProcCount = 0;                      // GATT procedures used by the last discovery.
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+    uint8_t                 m_dbHash[16];                             // Database Hash of the peer.
+    bool                    m_haveDbHash = false;
+#endif
 
 }; // class NimBLEClient 
 
@@ -96,6 +162,7 @@ public:
     virtual bool onSecurityRequest(){return false;}
     virtual void onAuthenticationComplete(ble_gap_conn_desc){};
     virtual bool onConfirmPIN(uint32_t pin){return false;}
+    virtual bool onConnParamsUpdateRequest(NimBLEClient* pClient, const ble_gap_upd_params* params){return true;}
 };
 
 #endif // CONFIG_BT_ENABLED
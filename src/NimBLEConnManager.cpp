@@ -0,0 +1,687 @@
+/*
+ * NimBLEConnManager.cpp
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEConnManager.h"
+#include "NimBLEDevice.h"
+#include "NimBLEUtils.h"
+#include "NimBLELog.h"
+
+#include "nimble/nimble_port.h"
+
+/// Delay before retrying when the controller is busy with a scan or another connection attempt.
+#define NIMBLE_CONN_MGR_BUSY_RETRY_MS   100
+
+static const char* LOG_TAG = "NimBLEConnManager";
+
+
+NimBLEConnManager::NimBLEConnManager() {
+} // NimBLEConnManager
+
+
+/**
+ * @brief Add a peer to keep connected, a client is created for it.
+ * @param [in] address The address and address type of the peer.
+ * @return False if the manager is running.
+ */
+bool NimBLEConnManager::addPeer(const NimBLEAddress &address) {
+    if(m_running) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot add a peer while running");
+        return false;
+    }
+
+    if(findPeer(address) != nullptr) {
+        return true;
+    }
+
+    Peer peer = {};
+    peer.info.address = address;
+    peer.info.state = CONN_PEER_IDLE;
+    peer.pClient = NimBLEDevice::createClient();
+    peer.pClient->m_pConnManager = this;
+    m_peers.push_back(peer);
+    return true;
+} // addPeer
+
+
+/**
+ * @brief Remove a peer, its client is disconnected and deleted.
+ * @param [in] address The address of the peer.
+ * @return False if the manager is running or the client could not be deleted.
+ */
+bool NimBLEConnManager::removePeer(const NimBLEAddress &address) {
+    if(m_running) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot remove a peer while running");
+        return false;
+    }
+
+    Peer* pPeer = findPeer(address);
+    if(pPeer == nullptr) {
+        return false;
+    }
+
+    pPeer->pClient->m_pConnManager = nullptr;
+    if(!NimBLEDevice::deleteClient(pPeer->pClient)) {
+        pPeer->pClient->m_pConnManager = this;
+        return false;
+    }
+
+    m_peers.erase(m_peers.begin() + (pPeer - &m_peers[0]));
+    return true;
+} // removePeer
+
+
+/**
+ * @brief Get the client of a peer.
+ * @param [in] address The address of the peer.
+ * @return The client or nullptr if the address is not a peer.
+ */
+NimBLEClient* NimBLEConnManager::getClient(const NimBLEAddress &address) {
+    Peer* pPeer = findPeer(address);
+    return pPeer != nullptr ? pPeer->pClient : nullptr;
+} // getClient
+
+
+/**
+ * @brief Get the state and counters of a peer.
+ * @param [in] address The address of the peer.
+ * @param [out] info Receives a copy of the peer state.
+ * @return False if the address is not a peer.
+ */
+bool NimBLEConnManager::getPeerInfo(const NimBLEAddress &address, NimBLEConnPeerInfo* info) {
+    Peer* pPeer = findPeer(address);
+    if(pPeer == nullptr) {
+        return false;
+    }
+    *info = pPeer->info;
+    return true;
+} // getPeerInfo
+
+
+/**
+ * @brief Get the number of peers.
+ */
+size_t NimBLEConnManager::getPeerCount() {
+    return m_peers.size();
+} // getPeerCount
+
+
+/**
+ * @brief Set the callbacks invoked when peers become ready or are lost.
+ */
+void NimBLEConnManager::setCallbacks(NimBLEConnManagerCallbacks* pCallbacks) {
+    m_pCallbacks = pCallbacks;
+} // setCallbacks
+
+
+/**
+ * @brief Set the address type used by this device when connecting, applied by start().
+ * @param [in] type One of the BLE_OWN_ADDR_* types, BLE_OWN_ADDR_PUBLIC by default.
+ */
+void NimBLEConnManager::setOwnAddrType(uint8_t type) {
+    m_ownAddrType = type;
+} // setOwnAddrType
+
+
+/**
+ * @brief Set how long a single connection attempt may take, applied by start().
+ * A peer that is not advertising holds up the other peers for this long.
+ * @param [in] timeoutMs The attempt timeout in milliseconds, 2000 by default.
+ */
+void NimBLEConnManager::setAttemptTimeout(uint32_t timeoutMs) {
+    m_attemptTimeout = timeoutMs;
+} // setAttemptTimeout
+
+
+/**
+ * @brief Set the delays between the attempts to a peer that keeps failing.
+ * @param [in] minMs The delay after the first failure, doubled after each further failure.
+ * @param [in] maxMs The longest delay.
+ */
+void NimBLEConnManager::setBackoff(uint32_t minMs, uint32_t maxMs) {
+    m_backoffMin = minMs > 0 ? minMs : 1;
+    m_backoffMax = maxMs > m_backoffMin ? maxMs : m_backoffMin;
+} // setBackoff
+
+
+/**
+ * @brief Connect to the peers through the controller white list, applied by start().
+ * @param [in] enable True to connect to whichever missing peer advertises first.
+ */
+void NimBLEConnManager::setWhiteList(bool enable) {
+    m_useWhiteList = enable;
+} // setWhiteList
+
+
+/**
+ * @brief Consider the peers ready as soon as they are connected, applied by start().
+ * The clients then discover their attributes lazily, see NimBLEClient::setLazyDiscovery().
+ * @param [in] lazy True to skip the database discovery.
+ */
+void NimBLEConnManager::setLazyDiscovery(bool lazy) {
+    m_lazyDiscovery = lazy;
+} // setLazyDiscovery
+
+
+/**
+ * @brief Start connecting the peers, the attempts run in the host task.
+ * @return False if the manager is already running.
+ */
+bool NimBLEConnManager::start() {
+    if(m_running) {
+        return false;
+    }
+
+    if(!m_timerInit) {
+        ble_npl_callout_init(&m_timer, nimble_port_get_dflt_eventq(), NimBLEConnManager::timerCb, this);
+        m_timerInit = true;
+    }
+
+    m_startTime = FreeRTOS::getTimeSinceStart();
+    m_stats.ready = 0;
+    m_stats.allReadyMs = 0;
+
+    for(auto &peer : m_peers) {
+        peer.pClient->setOwnAddrType(m_ownAddrType);
+        peer.pClient->setConnectTimeout(m_attemptTimeout);
+        peer.pClient->setLazyDiscovery(m_lazyDiscovery);
+        peer.info.state = CONN_PEER_IDLE;
+        peer.info.failures = 0;
+        peer.info.wantedSince = m_startTime;
+    }
+
+    m_running = true;
+    rearm(0);
+    return true;
+} // start
+
+
+/**
+ * @brief Stop connecting, the established links are kept.
+ */
+void NimBLEConnManager::stop() {
+    m_running = false;
+    if(m_timerInit) {
+        ble_npl_callout_stop(&m_timer);
+    }
+    if(m_pending) {
+        ble_gap_conn_cancel();
+    }
+} // stop
+
+
+/**
+ * @brief Check if the manager is running.
+ */
+bool NimBLEConnManager::isRunning() {
+    return m_running;
+} // isRunning
+
+
+/**
+ * @brief Check if every peer is connected and discovered.
+ */
+bool NimBLEConnManager::isAllReady() {
+    return !m_peers.empty() && m_stats.ready == m_peers.size();
+} // isAllReady
+
+
+/**
+ * @brief Get the counters of the manager.
+ * @return A copy of the counters.
+ */
+NimBLEConnManagerStats NimBLEConnManager::getStats() {
+    return m_stats;
+} // getStats
+
+
+/**
+ * @brief Reset the attempt counters and the latency histograms, of the peers as well.
+ */
+void NimBLEConnManager::resetStats() {
+    uint32_t ready = m_stats.ready;
+    uint32_t allReadyMs = m_stats.allReadyMs;
+    m_stats = NimBLEConnManagerStats();
+    m_stats.ready = ready;
+    m_stats.allReadyMs = allReadyMs;
+
+    for(auto &peer : m_peers) {
+        peer.info.connects = 0;
+        for(auto &bin : peer.info.latencyHist) {
+            bin = 0;
+        }
+    }
+} // resetStats
+
+
+/**
+ * @brief Run the scheduler from the host task when a wait expires.
+ * @param [in] event The timer event, its argument is the manager.
+ */
+/*STATIC*/void NimBLEConnManager::timerCb(ble_npl_event* event) {
+    NimBLEConnManager* pManager = (NimBLEConnManager*)ble_npl_event_get_arg(event);
+    pManager->schedule();
+} // timerCb
+
+
+/**
+ * @brief Start the next connection attempt if none is in progress, or wait for the next peer due.
+ * Runs in the host task.
+ */
+void NimBLEConnManager::schedule() {
+    if(!m_running) {
+        return;
+    }
+
+    // Links established by the application before start() only need their discovery.
+    for(auto &peer : m_peers) {
+        if(peer.info.state == CONN_PEER_IDLE && peer.pClient->isConnected()) {
+            linkUp(&peer);
+        }
+    }
+
+    if(m_pending) {
+        // Called again when the attempt completes.
+        return;
+    }
+
+    if(!NimBLEDevice::m_synced) {
+        rearm(NIMBLE_CONN_MGR_BUSY_RETRY_MS);
+        return;
+    }
+
+    uint32_t now = FreeRTOS::getTimeSinceStart();
+    if(m_useWhiteList ? startWhiteList(now) : startDirect(now)) {
+        return;
+    }
+
+    // Nothing is due, wake up when the first backoff expires.
+    bool waiting = false;
+    uint32_t wait = 0;
+    for(auto &peer : m_peers) {
+        if(peer.info.state != CONN_PEER_BACKOFF) {
+            continue;
+        }
+        int32_t left = (int32_t)(peer.info.nextAttempt - now);
+        uint32_t delay = left > 0 ? left : 0;
+        if(!waiting || delay < wait) {
+            wait = delay;
+            waiting = true;
+        }
+    }
+
+    if(waiting) {
+        rearm(wait);
+    }
+} // schedule
+
+
+/**
+ * @brief Try the due peers in turn until a connection attempt starts.
+ * @param [in] now The current time in milliseconds since boot.
+ * @return True if an attempt was started or a retry is armed.
+ */
+bool NimBLEConnManager::startDirect(uint32_t now) {
+    for(size_t i = 0; i < m_peers.size(); i++) {
+        size_t idx = (m_cursor + i) % m_peers.size();
+        Peer &peer = m_peers[idx];
+        if(!isDue(peer, now)) {
+            continue;
+        }
+
+        m_pending = true;
+        m_attemptStart = now;
+        int rc = peer.pClient->connectAsync(peer.info.address, peer.info.address.getType(),
+                                            NimBLEConnManager::connectCB, this);
+        if(rc == 0) {
+            NIMBLE_LOGD(LOG_TAG, "Connecting to %s", peer.info.address.toString().c_str());
+            peer.info.state = CONN_PEER_CONNECTING;
+            m_stats.attempts++;
+            m_cursor = idx + 1;
+            return true;
+        }
+
+        m_pending = false;
+        if(rc == BLE_HS_EBUSY || rc == BLE_HS_EALREADY) {
+            rearm(NIMBLE_CONN_MGR_BUSY_RETRY_MS);
+            return true;
+        }
+
+        attemptFailed(&peer, rc, now);
+    }
+
+    return false;
+} // startDirect
+
+
+/**
+ * @brief Load the due peers in the white list and connect to the first of them that advertises.
+ * @param [in] now The current time in milliseconds since boot.
+ * @return True if an attempt was started or a retry is armed.
+ */
+bool NimBLEConnManager::startWhiteList(uint32_t now) {
+    std::vector<ble_addr_t> addrs;
+    for(auto &peer : m_peers) {
+        if(isDue(peer, now)) {
+            addrs.push_back(peer.info.address.getBase());
+        }
+    }
+
+    if(addrs.empty()) {
+        return false;
+    }
+
+    int rc = ble_gap_wl_set(addrs.data(), addrs.size());
+    if(rc == 0) {
+        rc = ble_gap_connect(m_ownAddrType, NULL, m_attemptTimeout, NULL,
+                             NimBLEConnManager::handleGapEvent, this);
+    }
+
+    if(rc == BLE_HS_EBUSY || rc == BLE_HS_EALREADY) {
+        rearm(NIMBLE_CONN_MGR_BUSY_RETRY_MS);
+        return true;
+    }
+
+    for(auto &peer : m_peers) {
+        if(!isDue(peer, now)) {
+            continue;
+        }
+        if(rc == 0) {
+            peer.info.state = CONN_PEER_CONNECTING;
+        } else {
+            attemptFailed(&peer, rc, now);
+        }
+    }
+
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "White list connection failed; rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "Connecting to %d peers through the white list", addrs.size());
+    m_pending = true;
+    m_attemptStart = now;
+    m_stats.attempts++;
+    return true;
+} // startWhiteList
+
+
+/**
+ * @brief Handle the events of a white list connection attempt until it is handed to the client of the peer.
+ * @return 0.
+ */
+/*STATIC*/int NimBLEConnManager::handleGapEvent(struct ble_gap_event *event, void *arg) {
+    NimBLEConnManager* pManager = (NimBLEConnManager*)arg;
+
+    if(event->type != BLE_GAP_EVENT_CONNECT) {
+        return 0;
+    }
+
+    Peer* pPeer = nullptr;
+    uint32_t now = FreeRTOS::getTimeSinceStart();
+    pManager->m_pending = false;
+
+    if(event->connect.status == 0) {
+        struct ble_gap_conn_desc desc;
+        if(ble_gap_conn_find(event->connect.conn_handle, &desc) == 0) {
+            pPeer = pManager->findPeer(NimBLEAddress(desc.peer_id_addr));
+            if(pPeer == nullptr) {
+                pPeer = pManager->findPeer(NimBLEAddress(desc.peer_ota_addr));
+            }
+        }
+        if(pPeer == nullptr || pPeer->pClient->isConnected()) {
+            NIMBLE_LOGE(LOG_TAG, "White list connection to an unexpected device");
+            ble_gap_terminate(event->connect.conn_handle, BLE_ERR_REM_USER_CONN_TERM);
+            pPeer = nullptr;
+        }
+    }
+
+    // The peers that did not connect wait for the next attempt.
+    for(auto &peer : pManager->m_peers) {
+        if(peer.info.state != CONN_PEER_CONNECTING || &peer == pPeer) {
+            continue;
+        }
+        if(event->connect.status == 0 || event->connect.status == BLE_HS_ETIMEOUT || !pManager->m_running) {
+            peer.info.state = CONN_PEER_IDLE;
+        } else {
+            pManager->attemptFailed(&peer, event->connect.status, now);
+        }
+    }
+
+    if(pPeer == nullptr) {
+        pManager->schedule();
+        return 0;
+    }
+
+    // Hand the connection to the client as if it had started the attempt, connectCB() follows.
+    NimBLEClient* pClient = pPeer->pClient;
+    pClient->m_peerAddress = pPeer->info.address;
+    pClient->m_waitingToConnect = true;
+    pClient->m_connectCb = NimBLEConnManager::connectCB;
+    pClient->m_connectCbArg = pManager;
+    ble_gap_set_event_cb(event->connect.conn_handle, NimBLEClient::handleGapEvent, pClient);
+    return NimBLEClient::handleGapEvent(event, pClient);
+} // handleGapEvent
+
+
+/**
+ * @brief Completion of the connection attempt of a client, called from the host task.
+ */
+/*STATIC*/void NimBLEConnManager::connectCB(NimBLEClient* pClient, int rc, void* arg) {
+    NimBLEConnManager* pManager = (NimBLEConnManager*)arg;
+    Peer* pPeer = pManager->findPeer(pClient);
+    uint32_t now = FreeRTOS::getTimeSinceStart();
+
+    pManager->m_pending = false;
+
+    if(pPeer != nullptr) {
+        if(rc == 0) {
+            uint32_t latency = now - pManager->m_attemptStart;
+            NIMBLE_LOGD(LOG_TAG, "Connected to %s in %d ms", pPeer->info.address.toString().c_str(), latency);
+            addLatency(pPeer->info.latencyHist, latency);
+            addLatency(pManager->m_stats.latencyHist, latency);
+            pPeer->info.connects++;
+            pManager->linkUp(pPeer);
+        } else if(!pManager->m_running) {
+            pPeer->info.state = CONN_PEER_IDLE;
+        } else {
+            pManager->attemptFailed(pPeer, rc, now);
+        }
+    }
+
+    pManager->schedule();
+} // connectCB
+
+
+/**
+ * @brief Completion of the database discovery of a client, called from the host task.
+ */
+/*STATIC*/void NimBLEConnManager::discoverCB(NimBLEClient* pClient, int rc, void* arg) {
+    NimBLEConnManager* pManager = (NimBLEConnManager*)arg;
+    Peer* pPeer = pManager->findPeer(pClient);
+
+    // The link may have been lost before the discovery ended.
+    if(pPeer == nullptr || pPeer->info.state != CONN_PEER_DISCOVERING) {
+        return;
+    }
+
+    if(rc == 0) {
+        pManager->peerReady(pPeer);
+        return;
+    }
+
+    NIMBLE_LOGE(LOG_TAG, "Discovery of %s failed; rc=%d", pPeer->info.address.toString().c_str(), rc);
+    pPeer->info.lastError = rc;
+    pClient->disconnect();
+} // discoverCB
+
+
+/**
+ * @brief A peer is connected, discover its database unless the discovery is lazy.
+ */
+void NimBLEConnManager::linkUp(Peer* pPeer) {
+    if(m_lazyDiscovery) {
+        peerReady(pPeer);
+        return;
+    }
+
+    pPeer->info.state = CONN_PEER_DISCOVERING;
+    int rc = pPeer->pClient->discoverAsync(NimBLEConnManager::discoverCB, this);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot start the discovery; rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        pPeer->info.lastError = rc;
+        pPeer->pClient->disconnect();
+    }
+} // linkUp
+
+
+/**
+ * @brief Back off a peer after a failed attempt.
+ */
+void NimBLEConnManager::attemptFailed(Peer* pPeer, int rc, uint32_t now) {
+    uint32_t delay = m_backoffMin;
+    for(uint16_t i = 1; i < pPeer->info.failures + 1 && delay < m_backoffMax; i++) {
+        delay <<= 1;
+    }
+    if(delay > m_backoffMax) {
+        delay = m_backoffMax;
+    }
+
+    NIMBLE_LOGD(LOG_TAG, "Attempt to %s failed; rc=%d, retry in %d ms",
+                pPeer->info.address.toString().c_str(), rc, delay);
+
+    pPeer->info.state = CONN_PEER_BACKOFF;
+    pPeer->info.lastError = rc;
+    pPeer->info.failures++;
+    pPeer->info.nextAttempt = now + delay;
+    m_stats.failures++;
+} // attemptFailed
+
+
+/**
+ * @brief A peer is connected and discovered.
+ */
+void NimBLEConnManager::peerReady(Peer* pPeer) {
+    uint32_t now = FreeRTOS::getTimeSinceStart();
+
+    pPeer->info.state = CONN_PEER_READY;
+    pPeer->info.lastError = 0;
+    pPeer->info.failures = 0;
+    pPeer->info.readyMs = now - pPeer->info.wantedSince;
+    m_stats.ready++;
+
+    if(m_pCallbacks != nullptr) {
+        m_pCallbacks->onReady(pPeer->pClient);
+    }
+
+    if(m_stats.allReadyMs == 0 && isAllReady()) {
+        // Keep 0 for "not yet".
+        m_stats.allReadyMs = (now - m_startTime) > 0 ? (now - m_startTime) : 1;
+        NIMBLE_LOGI(LOG_TAG, "All %d peers ready in %d ms", m_peers.size(), m_stats.allReadyMs);
+        if(m_pCallbacks != nullptr) {
+            m_pCallbacks->onAllReady(m_stats.allReadyMs);
+        }
+    }
+} // peerReady
+
+
+/**
+ * @brief The link of a client was lost, called from the client GAP event handler.
+ * @param [in] pClient The client that was disconnected.
+ * @param [in] reason The reason of the disconnection.
+ */
+void NimBLEConnManager::onDisconnect(NimBLEClient* pClient, int reason) {
+    Peer* pPeer = findPeer(pClient);
+    // A link lost while connecting was already reported as a failed attempt.
+    if(pPeer == nullptr || (pPeer->info.state != CONN_PEER_DISCOVERING && pPeer->info.state != CONN_PEER_READY)) {
+        return;
+    }
+
+    uint32_t now = FreeRTOS::getTimeSinceStart();
+    bool wasReady = pPeer->info.state == CONN_PEER_READY;
+
+    m_stats.disconnects++;
+    pPeer->info.wantedSince = now;
+
+    if(wasReady) {
+        m_stats.ready--;
+        pPeer->info.state = CONN_PEER_IDLE;
+        pPeer->info.lastError = reason;
+        if(m_pCallbacks != nullptr) {
+            m_pCallbacks->onLost(pClient, reason);
+        }
+    } else {
+        // Dropped before it was ready, do not reconnect in a tight loop.
+        attemptFailed(pPeer, reason, now);
+    }
+
+    schedule();
+} // onDisconnect
+
+
+/**
+ * @brief Run the scheduler from the host task after a delay.
+ */
+void NimBLEConnManager::rearm(uint32_t delayMs) {
+    ble_npl_callout_reset(&m_timer, ble_npl_time_ms_to_ticks32(delayMs));
+} // rearm
+
+
+/**
+ * @brief Check if a connection attempt to a peer should be made now.
+ */
+bool NimBLEConnManager::isDue(const Peer &peer, uint32_t now) {
+    if(peer.pClient->isConnected()) {
+        return false;
+    }
+    return peer.info.state == CONN_PEER_IDLE ||
+           (peer.info.state == CONN_PEER_BACKOFF && (int32_t)(now - peer.info.nextAttempt) >= 0);
+} // isDue
+
+
+/**
+ * @brief Find a peer by address, the address type is not compared.
+ */
+NimBLEConnManager::Peer* NimBLEConnManager::findPeer(const NimBLEAddress &address) {
+    for(auto &peer : m_peers) {
+        if(peer.info.address.equals(address)) {
+            return &peer;
+        }
+    }
+    return nullptr;
+} // findPeer
+
+
+/**
+ * @brief Find a peer by client.
+ */
+NimBLEConnManager::Peer* NimBLEConnManager::findPeer(NimBLEClient* pClient) {
+    for(auto &peer : m_peers) {
+        if(peer.pClient == pClient) {
+            return &peer;
+        }
+    }
+    return nullptr;
+} // findPeer
+
+
+/**
+ * @brief Count a connection latency in a histogram.
+ */
+/*STATIC*/void NimBLEConnManager::addLatency(uint32_t* hist, uint32_t latencyMs) {
+    uint8_t bin = 0;
+    uint32_t bound = NIMBLE_CONN_MGR_HIST_BASE_MS;
+    while(bin < NIMBLE_CONN_MGR_HIST_BINS - 1 && latencyMs >= bound) {
+        bin++;
+        bound <<= 1;
+    }
+    hist[bin]++;
+} // addLatency
+
+#endif // CONFIG_BT_ENABLED
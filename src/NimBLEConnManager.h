@@ -0,0 +1,171 @@
+/*
+ * NimBLEConnManager.h
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef COMPONENTS_NIMBLECONNMANAGER_H_
+#define COMPONENTS_NIMBLECONNMANAGER_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEAddress.h"
+
+#include "host/ble_gap.h"
+#include "nimble/nimble_npl.h"
+
+#include <vector>
+
+/// Number of bins of the connect latency histograms.
+#define NIMBLE_CONN_MGR_HIST_BINS       8
+/// Upper bound of the first histogram bin in ms, each following bin doubles it, the last bin is open.
+#define NIMBLE_CONN_MGR_HIST_BASE_MS    25
+
+class NimBLEClient;
+class NimBLEConnManagerCallbacks;
+
+
+/**
+ * @brief The state of a peer of the connection manager.
+ */
+typedef enum {
+    CONN_PEER_IDLE,             // Waiting for its connection attempt.
+    CONN_PEER_CONNECTING,       // A connection attempt to this peer is in progress.
+    CONN_PEER_DISCOVERING,      // Connected, the peer database is being discovered.
+    CONN_PEER_READY,            // Connected and discovered.
+    CONN_PEER_BACKOFF,          // The last attempt failed, waiting before retrying.
+} conn_peer_state;
+
+
+/**
+ * @brief The state and counters of a peer of the connection manager.
+ */
+struct NimBLEConnPeerInfo {
+    NimBLEAddress   address;
+    conn_peer_state state;
+    int             lastError;      // Host error of the last failed attempt or disconnect reason, 0 if none.
+    uint16_t        failures;       // Failed attempts since the peer was last ready.
+    uint32_t        nextAttempt;    // Milliseconds since boot of the next attempt while backing off.
+    uint32_t        wantedSince;    // Milliseconds since boot when the peer was last found missing.
+    uint32_t        readyMs;        // Time from wantedSince to ready of the last connection.
+    uint32_t        connects;       // Successful connections.
+    uint32_t        latencyHist[NIMBLE_CONN_MGR_HIST_BINS];    // Latency of the successful attempts.
+};
+
+
+/**
+ * @brief Counters of the connection manager.
+ */
+struct NimBLEConnManagerStats {
+    uint32_t        attempts;       // Connection attempts started.
+    uint32_t        failures;       // Attempts that failed or timed out.
+    uint32_t        disconnects;    // Established links that were lost.
+    uint32_t        ready;          // Peers currently ready.
+    uint32_t        allReadyMs;     // Time from start() until every peer was ready, 0 until then.
+    uint32_t        latencyHist[NIMBLE_CONN_MGR_HIST_BINS];    // Latency of the successful attempts of all peers.
+};
+
+
+/**
+ * @brief Keeps a set of peers connected and discovered.
+ *
+ * The controller runs one connection attempt at a time, so the manager starts the attempts
+ * back to back from the host task, each with a short timeout, and discovers the database of
+ * the links already established while the next attempt runs.  A peer that fails is retried
+ * with an exponential backoff and a lost link is reconnected straight away.
+ *
+ * With the white list enabled every missing peer is loaded in the controller white list and a
+ * single attempt connects to whichever of them advertises first.  The controller white list
+ * is shared with the scan allow list, the two cannot be used at the same time.
+ */
+class NimBLEConnManager {
+public:
+    bool                    addPeer(const NimBLEAddress &address);
+    bool                    removePeer(const NimBLEAddress &address);
+    NimBLEClient*           getClient(const NimBLEAddress &address);
+    bool                    getPeerInfo(const NimBLEAddress &address, NimBLEConnPeerInfo* info);
+    size_t                  getPeerCount();
+    void                    setCallbacks(NimBLEConnManagerCallbacks* pCallbacks);
+    void                    setOwnAddrType(uint8_t type);
+    void                    setAttemptTimeout(uint32_t timeoutMs);
+    void                    setBackoff(uint32_t minMs, uint32_t maxMs);
+    void                    setWhiteList(bool enable);
+    void                    setLazyDiscovery(bool lazy);
+    bool                    start();
+    void                    stop();
+    bool                    isRunning();
+    bool                    isAllReady();
+    NimBLEConnManagerStats  getStats();
+    void                    resetStats();
+
+private:
+    friend class NimBLEDevice;
+    friend class NimBLEClient;
+
+    NimBLEConnManager();
+
+    struct Peer {
+        NimBLEConnPeerInfo  info;
+        NimBLEClient*       pClient;
+    };
+
+    static void             timerCb(ble_npl_event* event);
+    static int              handleGapEvent(struct ble_gap_event *event, void *arg);
+    static void             connectCB(NimBLEClient* pClient, int rc, void* arg);
+    static void             discoverCB(NimBLEClient* pClient, int rc, void* arg);
+    void                    schedule();
+    void                    linkUp(Peer* pPeer);
+    bool                    startDirect(uint32_t now);
+    bool                    startWhiteList(uint32_t now);
+    void                    attemptFailed(Peer* pPeer, int rc, uint32_t now);
+    void                    peerReady(Peer* pPeer);
+    void                    onDisconnect(NimBLEClient* pClient, int reason);
+    void                    rearm(uint32_t delayMs);
+    Peer*                   findPeer(const NimBLEAddress &address);
+    Peer*                   findPeer(NimBLEClient* pClient);
+    bool                    isDue(const Peer &peer, uint32_t now);
+    static void             addLatency(uint32_t* hist, uint32_t latencyMs);
+
+    std::vector<Peer>       m_peers;
+    NimBLEConnManagerCallbacks* m_pCallbacks = nullptr;
+    ble_npl_callout         m_timer;
+    bool                    m_timerInit = false;
+    bool                    m_running = false;
+    bool                    m_pending = false;      // A connection attempt is in progress.
+    bool                    m_useWhiteList = false;
+    bool                    m_lazyDiscovery = false;
+    uint8_t                 m_ownAddrType = BLE_OWN_ADDR_PUBLIC;
+    uint16_t                m_cursor = 0;           // Peer tried first by the next direct attempt.
+    uint32_t                m_attemptTimeout = 2000;
+    uint32_t                m_backoffMin = 250;
+    uint32_t                m_backoffMax = 16000;
+    uint32_t                m_attemptStart = 0;
+    uint32_t                m_startTime = 0;
+    NimBLEConnManagerStats  m_stats = {};
+};
+
+
+/**
+ * @brief Callbacks of the connection manager, invoked from the host task.
+ */
+class NimBLEConnManagerCallbacks {
+public:
+    virtual ~NimBLEConnManagerCallbacks() {};
+    /**
+     * @brief Called when a peer is connected and its database has been discovered.
+     */
+    virtual void onReady(NimBLEClient* pClient) {};
+    /**
+     * @brief Called when the link to a ready peer is lost, it is reconnected automatically.
+     */
+    virtual void onLost(NimBLEClient* pClient, int reason) {};
+    /**
+     * @brief Called the first time every peer is ready after start().
+     */
+    virtual void onAllReady(uint32_t elapsedMs) {};
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // COMPONENTS_NIMBLECONNMANAGER_H_
@@ -26,6 +26,9 @@
 #include "host/ble_hs.h"
 #include "host/util/util.h"
 #include "services/gap/ble_svc_gap.h"
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+#include "store/config/ble_store_config.h"
+#endif
 
 #ifdef ARDUINO_ARCH_ESP32
 #include "esp32-hal-bt.h"
@@ -51,13 +54,17 @@ static const char* LOG_TAG = "NimBLEDevice";
 //BLEServer* BLEDevice::m_pServer = nullptr;
 bool            initialized = false;
 NimBLEScan*     NimBLEDevice::m_pScan = nullptr;
+NimBLEConnManager* NimBLEDevice::m_pConnManager = nullptr;
 uint32_t        NimBLEDevice::m_passkey = 123456;
 bool            NimBLEDevice::m_synced = false;
 
 gap_event_handler           NimBLEDevice::m_customGapHandler = nullptr;
 ble_gap_event_listener      NimBLEDevice::m_listener;
 std::list <NimBLEClient*>   NimBLEDevice::m_cList;
-std::list <NimBLEAddress>   NimBLEDevice::m_ignoreList;
+std::unordered_set<NimBLEAddress> NimBLEDevice::m_ignoreSet;
+SemaphoreHandle_t           NimBLEDevice::m_ignoreMutex = xSemaphoreCreateMutex();
+NimBLENotifyQueue*          NimBLEDevice::m_pNotifyQueue = nullptr;
+NimBLEEventExecutor*        NimBLEDevice::m_pExecutor = nullptr;
 NimBLESecurityCallbacks*    NimBLEDevice::m_securityCallbacks = nullptr;
   
 //esp_ble_sec_act_t BLEDevice::m_securityLevel = (esp_ble_sec_act_t)0;
@@ -84,6 +91,104 @@ NimBLESecurityCallbacks*    NimBLEDevice::m_securityCallbacks = nullptr;
 } // getScan
 
 
+/**
+ * @brief Get the connection manager that keeps a set of peers connected.
+ * @return The connection manager.  This is a singleton object.  The caller should not
+ * try and release/delete it.
+ */
+/* STATIC */ NimBLEConnManager* NimBLEDevice::getConnManager() {
+    if (m_pConnManager == nullptr) {
+        m_pConnManager = new NimBLEConnManager();
+    }
+    return m_pConnManager;
+} // getConnManager
+
+
+/**
+ * @brief Deliver notification callbacks from worker tasks instead of the host task.
+ * Received values are queued without copying and the callbacks run in the worker tasks,
+ * so slow callbacks no longer hold up the host. Must be called before subscribing, once set
+ * the queue cannot be changed.
+ * @param [in] depth The maximum number of pending notifications.
+ * @param [in] policy What to do with a notification that arrives when the queue is full.
+ * @param [in] numWorkers The number of worker tasks, with more than one callbacks may run concurrently.
+ * @param [in] stackSize The stack size of each worker task.
+ * @param [in] priority The priority of the worker tasks.
+ * @return True if the queue was created.
+ */
+/* STATIC */ bool NimBLEDevice::setNotifyQueue(uint16_t depth, notify_overflow_policy policy,
+                                               uint8_t numWorkers, uint32_t stackSize, UBaseType_t priority) 
+{
+    if(m_pNotifyQueue != nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Notification queue already set");
+        return false;
+    }
+    
+    NimBLENotifyQueue* pQueue = new NimBLENotifyQueue(depth, policy);
+    if(!pQueue->start(numWorkers, stackSize, priority)) {
+        delete pQueue;
+        return false;
+    }
+    
+    m_pNotifyQueue = pQueue;
+    return true;
+} // setNotifyQueue
+
+
+/**
+ * @brief Get the counters of the notification queue.
+ * @return The queue counters, all zero if the queue is not used.
+ */
+/* STATIC */ NimBLENotifyQueueStats NimBLEDevice::getNotifyQueueStats() {
+    if(m_pNotifyQueue == nullptr) {
+        return NimBLENotifyQueueStats();
+    }
+    return m_pNotifyQueue->getStats();
+} // getNotifyQueueStats
+
+
+/**
+ * @brief Run the client and scan callbacks in worker tasks instead of the host task.
+ * The host task only queues a small record of each event, so the callbacks may block or call
+ * the synchronous client APIs.  The callbacks of one connection run in order on the same worker.
+ * Must be called before connecting or scanning, once set the executor cannot be changed.
+ * @param [in] depth The number of pending events of each worker, a queue grows for connection events.
+ * @param [in] numWorkers The number of worker tasks, the connections are spread over them.
+ * @param [in] stackSize The stack size of each worker task.
+ * @param [in] priority The priority of the worker tasks.
+ * @return True if the executor was created.
+ */
+/* STATIC */ bool NimBLEDevice::setEventExecutor(uint16_t depth, uint8_t numWorkers, uint32_t stackSize,
+                                                 UBaseType_t priority)
+{
+    if(m_pExecutor != nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Event executor already set");
+        return false;
+    }
+
+    NimBLEEventExecutor* pExecutor = new NimBLEEventExecutor(depth);
+    if(!pExecutor->start(numWorkers, stackSize, priority)) {
+        delete pExecutor;
+        return false;
+    }
+
+    m_pExecutor = pExecutor;
+    return true;
+} // setEventExecutor
+
+
+/**
+ * @brief Get the counters and dispatch latency of the event executor.
+ * @return The executor counters, all zero if the executor is not used.
+ */
+/* STATIC */ NimBLEEventExecutorStats NimBLEDevice::getEventExecutorStats() {
+    if(m_pExecutor == nullptr) {
+        return NimBLEEventExecutorStats();
+    }
+    return m_pExecutor->getStats();
+} // getEventExecutorStats
+
+
 /**
  * @brief Creates a new client object and maintains a list of all client objects
  * each client can connect to 1 peripheral device. 
@@ -107,6 +212,11 @@ NimBLESecurityCallbacks*    NimBLEDevice::m_securityCallbacks = nullptr;
         return false;
     }
     
+    if(pClient->m_pConnManager != nullptr) {
+        NIMBLE_LOGE(LOG_TAG, "Client belongs to the connection manager, use removePeer()");
+        return false;
+    }
+    
     if(pClient->m_isConnected) {
         if (pClient->disconnect() != 0) {
             return false;
@@ -125,6 +235,10 @@ NimBLESecurityCallbacks*    NimBLEDevice::m_securityCallbacks = nullptr;
         }
     }
     
+    if(m_pExecutor != nullptr) {
+        m_pExecutor->purge(pClient);
+    }
+    
     m_cList.remove(pClient);
     delete pClient;
     
@@ -239,6 +353,21 @@ NimBLESecurityCallbacks*    NimBLEDevice::m_securityCallbacks = nullptr;
 } // onReset
 
 
+/**
+ * @brief The controller has sent packets of a connection, pass it to the client using it
+ * so streaming writes can refill the controller buffers.
+ */
+/* STATIC */  void NimBLEDevice::onTxComplete(uint16_t conn_handle, uint16_t num_pkts)
+{
+    for(auto it = m_cList.cbegin(); it != m_cList.cend(); ++it) {
+        if((*it)->getConnId() == conn_handle && (*it)->isConnected()) {
+            (*it)->onTxComplete(num_pkts);
+            break;
+        }
+    }
+} // onTxComplete
+
+
 /**
  * @brief Host resynced with controller, all clear to make calls.
  */
@@ -309,6 +438,7 @@ NimBLESecurityCallbacks*    NimBLEDevice::m_securityCallbacks = nullptr;
         // Setup callbacks for host events 
         ble_hs_cfg.reset_cb = NimBLEDevice::onReset;
         ble_hs_cfg.sync_cb = NimBLEDevice::onSync;
+        ble_hs_cfg.tx_cmpl_cb = NimBLEDevice::onTxComplete;
         
         // Set initial security capabilities
         ble_hs_cfg.sm_io_cap = BLE_SM_IO_CAP_NO_IO; 
@@ -460,6 +590,54 @@ void NimBLEDevice::setSecurityCallbacks(NimBLESecurityCallbacks* callbacks) {
 } // setSecurityCallbacks
 
 
+/**
+ * @brief Delete the bond of a peer and its GATT cache entry.
+ * @param [in] address The identity address of the peer, if connected the peer is disconnected.
+ * @return True if the bond was deleted.
+ */
+/*STATIC*/ bool NimBLEDevice::deleteBond(const NimBLEAddress &address) {
+    ble_addr_t peerAddr = address.getBase();
+    
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+    ble_store_gatt_cache_delete(&peerAddr);
+#endif
+    
+    int rc = ble_gap_unpair(&peerAddr);
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gap_unpair: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+    
+    return true;
+} // deleteBond
+
+
+/**
+ * @brief Delete all the bonds and their GATT cache entries.
+ * @return True if the bonds were deleted.
+ */
+/*STATIC*/ bool NimBLEDevice::deleteAllBonds() {
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+    ble_addr_t peers[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
+    int numPeers = 0;
+    
+    if(ble_store_util_bonded_peers(peers, &numPeers, MYNEWT_VAL(BLE_STORE_MAX_BONDS)) == 0) {
+        for(int i = 0; i < numPeers; i++) {
+            ble_store_gatt_cache_delete(&peers[i]);
+        }
+    }
+#endif
+    
+    int rc = ble_store_clear();
+    if(rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_store_clear: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        return false;
+    }
+    
+    return true;
+} // deleteAllBonds
+
+
 /**
  * @brief Start the connection securing and authorization for this connection.
  * @param Connection id of the client.
@@ -480,17 +658,15 @@ void NimBLEDevice::setSecurityCallbacks(NimBLESecurityCallbacks* callbacks) {
 
 
 /**
- * @brief Check if the device address is on our ignore list.
+ * @brief Check if the device address is on our ignore list, whatever its type.
+ * The list is shared by the host task and the application tasks, it is accessed under a mutex.
  * @return True if ignoring.
  */
 /*STATIC*/ bool NimBLEDevice::isIgnored(NimBLEAddress address) {
-    for(auto &it : m_ignoreList) {
-        if(it.equals(address)){
-            return true;
-        }
-    }
-
-    return false;
+    xSemaphoreTake(m_ignoreMutex, portMAX_DELAY);
+    bool ignored = !m_ignoreSet.empty() && m_ignoreSet.count(NimBLEAddress((uint64_t)address)) > 0;
+    xSemaphoreGive(m_ignoreMutex);
+    return ignored;
 }
 
 
@@ -499,7 +675,9 @@ void NimBLEDevice::setSecurityCallbacks(NimBLESecurityCallbacks* callbacks) {
  * @param Address of the device we want to ignore.
  */
 /*STATIC*/ void NimBLEDevice::addIgnored(NimBLEAddress address) {
-    m_ignoreList.push_back(address);
+    xSemaphoreTake(m_ignoreMutex, portMAX_DELAY);
+    m_ignoreSet.insert(NimBLEAddress((uint64_t)address));
+    xSemaphoreGive(m_ignoreMutex);
 }
 
 
@@ -508,12 +686,9 @@ void NimBLEDevice::setSecurityCallbacks(NimBLESecurityCallbacks* callbacks) {
  * @param Address of the device we want to remove from the list.
  */
 /*STATIC*/void  NimBLEDevice::removeIgnored(NimBLEAddress address) {
-    for(auto it = m_ignoreList.begin(); it != m_ignoreList.end(); ++it) {
-        if((*it).equals(address)){
-            m_ignoreList.erase(it);
-            return;
-        }
-    }
+    xSemaphoreTake(m_ignoreMutex, portMAX_DELAY);
+    m_ignoreSet.erase(NimBLEAddress((uint64_t)address));
+    xSemaphoreGive(m_ignoreMutex);
 }
 
 
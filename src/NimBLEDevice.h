@@ -21,12 +21,16 @@
 #include "NimBLEUtils.h"
 #include "NimBLEClient.h"
 #include "NimBLESecurity.h"
+#include "NimBLENotifyQueue.h"
+#include "NimBLEEventExecutor.h"
+#include "NimBLEConnManager.h"
 
 #include "esp_bt.h"
 
 #include <map>
 #include <string>
 #include <list>
+#include <unordered_set>
 
 #define BLEDevice                       NimBLEDevice
 #define BLEClient                       NimBLEClient
@@ -64,6 +68,7 @@ public:
     static NimBLEAddress    getAddress();
     static std::string      toString();
     static NimBLEScan*      getScan();                     // Get the scan object
+    static NimBLEConnManager* getConnManager();
     static NimBLEClient*    createClient();
     static bool             deleteClient(NimBLEClient* pClient);
     static void             setPower(esp_power_level_t powerLevel);
@@ -76,6 +81,8 @@ public:
     static void             setSecurityPasskey(uint32_t pin);
     static uint32_t         getSecurityPasskey();
     static void             setSecurityCallbacks(NimBLESecurityCallbacks* pCallbacks);
+    static bool             deleteBond(const NimBLEAddress &address);
+    static bool             deleteAllBonds();
     static int              setMTU(uint16_t mtu);
     static uint16_t         getMTU();
     static bool             isIgnored(NimBLEAddress address);
@@ -83,25 +90,37 @@ public:
     static void             removeIgnored(NimBLEAddress address);
     
     static std::list<NimBLEClient*>* getClientList(); 
+    static bool             setNotifyQueue(uint16_t depth, notify_overflow_policy policy = NOTIFY_DROP_OLDEST,
+                                           uint8_t numWorkers = 1, uint32_t stackSize = 4096, UBaseType_t priority = 1);
+    static NimBLENotifyQueueStats getNotifyQueueStats();
+    static bool             setEventExecutor(uint16_t depth, uint8_t numWorkers = 1, uint32_t stackSize = 4096,
+                                             UBaseType_t priority = 1);
+    static NimBLEEventExecutorStats getEventExecutorStats();
         
 private:
     friend class NimBLEClient;
     friend class NimBLEScan;
+    friend class NimBLEConnManager;
 //  friend class NimBLERemoteService;
 //  friend class NimBLERemoteCharacteristic;
     
     static void        onReset(int reason);
     static void        onSync(void);
+    static void        onTxComplete(uint16_t conn_handle, uint16_t num_pkts);
     static void        host_task(void *param);
     static int         startSecurity(   uint16_t conn_id);
     
     static bool                       m_synced;
     static NimBLEScan*                m_pScan;
+    static NimBLEConnManager*         m_pConnManager;
     static ble_gap_event_listener     m_listener;
     static uint32_t                   m_passkey;
     static std::list <NimBLEClient*>  m_cList;
-    static std::list <NimBLEAddress>  m_ignoreList;
+    static std::unordered_set<NimBLEAddress> m_ignoreSet;
+    static SemaphoreHandle_t          m_ignoreMutex;
     static NimBLESecurityCallbacks*   m_securityCallbacks;
+    static NimBLENotifyQueue*         m_pNotifyQueue;
+    static NimBLEEventExecutor*       m_pExecutor;
     
 public:
     static gap_event_handler          m_customGapHandler;
@@ -0,0 +1,464 @@
+/*
+ * NimBLEEventExecutor.cpp
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEDevice.h"
+#include "NimBLEEventExecutor.h"
+#include "NimBLELog.h"
+
+#include "host/ble_hs.h"
+#include "esp_timer.h"
+
+static const char* LOG_TAG = "NimBLEEventExecutor";
+
+
+/**
+ * @brief Constructor.
+ * @param [in] depth The number of pending events of each worker, a queue grows for connection events.
+ */
+NimBLEEventExecutor::NimBLEEventExecutor(uint16_t depth) {
+    m_depth = depth > 4 ? depth : 4;
+    if(m_depth > UINT16_MAX / NIMBLE_EXEC_MAX_GROWTH) {
+        m_depth = UINT16_MAX / NIMBLE_EXEC_MAX_GROWTH;
+    }
+} // NimBLEEventExecutor
+
+
+/**
+ * @brief Destructor, stops the workers and discards the pending events.
+ * Each worker finishes the callback it is running before it exits.
+ */
+NimBLEEventExecutor::~NimBLEEventExecutor() {
+    portENTER_CRITICAL(&m_mux);
+    m_stopping = true;
+    portEXIT_CRITICAL(&m_mux);
+
+    for(;;) {
+        for(auto &pWorker : m_workers) {
+            xSemaphoreGive(pWorker->itemsAvailable);
+        }
+
+        portENTER_CRITICAL(&m_mux);
+        uint8_t running = m_running;
+        portEXIT_CRITICAL(&m_mux);
+        if(running == 0) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+
+    for(auto &pWorker : m_workers) {
+        vSemaphoreDelete(pWorker->itemsAvailable);
+        delete pWorker;
+    }
+} // ~NimBLEEventExecutor
+
+
+/**
+ * @brief Start the worker tasks that invoke the callbacks.
+ * @param [in] numWorkers The number of worker tasks, the connections are spread over them.
+ * @param [in] stackSize The stack size of each worker task.
+ * @param [in] priority The priority of the worker tasks.
+ * @return True if all the workers were started.
+ */
+bool NimBLEEventExecutor::start(uint8_t numWorkers, uint32_t stackSize, UBaseType_t priority) {
+    for(uint8_t i = 0; i < (numWorkers > 0 ? numWorkers : 1); i++) {
+        Worker* pWorker = new Worker();
+        pWorker->pExecutor = this;
+        pWorker->entries.resize(m_depth);
+        pWorker->head = 0;
+        pWorker->count = 0;
+        pWorker->pCurrent = nullptr;
+        pWorker->itemsAvailable = xSemaphoreCreateCounting(m_depth, 0);
+
+        portENTER_CRITICAL(&m_mux);
+        m_running++;
+        portEXIT_CRITICAL(&m_mux);
+
+        if(pWorker->itemsAvailable == nullptr ||
+           xTaskCreate(NimBLEEventExecutor::workerTask, "nimble_exec", stackSize,
+                       pWorker, priority, &pWorker->task) != pdPASS)
+        {
+            NIMBLE_LOGE(LOG_TAG, "Failed to start event worker %d", i);
+            portENTER_CRITICAL(&m_mux);
+            m_running--;
+            portEXIT_CRITICAL(&m_mux);
+            if(pWorker->itemsAvailable != nullptr) {
+                vSemaphoreDelete(pWorker->itemsAvailable);
+            }
+            delete pWorker;
+            return false;
+        }
+        m_workers.push_back(pWorker);
+    }
+
+    return true;
+} // start
+
+
+/**
+ * @brief Hand an event to the worker of its connection, called from the host task.
+ * @param [in] evt The event, its posted time is set here.
+ * @return False if the event was a scan event and was dropped.
+ */
+bool NimBLEEventExecutor::post(NimBLEExecEvent evt) {
+    Worker* pWorker = m_workers[evt.connHandle % m_workers.size()];
+    bool droppable = evt.type == EXEC_EVT_SCAN_RESULT || evt.type == EXEC_EVT_SCAN_DEPARTED;
+    bool queued = false;
+
+    evt.postedUs = (uint32_t)esp_timer_get_time();
+
+    portENTER_CRITICAL(&m_mux);
+    m_stats.posted++;
+    portEXIT_CRITICAL(&m_mux);
+
+    do {
+        portENTER_CRITICAL(&m_mux);
+        uint16_t size = pWorker->entries.size();
+        uint16_t limit = droppable ? m_depth - m_depth / 4 : size;
+        if(pWorker->count < limit) {
+            pWorker->entries[(pWorker->head + pWorker->count) % size] = evt;
+            pWorker->count++;
+            if(pWorker->count > m_stats.highWater) {
+                m_stats.highWater = pWorker->count;
+            }
+            queued = true;
+        } else if(droppable) {
+            m_stats.dropped++;
+        }
+        portEXIT_CRITICAL(&m_mux);
+
+        if(queued) {
+            xSemaphoreGive(pWorker->itemsAvailable);
+            return true;
+        }
+    } while(!droppable && grow(pWorker));
+
+    if(!droppable) {
+        // Losing a connection event would leave the application out of step with the link.
+        NIMBLE_LOGW(LOG_TAG, "Event queue full, running the events of connection %d in the host task", evt.connHandle);
+        runInline(pWorker, evt);
+    }
+    return !droppable;
+} // post
+
+
+/**
+ * @brief Double the queue of a worker, called from the host task only.
+ * @param [in] pWorker The worker whose queue is full.
+ * @return False if the queue has reached its largest size or the memory could not be allocated.
+ */
+bool NimBLEEventExecutor::grow(Worker* pWorker) {
+    // Only the host task resizes the queue, the size can be read without the lock.
+    size_t size = pWorker->entries.size();
+    if(size >= (size_t)m_depth * NIMBLE_EXEC_MAX_GROWTH) {
+        return false;
+    }
+
+    std::vector<NimBLEExecEvent> entries(size * 2);
+
+    portENTER_CRITICAL(&m_mux);
+    for(uint16_t i = 0; i < pWorker->count; i++) {
+        entries[i] = pWorker->entries[(pWorker->head + i) % size];
+    }
+    pWorker->entries.swap(entries);
+    pWorker->head = 0;
+    m_stats.grown++;
+    portEXIT_CRITICAL(&m_mux);
+
+    // The previous ring is freed here, outside of the critical section.
+    return true;
+} // grow
+
+
+/**
+ * @brief Run an event in the host task after the events of its connection that are still queued.
+ * A callback of that connection already started by the worker may still be running.
+ * @param [in] pWorker The worker of the connection.
+ * @param [in] evt The event that could not be queued.
+ */
+void NimBLEEventExecutor::runInline(Worker* pWorker, const NimBLEExecEvent &evt) {
+    std::vector<NimBLEExecEvent> pending;
+    pending.reserve(pWorker->entries.size() + 1);
+
+    portENTER_CRITICAL(&m_mux);
+    uint16_t size = pWorker->entries.size();
+    uint16_t kept = 0;
+    for(uint16_t i = 0; i < pWorker->count; i++) {
+        NimBLEExecEvent queued = pWorker->entries[(pWorker->head + i) % size];
+        if(queued.connHandle == evt.connHandle) {
+            pending.push_back(queued);
+        } else {
+            pWorker->entries[(pWorker->head + kept++) % size] = queued;
+        }
+    }
+    pWorker->count = kept;
+    m_stats.inlined += pending.size() + 1;
+    portEXIT_CRITICAL(&m_mux);
+
+    pending.push_back(evt);
+    for(auto &event : pending) {
+        if(!dispatch(event)) {
+            portENTER_CRITICAL(&m_mux);
+            m_stats.stale++;
+            portEXIT_CRITICAL(&m_mux);
+        }
+    }
+} // runInline
+
+
+/**
+ * @brief Remove the oldest pending event of a worker and mark its object as in use.
+ * @param [in] pWorker The worker.
+ * @param [out] evt The event removed.
+ * @return True if there was a pending event.
+ */
+bool NimBLEEventExecutor::pop(Worker* pWorker, NimBLEExecEvent* evt) {
+    bool found = false;
+
+    portENTER_CRITICAL(&m_mux);
+    // A stopping worker leaves the remaining events to the destructor.
+    if(pWorker->count > 0 && !m_stopping) {
+        *evt = pWorker->entries[pWorker->head];
+        pWorker->head = (pWorker->head + 1) % pWorker->entries.size();
+        pWorker->count--;
+        pWorker->pCurrent = evt->pObj;
+        found = true;
+    } else {
+        pWorker->pCurrent = nullptr;
+    }
+    portEXIT_CRITICAL(&m_mux);
+
+    return found;
+} // pop
+
+
+/**
+ * @brief Discard the pending events of an object and wait until none of its callbacks is running.
+ * Called before a client is deleted, from a callback of that client only its pending events are discarded.
+ * @param [in] pObj The client whose events are removed.
+ */
+void NimBLEEventExecutor::purge(void* pObj) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    bool busy;
+
+    do {
+        busy = false;
+
+        portENTER_CRITICAL(&m_mux);
+        for(auto &pWorker : m_workers) {
+            uint16_t size = pWorker->entries.size();
+            uint16_t kept = 0;
+            for(uint16_t i = 0; i < pWorker->count; i++) {
+                NimBLEExecEvent evt = pWorker->entries[(pWorker->head + i) % size];
+                if(evt.pObj != pObj) {
+                    pWorker->entries[(pWorker->head + kept++) % size] = evt;
+                }
+            }
+            pWorker->count = kept;
+
+            if(pWorker->pCurrent == pObj && pWorker->task != self) {
+                busy = true;
+            }
+        }
+        portEXIT_CRITICAL(&m_mux);
+
+        if(busy) {
+            vTaskDelay(1);
+        }
+    } while(busy);
+} // purge
+
+
+/**
+ * @brief Get the executor counters.
+ * @return A copy of the counters.
+ */
+NimBLEEventExecutorStats NimBLEEventExecutor::getStats() {
+    portENTER_CRITICAL(&m_mux);
+    NimBLEEventExecutorStats stats = m_stats;
+    stats.depth = 0;
+    for(auto &pWorker : m_workers) {
+        stats.depth += pWorker->count;
+    }
+    portEXIT_CRITICAL(&m_mux);
+
+    return stats;
+} // getStats
+
+
+/**
+ * @brief Reset the executor counters.
+ */
+void NimBLEEventExecutor::resetStats() {
+    portENTER_CRITICAL(&m_mux);
+    m_stats = {};
+    portEXIT_CRITICAL(&m_mux);
+} // resetStats
+
+
+/**
+ * @brief Count the time from the host event to its callback.
+ * @param [in] latencyUs The latency in microseconds.
+ */
+void NimBLEEventExecutor::addLatency(uint32_t latencyUs) {
+    uint8_t bin = 0;
+    uint32_t bound = NIMBLE_EXEC_HIST_BASE_US;
+    while(bin < NIMBLE_EXEC_HIST_BINS - 1 && latencyUs >= bound) {
+        bin++;
+        bound <<= 1;
+    }
+
+    portENTER_CRITICAL(&m_mux);
+    m_stats.latencyHist[bin]++;
+    m_stats.dispatched++;
+    if(latencyUs > m_stats.maxLatencyUs) {
+        m_stats.maxLatencyUs = latencyUs;
+    }
+    portEXIT_CRITICAL(&m_mux);
+} // addLatency
+
+
+/**
+ * @brief Invoke the callback of an event.
+ * @param [in] evt The event.
+ * @return False if the connection or the device of the event was gone.
+ */
+bool NimBLEEventExecutor::dispatch(const NimBLEExecEvent &evt) {
+    switch(evt.type) {
+        case EXEC_EVT_CONNECT:
+        case EXEC_EVT_DISCONNECT:
+        case EXEC_EVT_AUTH_COMPLETE:
+        case EXEC_EVT_PASSKEY_REQUEST:
+        case EXEC_EVT_CONFIRM_PIN: {
+            NimBLEClient* pClient = (NimBLEClient*)evt.pObj;
+            NimBLEClientCallbacks* pCallbacks = pClient->m_pClientCallbacks;
+
+            if(evt.type == EXEC_EVT_CONNECT) {
+                if(pCallbacks != nullptr) {
+                    pCallbacks->onConnect(pClient);
+                }
+
+            } else if(evt.type == EXEC_EVT_DISCONNECT) {
+                if(pCallbacks != nullptr) {
+                    pCallbacks->onDisconnect(pClient);
+                }
+
+            } else if(evt.type == EXEC_EVT_AUTH_COMPLETE) {
+                struct ble_gap_conn_desc desc;
+                if(ble_gap_conn_find(evt.connHandle, &desc) != 0) {
+                    return false;
+                }
+                if(pCallbacks != nullptr) {
+                    pCallbacks->onAuthenticationComplete(desc);
+                }
+
+            } else {
+                // The pairing waits for the answer, up to the security manager timeout.
+                struct ble_sm_io pkey = {0};
+                if(evt.type == EXEC_EVT_PASSKEY_REQUEST) {
+                    pkey.action = BLE_SM_IOACT_INPUT;
+                    pkey.passkey = pCallbacks != nullptr ? pCallbacks->onPassKeyRequest() : 0;
+                } else {
+                    pkey.action = BLE_SM_IOACT_NUMCMP;
+                    pkey.numcmp_accept = pCallbacks != nullptr ? pCallbacks->onConfirmPIN(evt.value) : false;
+                }
+
+                int rc = ble_sm_inject_io(evt.connHandle, &pkey);
+                NIMBLE_LOGD(LOG_TAG, "ble_sm_inject_io result: %d", rc);
+                if(rc == BLE_HS_ENOTCONN) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        case EXEC_EVT_SCAN_RESULT:
+        case EXEC_EVT_SCAN_DEPARTED: {
+            NimBLEScan* pScan = (NimBLEScan*)evt.pObj;
+            NimBLEAdvertisedDeviceCallbacks* pCallbacks = pScan->m_pAdvertisedDeviceCallbacks;
+
+            // The slot may have been given to another device or the results reallocated since,
+            // while the callback runs the host task neither updates nor reuses it.
+            NimBLEAdvertisedDevice* pDevice = pScan->holdDevice(evt.value, evt.key);
+            if(pDevice == nullptr) {
+                return false;
+            }
+
+            if(pCallbacks != nullptr) {
+                if(evt.type == EXEC_EVT_SCAN_DEPARTED) {
+                    pCallbacks->onDeparted(pDevice);
+                } else {
+                    if(evt.flags & NIMBLE_EXEC_FLAG_ARRIVED) {
+                        pCallbacks->onArrived(pDevice);
+                    }
+                    pCallbacks->onResult(pDevice);
+                }
+            }
+            if(evt.flags & NIMBLE_EXEC_FLAG_REMOVED) {
+                pScan->endDeparture(evt.value);
+            }
+            pScan->releaseDevice();
+            return true;
+        }
+
+        case EXEC_EVT_SCAN_COMPLETE: {
+            NimBLEScan* pScan = (NimBLEScan*)evt.pObj;
+            if(pScan->m_scanCompleteCB != nullptr) {
+                pScan->m_scanCompleteCB(pScan->getResults());
+            }
+            return true;
+        }
+
+        default:
+            return true;
+    }
+} // dispatch
+
+
+/**
+ * @brief Worker task, invokes the callbacks of the events queued for it in order.
+ */
+void NimBLEEventExecutor::workerTask(void* pvParameters) {
+    Worker* pWorker = (Worker*)pvParameters;
+    NimBLEEventExecutor* pExecutor = pWorker->pExecutor;
+    NimBLEExecEvent evt;
+
+    for(;;) {
+        xSemaphoreTake(pWorker->itemsAvailable, portMAX_DELAY);
+
+        portENTER_CRITICAL(&pExecutor->m_mux);
+        bool stopping = pExecutor->m_stopping;
+        portEXIT_CRITICAL(&pExecutor->m_mux);
+        if(stopping) {
+            break;
+        }
+
+        // Drain the queue, a purge may have left the semaphore ahead or behind the entries.
+        while(pExecutor->pop(pWorker, &evt)) {
+            uint32_t latencyUs = (uint32_t)esp_timer_get_time() - evt.postedUs;
+
+            if(pExecutor->dispatch(evt)) {
+                pExecutor->addLatency(latencyUs);
+            } else {
+                portENTER_CRITICAL(&pExecutor->m_mux);
+                pExecutor->m_stats.stale++;
+                portEXIT_CRITICAL(&pExecutor->m_mux);
+            }
+        }
+    }
+
+    portENTER_CRITICAL(&pExecutor->m_mux);
+    pWorker->pCurrent = nullptr;
+    pExecutor->m_running--;
+    portEXIT_CRITICAL(&pExecutor->m_mux);
+    vTaskDelete(nullptr);
+} // workerTask
+
+#endif // CONFIG_BT_ENABLED
@@ -0,0 +1,136 @@
+/*
+ * NimBLEEventExecutor.h
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef COMPONENTS_NIMBLEEVENTEXECUTOR_H_
+#define COMPONENTS_NIMBLEEVENTEXECUTOR_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <vector>
+
+/// Number of bins of the dispatch latency histogram.
+#define NIMBLE_EXEC_HIST_BINS       8
+/// Upper bound of the first histogram bin in microseconds, each following bin doubles it, the last bin is open.
+#define NIMBLE_EXEC_HIST_BASE_US    250
+
+/// A worker queue full of connection events grows up to this many times its initial depth.
+#define NIMBLE_EXEC_MAX_GROWTH      8
+
+/// Set in NimBLEExecEvent::flags when a scan result is also the arrival of the device.
+#define NIMBLE_EXEC_FLAG_ARRIVED    0x01
+/// Set in NimBLEExecEvent::flags when a departed device was removed from the scan results.
+#define NIMBLE_EXEC_FLAG_REMOVED    0x02
+
+
+/**
+ * @brief The user callbacks the executor can run outside of the host task.
+ */
+typedef enum {
+    EXEC_EVT_CONNECT,           // NimBLEClientCallbacks::onConnect().
+    EXEC_EVT_DISCONNECT,        // NimBLEClientCallbacks::onDisconnect().
+    EXEC_EVT_AUTH_COMPLETE,     // NimBLEClientCallbacks::onAuthenticationComplete().
+    EXEC_EVT_PASSKEY_REQUEST,   // NimBLEClientCallbacks::onPassKeyRequest(), the answer is injected afterwards.
+    EXEC_EVT_CONFIRM_PIN,       // NimBLEClientCallbacks::onConfirmPIN(), the answer is injected afterwards.
+    EXEC_EVT_SCAN_RESULT,       // NimBLEAdvertisedDeviceCallbacks::onArrived() and onResult().
+    EXEC_EVT_SCAN_DEPARTED,     // NimBLEAdvertisedDeviceCallbacks::onDeparted().
+    EXEC_EVT_SCAN_COMPLETE,     // The scan complete callback given to NimBLEScan::start().
+} exec_event_type;
+
+
+/**
+ * @brief A deferred callback, queued by the host task and run by a worker.
+ */
+struct NimBLEExecEvent {
+    uint8_t     type;           // exec_event_type.
+    uint8_t     flags;          // NIMBLE_EXEC_FLAG_*.
+    uint16_t    connHandle;     // Connection of a client event, events of one connection run in order.
+    uint32_t    value;          // PIN to confirm, or position of the device in the scan results.
+    uint64_t    key;            // Packed address and type of a scan result device.
+    void*       pObj;           // The client or the scan.
+    uint32_t    postedUs;       // Set by post().
+};
+
+
+/**
+ * @brief Counters of the event executor.
+ */
+struct NimBLEEventExecutorStats {
+    uint32_t    depth;          // Events waiting for a worker.
+    uint32_t    highWater;      // Largest number of events waiting for one worker.
+    uint32_t    posted;         // Events received from the host task.
+    uint32_t    dispatched;     // Callbacks run by the workers.
+    uint32_t    dropped;        // Scan events discarded because the queue was full.
+    uint32_t    grown;          // Times a queue was enlarged to keep a connection event.
+    uint32_t    inlined;        // Connection events run in the host task because a queue could not grow.
+    uint32_t    stale;          // Events whose connection or device was gone when dispatched.
+    uint32_t    maxLatencyUs;   // Longest time from the host event to the callback.
+    uint32_t    latencyHist[NIMBLE_EXEC_HIST_BINS];  // Time from the host event to the callback.
+};
+
+
+/**
+ * @brief Runs the user callbacks of the clients and the scan in worker tasks instead of the host task.
+ *
+ * The host task only posts a small event record, the callback is invoked later by a worker so it
+ * may block or call the synchronous client APIs without stalling the host.  Each worker has its
+ * own bounded queue and the events of a connection always go to the same worker, so the callbacks
+ * of one connection run in the order the host produced them.  The scan events share one worker.
+ *
+ * When a queue is full new scan events are dropped, scan events may only use three quarters of
+ * a queue so a burst of advertising reports leaves room for connection events.  Connection
+ * events must not be lost, the queue grows for them up to NIMBLE_EXEC_MAX_GROWTH times its
+ * depth.  Past that the queued events of the connection and the new one are run in the host
+ * task, in order, as if there was no executor.
+ * A device evicted or erased from the scan results gets onDeparted() from its worker as well,
+ * its slot is not reused until the event is dispatched.  While a scan callback runs its device
+ * is held: the host task skips the reports of that device and does not evict it, so the
+ * callback never sees a torn payload.
+ */
+class NimBLEEventExecutor {
+public:
+    NimBLEEventExecutor(uint16_t depth);
+    ~NimBLEEventExecutor();
+
+    bool                    start(uint8_t numWorkers, uint32_t stackSize, UBaseType_t priority);
+    bool                    post(NimBLEExecEvent evt);
+    void                    purge(void* pObj);
+    NimBLEEventExecutorStats getStats();
+    void                    resetStats();
+
+private:
+    struct Worker {
+        NimBLEEventExecutor*        pExecutor;
+        TaskHandle_t                task;
+        SemaphoreHandle_t           itemsAvailable;
+        std::vector<NimBLEExecEvent> entries;       // Ring of pending events.
+        uint16_t                    head;           // Oldest entry.
+        uint16_t                    count;
+        void*                       pCurrent;       // Object of the event being dispatched.
+    };
+
+    static void             workerTask(void* pvParameters);
+    bool                    pop(Worker* pWorker, NimBLEExecEvent* evt);
+    bool                    grow(Worker* pWorker);
+    void                    runInline(Worker* pWorker, const NimBLEExecEvent &evt);
+    bool                    dispatch(const NimBLEExecEvent &evt);
+    void                    addLatency(uint32_t latencyUs);
+
+    uint16_t                m_depth;
+    std::vector<Worker*>    m_workers;
+    uint8_t                 m_running = 0;      // Worker tasks that have not exited yet.
+    bool                    m_stopping = false;
+    portMUX_TYPE            m_mux = portMUX_INITIALIZER_UNLOCKED;
+    NimBLEEventExecutorStats m_stats = {};
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // COMPONENTS_NIMBLEEVENTEXECUTOR_H_
@@ -0,0 +1,63 @@
+/*
+ * NimBLELinkProfile.cpp
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLELinkProfile.h"
+
+#include "host/ble_gap.h"
+#include "host/ble_att.h"
+
+
+/**
+ * @brief Get the parameters of a named link profile.
+ * @param [in] profile The profile.
+ * @return The profile parameters, all zero for LINK_PROFILE_DEFAULT.
+ */
+NimBLELinkProfile NimBLELinkProfile::preset(link_profile profile) {
+    NimBLELinkProfile p = {};
+
+    switch(profile) {
+        case LINK_PROFILE_BULK:
+            // Several full packets per event at 15 ms, the peer may not allow less.
+            p.phyMask = BLE_GAP_LE_PHY_2M_MASK;
+            p.dataLen = 251;
+            p.mtu = BLE_ATT_MTU_MAX;
+            p.itvlMin = 12;
+            p.itvlMax = 12;
+            p.latency = 0;
+            p.supervisionTimeout = 400;
+            break;
+
+        case LINK_PROFILE_LOW_LATENCY:
+            p.phyMask = BLE_GAP_LE_PHY_2M_MASK;
+            p.dataLen = 251;
+            p.mtu = 247;
+            p.itvlMin = 6;
+            p.itvlMax = 6;
+            p.latency = 0;
+            p.supervisionTimeout = 200;
+            break;
+
+        case LINK_PROFILE_LOW_POWER:
+            // The peripheral may skip 4 events of up to 250 ms when it has nothing to send.
+            p.phyMask = BLE_GAP_LE_PHY_1M_MASK;
+            p.itvlMin = 160;
+            p.itvlMax = 200;
+            p.latency = 4;
+            p.supervisionTimeout = 600;
+            break;
+
+        default:
+            break;
+    }
+
+    return p;
+} // preset
+
+#endif // CONFIG_BT_ENABLED
@@ -0,0 +1,59 @@
+/*
+ * NimBLELinkProfile.h
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef COMPONENTS_NIMBLELINKPROFILE_H_
+#define COMPONENTS_NIMBLELINKPROFILE_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include <stdint.h>
+
+
+/**
+ * @brief Named link profiles, see NimBLELinkProfile::preset().
+ */
+typedef enum {
+    LINK_PROFILE_DEFAULT,       // Leave the link as negotiated by the controllers.
+    LINK_PROFILE_BULK,          // 2M PHY, 251 byte packets, largest MTU and a short interval for throughput.
+    LINK_PROFILE_LOW_LATENCY,   // 2M PHY and a 7.5 ms interval without slave latency.
+    LINK_PROFILE_LOW_POWER,     // 1M PHY, long interval and slave latency for periodic telemetry.
+} link_profile;
+
+
+/**
+ * @brief The link parameters a client requests once connected, a zero field leaves that parameter unchanged.
+ */
+struct NimBLELinkProfile {
+    uint8_t     phyMask;            // Preferred PHYs for both directions, BLE_GAP_LE_PHY_*_MASK.
+    uint16_t    phyOpts;            // Coding of the coded PHY, BLE_GAP_LE_PHY_CODED_*.
+    uint16_t    dataLen;            // Link layer payload in octets, 27 to 251 (Data Length Extension).
+    uint16_t    mtu;                // ATT MTU to offer in the exchange, the preferred MTU of other links is unchanged.
+    uint16_t    itvlMin;            // Connection interval range in 1.25 ms units.
+    uint16_t    itvlMax;
+    uint16_t    latency;            // Slave latency in connection events.
+    uint16_t    supervisionTimeout; // In 10 ms units.
+
+    static NimBLELinkProfile preset(link_profile profile);
+};
+
+
+/**
+ * @brief The effective parameters of a connection.
+ */
+struct NimBLELinkInfo {
+    uint16_t    mtu;                // ATT MTU.
+    uint16_t    dataLen;            // Payload octets set with the Data Length Extension, 27 if not set.
+    uint8_t     txPhy;              // BLE_GAP_LE_PHY_1M, BLE_GAP_LE_PHY_2M or BLE_GAP_LE_PHY_CODED.
+    uint8_t     rxPhy;
+    uint16_t    itvl;               // Connection interval in 1.25 ms units.
+    uint16_t    latency;
+    uint16_t    supervisionTimeout; // In 10 ms units.
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // COMPONENTS_NIMBLELINKPROFILE_H_
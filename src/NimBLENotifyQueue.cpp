@@ -0,0 +1,306 @@
+/*
+ * NimBLENotifyQueue.cpp
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLENotifyQueue.h"
+#include "NimBLERemoteCharacteristic.h"
+#include "NimBLELog.h"
+
+#include <string>
+
+static const char* LOG_TAG = "NimBLENotifyQueue";
+
+
+/**
+ * @brief Constructor.
+ * @param [in] depth The maximum number of pending notifications.
+ * @param [in] policy What to do when a notification arrives and the queue is full.
+ */
+NimBLENotifyQueue::NimBLENotifyQueue(uint16_t depth, notify_overflow_policy policy) {
+    m_entries.resize(depth > 0 ? depth : 1);
+    m_policy = policy;
+    m_itemsAvailable = xSemaphoreCreateCounting(m_entries.size(), 0);
+} // NimBLENotifyQueue
+
+
+/**
+ * @brief Destructor, stops the workers and frees the pending notifications.
+ * Each worker finishes the callback it is running and frees its notification before it exits.
+ */
+NimBLENotifyQueue::~NimBLENotifyQueue() {
+    portENTER_CRITICAL(&m_mux);
+    m_stopping = true;
+    portEXIT_CRITICAL(&m_mux);
+
+    for(size_t i = 0; i < m_workers.size(); i++) {
+        xSemaphoreGive(m_itemsAvailable);
+    }
+
+    for(;;) {
+        portENTER_CRITICAL(&m_mux);
+        uint8_t running = m_running;
+        portEXIT_CRITICAL(&m_mux);
+        if(running == 0) {
+            break;
+        }
+        // The semaphore may have been full of pending items, wake the workers again.
+        xSemaphoreGive(m_itemsAvailable);
+        vTaskDelay(1);
+    }
+
+    for(auto &pWorker : m_workers) {
+        delete pWorker;
+    }
+
+    Entry entry;
+    while(pop(&entry)) {
+        os_mbuf_free_chain(entry.om);
+    }
+
+    vSemaphoreDelete(m_itemsAvailable);
+} // ~NimBLENotifyQueue
+
+
+/**
+ * @brief Start the worker tasks that invoke the notification callbacks.
+ * @param [in] numWorkers The number of worker tasks, callbacks are delivered in order with a single worker.
+ * @param [in] stackSize The stack size of each worker task.
+ * @param [in] priority The priority of the worker tasks.
+ * @return True if all the workers were started.
+ */
+bool NimBLENotifyQueue::start(uint8_t numWorkers, uint32_t stackSize, UBaseType_t priority) {
+    for(uint8_t i = 0; i < numWorkers; i++) {
+        Worker* pWorker = new Worker{this, nullptr, nullptr};
+
+        portENTER_CRITICAL(&m_mux);
+        m_running++;
+        portEXIT_CRITICAL(&m_mux);
+
+        if(xTaskCreate(NimBLENotifyQueue::workerTask, "nimble_notify", stackSize,
+                       pWorker, priority, &pWorker->task) != pdPASS)
+        {
+            NIMBLE_LOGE(LOG_TAG, "Failed to start notification worker %d", i);
+            portENTER_CRITICAL(&m_mux);
+            m_running--;
+            portEXIT_CRITICAL(&m_mux);
+            delete pWorker;
+            return false;
+        }
+        m_workers.push_back(pWorker);
+    }
+
+    return true;
+} // start
+
+
+/**
+ * @brief Queue a received notification, called from the host task.
+ * The queue takes ownership of the mbuf chain whether it is queued or dropped.
+ * @param [in] pChr The characteristic the notification is for.
+ * @param [in] om The received value.
+ * @param [in] isNotify True for a notification, false for an indication.
+ */
+void NimBLENotifyQueue::push(NimBLERemoteCharacteristic* pChr, struct os_mbuf* om, bool isNotify) {
+    struct os_mbuf* discard = nullptr;
+    bool replaced = false;
+    bool wake = false;
+    uint16_t size = m_entries.size();
+
+    portENTER_CRITICAL(&m_mux);
+
+    if(m_policy == NOTIFY_KEEP_LATEST) {
+        for(uint16_t i = 0; i < m_count; i++) {
+            Entry &entry = m_entries[(m_head + i) % size];
+            if(entry.pChr == pChr) {
+                discard = entry.om;
+                entry.om = om;
+                entry.isNotify = isNotify;
+                m_stats.replaced++;
+                replaced = true;
+                break;
+            }
+        }
+    }
+
+    if(!replaced) {
+        if(m_count < size) {
+            wake = true;
+        } else if(m_policy == NOTIFY_DROP_NEWEST) {
+            discard = om;
+            m_stats.dropped++;
+        } else {
+            // Make room by discarding the oldest entry, the number of items is unchanged.
+            discard = m_entries[m_head].om;
+            m_head = (m_head + 1) % size;
+            m_count--;
+            m_stats.dropped++;
+        }
+
+        if(discard != om) {
+            m_entries[(m_head + m_count) % size] = {pChr, om, isNotify};
+            m_count++;
+        }
+    }
+
+    if(m_count > m_stats.highWater) {
+        m_stats.highWater = m_count;
+    }
+
+    portEXIT_CRITICAL(&m_mux);
+
+    if(discard != nullptr) {
+        os_mbuf_free_chain(discard);
+    }
+
+    // Only wake a worker for a new item, a replaced or dropped one is already accounted for.
+    if(wake) {
+        xSemaphoreGive(m_itemsAvailable);
+    }
+} // push
+
+
+/**
+ * @brief Remove the oldest pending notification.
+ * @param [out] entry The notification removed.
+ * @param [in] pWorker The worker that will dispatch it, its client is marked as in use until the worker is done.
+ * @return True if there was a pending notification.
+ */
+bool NimBLENotifyQueue::pop(Entry* entry, Worker* pWorker) {
+    bool found = false;
+
+    portENTER_CRITICAL(&m_mux);
+    if(m_count > 0) {
+        *entry = m_entries[m_head];
+        m_head = (m_head + 1) % m_entries.size();
+        m_count--;
+        found = true;
+    }
+    if(pWorker != nullptr) {
+        pWorker->pCurrent = found ? entry->pChr->getRemoteService()->getClient() : nullptr;
+    }
+    portEXIT_CRITICAL(&m_mux);
+
+    return found;
+} // pop
+
+
+/**
+ * @brief Discard the pending notifications of a client before its characteristics are deleted
+ * and wait until no worker is running a callback of that client.
+ * From a notification callback of that client only its pending notifications are discarded.
+ * @param [in] pClient The client whose notifications are removed.
+ */
+void NimBLENotifyQueue::purge(NimBLEClient* pClient) {
+    std::vector<struct os_mbuf*> discard;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    uint16_t size = m_entries.size();
+    uint16_t kept = 0;
+    bool busy;
+
+    portENTER_CRITICAL(&m_mux);
+    for(uint16_t i = 0; i < m_count; i++) {
+        Entry entry = m_entries[(m_head + i) % size];
+        if(entry.pChr->getRemoteService()->getClient() == pClient) {
+            discard.push_back(entry.om);
+        } else {
+            m_entries[(m_head + kept++) % size] = entry;
+        }
+    }
+    m_count = kept;
+    portEXIT_CRITICAL(&m_mux);
+
+    for(auto &om : discard) {
+        os_mbuf_free_chain(om);
+    }
+
+    do {
+        busy = false;
+        portENTER_CRITICAL(&m_mux);
+        for(auto &pWorker : m_workers) {
+            if(pWorker->pCurrent == pClient && pWorker->task != self) {
+                busy = true;
+            }
+        }
+        portEXIT_CRITICAL(&m_mux);
+
+        if(busy) {
+            vTaskDelay(1);
+        }
+    } while(busy);
+} // purge
+
+
+/**
+ * @brief Get the queue counters.
+ * @return A copy of the counters.
+ */
+NimBLENotifyQueueStats NimBLENotifyQueue::getStats() {
+    portENTER_CRITICAL(&m_mux);
+    NimBLENotifyQueueStats stats = m_stats;
+    stats.depth = m_count;
+    portEXIT_CRITICAL(&m_mux);
+
+    return stats;
+} // getStats
+
+
+/**
+ * @brief Worker task, invokes the callbacks of the queued notifications and frees their mbufs.
+ */
+void NimBLENotifyQueue::workerTask(void* pvParameters) {
+    Worker* pWorker = (Worker*)pvParameters;
+    NimBLENotifyQueue* pQueue = pWorker->pQueue;
+    Entry entry;
+
+    for(;;) {
+        xSemaphoreTake(pQueue->m_itemsAvailable, portMAX_DELAY);
+
+        portENTER_CRITICAL(&pQueue->m_mux);
+        bool stopping = pQueue->m_stopping;
+        portEXIT_CRITICAL(&pQueue->m_mux);
+        if(stopping) {
+            break;
+        }
+
+        // The entry may have been purged since it was signaled.
+        if(!pQueue->pop(&entry, pWorker)) {
+            continue;
+        }
+
+        notify_callback notifyCallback = entry.pChr->m_notifyCallback;
+        if(notifyCallback != nullptr) {
+            if(SLIST_NEXT(entry.om, om_next) == nullptr) {
+                notifyCallback(entry.pChr, entry.om->om_data, entry.om->om_len, entry.isNotify);
+            } else {
+                // Chained value, the callback expects contiguous data.
+                std::string value(OS_MBUF_PKTLEN(entry.om), '\0');
+                os_mbuf_copydata(entry.om, 0, value.length(), &value[0]);
+                notifyCallback(entry.pChr, (uint8_t*)&value[0], value.length(), entry.isNotify);
+            }
+
+            portENTER_CRITICAL(&pQueue->m_mux);
+            pQueue->m_stats.delivered++;
+            portEXIT_CRITICAL(&pQueue->m_mux);
+        }
+
+        os_mbuf_free_chain(entry.om);
+
+        portENTER_CRITICAL(&pQueue->m_mux);
+        pWorker->pCurrent = nullptr;
+        portEXIT_CRITICAL(&pQueue->m_mux);
+    }
+
+    // The pending notifications are freed by the destructor.
+    portENTER_CRITICAL(&pQueue->m_mux);
+    pQueue->m_running--;
+    portEXIT_CRITICAL(&pQueue->m_mux);
+    vTaskDelete(nullptr);
+} // workerTask
+
+#endif // CONFIG_BT_ENABLED
@@ -0,0 +1,91 @@
+/*
+ * NimBLENotifyQueue.h
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef COMPONENTS_NIMBLENOTIFYQUEUE_H_
+#define COMPONENTS_NIMBLENOTIFYQUEUE_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "os/os_mbuf.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <vector>
+
+class NimBLEClient;
+class NimBLERemoteCharacteristic;
+
+/**
+ * @brief What to do with a notification that arrives when the queue is full.
+ */
+typedef enum {
+    NOTIFY_DROP_OLDEST,     // Discard the oldest pending notification.
+    NOTIFY_DROP_NEWEST,     // Discard the notification that just arrived.
+    NOTIFY_KEEP_LATEST,     // Replace the pending notification of the same characteristic, else drop the oldest.
+} notify_overflow_policy;
+
+
+/**
+ * @brief Counters of the notification queue.
+ */
+struct NimBLENotifyQueueStats {
+    uint32_t    depth;          // Notifications waiting for a worker.
+    uint32_t    highWater;      // Largest depth seen.
+    uint32_t    delivered;      // Callbacks invoked by the workers.
+    uint32_t    dropped;        // Notifications discarded because the queue was full.
+    uint32_t    replaced;       // Notifications superseded by a newer value (NOTIFY_KEEP_LATEST).
+};
+
+
+/**
+ * @brief A bounded queue that moves notification callbacks from the host task to worker tasks.
+ * The host task only queues the received mbuf chain, the workers call the characteristic
+ * callback and free the chain afterwards.
+ */
+class NimBLENotifyQueue {
+public:
+    NimBLENotifyQueue(uint16_t depth, notify_overflow_policy policy);
+    ~NimBLENotifyQueue();
+
+    bool                    start(uint8_t numWorkers, uint32_t stackSize, UBaseType_t priority);
+    void                    push(NimBLERemoteCharacteristic* pChr, struct os_mbuf* om, bool isNotify);
+    void                    purge(NimBLEClient* pClient);
+    NimBLENotifyQueueStats  getStats();
+
+private:
+    struct Entry {
+        NimBLERemoteCharacteristic* pChr;
+        struct os_mbuf*             om;
+        bool                        isNotify;
+    };
+
+    struct Worker {
+        NimBLENotifyQueue*          pQueue;
+        TaskHandle_t                task;
+        NimBLEClient*               pCurrent;   // Client of the notification being dispatched.
+    };
+
+    static void             workerTask(void* pvParameters);
+    bool                    pop(Entry* entry, Worker* pWorker = nullptr);
+
+    std::vector<Entry>      m_entries;          // Ring of pending notifications.
+    uint16_t                m_head = 0;         // Oldest entry.
+    uint16_t                m_count = 0;
+    notify_overflow_policy  m_policy;
+    portMUX_TYPE            m_mux = portMUX_INITIALIZER_UNLOCKED;
+    SemaphoreHandle_t       m_itemsAvailable = nullptr;
+    std::vector<Worker*>    m_workers;
+    uint8_t                 m_running = 0;      // Worker tasks that have not exited yet.
+    bool                    m_stopping = false;
+    NimBLENotifyQueueStats  m_stats = {};
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // COMPONENTS_NIMBLENOTIFYQUEUE_H_
@@ -58,7 +58,7 @@ static const char* LOG_TAG = "NimBLERemoteCharacteristic";
             m_uuid = NimBLEUUID(const_cast<ble_uuid128_t*>(&chr->uuid.u128));
             break;
         default:
-            m_uuid = nullptr;
+            m_uuid = NimBLEUUID();
             break;
     }
     m_handle         = chr->val_handle;
@@ -142,93 +142,10 @@ bool NimBLERemoteCharacteristic::canWriteNoResponse() {
 } // canWriteNoResponse
 
 
-/**
- * @brief Callback used by the API when a descriptor is discovered or search complete.
- */
-int NimBLERemoteCharacteristic::descriptorDiscCB(uint16_t conn_handle, 
-                                    const struct ble_gatt_error *error,
-                                    uint16_t chr_val_handle, 
-                                    const struct ble_gatt_dsc *dsc,
-                                    void *arg) 
-{
-    NIMBLE_LOGD(LOG_TAG,"Descriptor Discovered >> status: %d handle: %d", error->status, conn_handle);
-    
-    NimBLERemoteCharacteristic *characteristic = (NimBLERemoteCharacteristic*)arg;
-    int rc=0;
-
-    // Make sure the discovery is for this device
-    if(characteristic->getRemoteService()->getClient()->getConnId() != conn_handle){
-        return 0;
-    }
-    
-    switch (error->status) {
-        case 0: {
-            // Found a descriptor - add it to the map
-            NimBLERemoteDescriptor* pNewRemoteDescriptor = new NimBLERemoteDescriptor(characteristic, dsc);
-            characteristic->m_descriptorMap.insert(std::pair<std::string, NimBLERemoteDescriptor*>(pNewRemoteDescriptor->getUUID().toString(), pNewRemoteDescriptor));
-            
-            break;
-        }
-        case BLE_HS_EDONE:{
-            /* All descriptors in this characteristic discovered; */
-
-            NIMBLE_LOGD(LOG_TAG,"Giving search Descriptor semaphore - completed");
-            characteristic->m_semaphoreGetDescEvt.give(0);
-            rc = 0;
-            break;
-        }
-        default:
-            rc = error->status;
-            break;
-    }
-    if (rc != 0) {
-        /* Error; abort discovery. */
-        // pass non-zero to semaphore on error to indicate an error finding descriptors
-        NIMBLE_LOGD(LOG_TAG,"Giving search Descriptor semaphore - failed");
-        characteristic->m_semaphoreGetDescEvt.give(1);
-    }
-    NIMBLE_LOGD(LOG_TAG,"<< Descriptor Discovered. status: %d", rc);
-    return rc;
-}
-
-/**
- * @brief Populate the descriptors (if any) for this characteristic.
- * @param [in] the end handle of the characteristic, or the service, whichever comes first.
- */
-bool NimBLERemoteCharacteristic::retrieveDescriptors(uint16_t endHdl) {
-    NIMBLE_LOGD(LOG_TAG, ">> retrieveDescriptors() for characteristic: %s", getUUID().toString().c_str());
-
-    int rc = 0;
-    //removeDescriptors();   // Remove any existing descriptors.
-    
-    m_semaphoreGetDescEvt.take("retrieveDescriptors");
-    
-    rc = ble_gattc_disc_all_dscs(getRemoteService()->getClient()->getConnId(),
-                                 m_handle,
-                                 endHdl,
-                                 NimBLERemoteCharacteristic::descriptorDiscCB,
-                                 this);
-    if (rc != 0) {
-        NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_all_chrs: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
-        m_semaphoreGetDescEvt.give();
-        return false;
-    }
-    
-    if(m_semaphoreGetDescEvt.wait("retrieveCharacteristics") != 0) {
-        // if there was an error release the resources
-        //removeDescriptors();
-        return false;
-    }
-    
-    return true;
-    NIMBLE_LOGD(LOG_TAG, "<< retrieveDescriptors(): Found %d descriptors.", m_descriptorMap.size());
-} // getDescriptors
-
-
 /**
  * @brief Retrieve the map of descriptors keyed by UUID.
  */ 
-std::map<std::string, NimBLERemoteDescriptor*>* NimBLERemoteCharacteristic::getDescriptors() {
+NimBLEUUIDMap<NimBLERemoteDescriptor*>* NimBLERemoteCharacteristic::getDescriptors() {
     return &m_descriptorMap;
 } // getDescriptors
 
@@ -256,19 +173,115 @@ uint16_t NimBLERemoteCharacteristic::getDefHandle() {
  * @return The Remote descriptor (if present) or null if not present.
  */
 NimBLERemoteDescriptor* NimBLERemoteCharacteristic::getDescriptor(NimBLEUUID uuid) {
-    NIMBLE_LOGD(LOG_TAG, ">> getDescriptor: uuid: %s", uuid.toString().c_str());
-    std::string v = uuid.toString();
-    for (auto &myPair : m_descriptorMap) {
-        if (myPair.first == v) {
-            NIMBLE_LOGD(LOG_TAG, "<< getDescriptor: found");
-            return myPair.second;
-        }
+    NIMBLE_LOGD(LOG_TAG, ">> getDescriptor");
+    
+    if(!m_haveDescriptors && m_pRemoteService->getClient()->m_lazyDiscovery) {
+        retrieveDescriptors();
+    }
+    
+    auto it = m_descriptorMap.find(uuid);
+    if (it != m_descriptorMap.end()) {
+        NIMBLE_LOGD(LOG_TAG, "<< getDescriptor: found");
+        return it->second;
     }
     NIMBLE_LOGD(LOG_TAG, "<< getDescriptor: Not found");
     return nullptr;
 } // getDescriptor
 
 
+/**
+ * @brief Discover the descriptors of this characteristic.
+ * Used in lazy discovery mode where the next characteristic is not known, the procedure runs
+ * to the end of the service and is stopped at the next characteristic declaration.
+ * @return True on success.
+ */
+bool NimBLERemoteCharacteristic::retrieveDescriptors() {
+    NIMBLE_LOGD(LOG_TAG, ">> retrieveDescriptors() for characteristic: %s", getUUID().toString().c_str());
+    
+    NimBLEClient* pClient = m_pRemoteService->getClient();
+    uint16_t endHandle = m_pRemoteService->getEndHandle();
+    
+    // No room for descriptors after the value.
+    if(m_handle >= endHandle) {
+        m_haveDescriptors = true;
+        return true;
+    }
+    
+    pClient->m_semaphoreSearchCmplEvt.take("retrieveDescriptors");
+    
+    int rc = ble_gattc_disc_all_dscs(pClient->getConnId(),
+                                     m_handle,
+                                     endHandle,
+                                     NimBLERemoteCharacteristic::descriptorDiscCB,
+                                     this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_all_dscs: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        pClient->m_semaphoreSearchCmplEvt.give();
+        return false;
+    }
+    
+    m_haveDescriptors = (pClient->m_semaphoreSearchCmplEvt.wait("retrieveDescriptors") == 0);
+    
+    NIMBLE_LOGD(LOG_TAG, "<< retrieveDescriptors(): Found %d descriptors.", m_descriptorMap.size());
+    return m_haveDescriptors;
+} // retrieveDescriptors
+
+
+/**
+ * @brief Callback for the on demand descriptor discovery.
+ * The value handle is reported first and skipped, the next characteristic declaration ends the procedure.
+ */
+int NimBLERemoteCharacteristic::descriptorDiscCB(uint16_t conn_handle, 
+                                const struct ble_gatt_error *error,
+                                uint16_t chr_val_handle, 
+                                const struct ble_gatt_dsc *dsc,
+                                void *arg) 
+{
+    NIMBLE_LOGD(LOG_TAG,"Descriptor Discovered >> status: %d handle: %d", error->status, conn_handle);
+    
+    NimBLERemoteCharacteristic *characteristic = (NimBLERemoteCharacteristic*)arg;
+    NimBLEClient* pClient = characteristic->getRemoteService()->getClient();
+    int rc=0;
+
+    // Make sure the discovery is for this device
+    if(pClient->getConnId() != conn_handle){
+        return 0;
+    }
+    
+    switch (error->status) {
+        case 0: {
+            if(dsc->handle == characteristic->m_handle) {
+                break;
+            }
+            // 0x2803 is a characteristic declaration, we are past our descriptors.
+            if(dsc->uuid.u.type == BLE_UUID_TYPE_16 && dsc->uuid.u16.value == 0x2803) {
+                pClient->m_semaphoreSearchCmplEvt.give(0);
+                // Returning non-zero stops the procedure without another callback.
+                return BLE_HS_EDONE;
+            }
+            NimBLERemoteDescriptor* pNewRemoteDescriptor = new NimBLERemoteDescriptor(characteristic, dsc);
+            if(!characteristic->m_descriptorMap.insert(std::make_pair(pNewRemoteDescriptor->getUUID(), pNewRemoteDescriptor)).second) {
+                delete pNewRemoteDescriptor;
+            }
+            break;
+        }
+        case BLE_HS_EDONE:{
+            pClient->m_semaphoreSearchCmplEvt.give(0);
+            break;
+        }
+        default:
+            rc = error->status;
+            break;
+    }
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "descriptorDiscCB() rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        pClient->m_semaphoreSearchCmplEvt.give(rc);
+    }
+    NIMBLE_LOGD(LOG_TAG,"<< Descriptor Discovered. status: %d", rc);
+    return rc;
+} // descriptorDiscCB
+
+
 /**
  * @brief Get the remote service associated with this characteristic.
  * @return The remote service associated with this characteristic.
@@ -292,11 +305,7 @@ NimBLEUUID NimBLERemoteCharacteristic::getUUID() {
  * @return The unsigned 16 bit value.
  */
 uint16_t NimBLERemoteCharacteristic::readUInt16() {
-    std::string value = readValue();
-    if (value.length() >= 2) {
-        return *(uint16_t*)(value.data());
-    }
-    return 0;
+    return readValue<uint16_t>();
 } // readUInt16
 
 
@@ -305,11 +314,7 @@ uint16_t NimBLERemoteCharacteristic::readUInt16() {
  * @return the unsigned 32 bit value.
  */
 uint32_t NimBLERemoteCharacteristic::readUInt32() {
-    std::string value = readValue();
-    if (value.length() >= 4) {
-        return *(uint32_t*)(value.data());
-    }
-    return 0;
+    return readValue<uint32_t>();
 } // readUInt32
 
 
@@ -318,11 +323,7 @@ uint32_t NimBLERemoteCharacteristic::readUInt32() {
  * @return The value as a byte
  */
 uint8_t NimBLERemoteCharacteristic::readUInt8() {
-    std::string value = readValue();
-    if (value.length() >= 1) {
-        return (uint8_t)value[0];
-    }
-    return 0;
+    return readValue<uint8_t>();
 } // readUInt8
 
     
@@ -333,6 +334,38 @@ uint8_t NimBLERemoteCharacteristic::readUInt8() {
 std::string NimBLERemoteCharacteristic::readValue() {
     NIMBLE_LOGD(LOG_TAG, ">> readValue(): uuid: %s, handle: %d 0x%.2x", getUUID().toString().c_str(), getHandle(), getHandle());
 
+    int rc = performRead(nullptr, 0);
+    
+    NIMBLE_LOGD(LOG_TAG, "<< readValue(): length: %d", m_value.length());
+    return (rc == 0) ? m_value : "";
+} // readValue
+
+
+/**
+ * @brief Read the value of the remote characteristic into a caller provided buffer.
+ * The value is copied straight from the host buffers, nothing is allocated and the value
+ * returned by readValue() is not updated.
+ * @param [in] buf The buffer that receives the value.
+ * @param [in] bufLen The size of the buffer, a longer value is truncated.
+ * @return The number of bytes copied, 0 if the read failed.
+ */
+size_t NimBLERemoteCharacteristic::readValue(uint8_t* buf, size_t bufLen) {
+    NIMBLE_LOGD(LOG_TAG, ">> readValue(): handle: %d, buffer: %d bytes", getHandle(), bufLen);
+
+    int rc = performRead(buf, bufLen);
+    
+    NIMBLE_LOGD(LOG_TAG, "<< readValue(): rc: %d, length: %d", rc, m_readLen);
+    return (rc == 0) ? m_readLen : 0;
+} // readValue
+
+
+/**
+ * @brief Read the value of the remote characteristic, securing the connection if the peer requires it.
+ * @param [in] buf The buffer that receives the value, nullptr to store it in m_value.
+ * @param [in] bufLen The size of the buffer.
+ * @return 0 on success, otherwise the host error code.
+ */
+int NimBLERemoteCharacteristic::performRead(uint8_t* buf, size_t bufLen) {
     int rc = 0;
     int retryCount = 1;
     NimBLEClient* pClient = getRemoteService()->getClient();
@@ -340,19 +373,21 @@ std::string NimBLERemoteCharacteristic::readValue() {
     // Check to see that we are connected.
     if (!pClient->isConnected()) {
         NIMBLE_LOGE(LOG_TAG, "Disconnected");
-        return "";
+        return BLE_HS_ENOTCONN;
     }
 
     do {
         m_semaphoreReadCharEvt.take("readValue");
+        m_readBuf = buf;
+        m_readBufLen = bufLen;
+        m_readLen = 0;
         
         rc = ble_gattc_read(pClient->getConnId(), m_handle,
                             NimBLERemoteCharacteristic::onReadCB, this);
         if (rc != 0) {
             NIMBLE_LOGE(LOG_TAG, "Error: Failed to read characteristic; rc=%d", rc);
-            //goto err;
             m_semaphoreReadCharEvt.give();
-            return "";
+            return rc;
         }
         
         rc = m_semaphoreReadCharEvt.wait("readValue");
@@ -368,13 +403,12 @@ std::string NimBLERemoteCharacteristic::readValue() {
                     break;
                 
             default:
-                return "";
+                return rc;
         }
     } while(rc != 0 && retryCount--);
     
-    NIMBLE_LOGD(LOG_TAG, "<< readValue(): length: %d", m_value.length());
-    return (rc == 0) ? m_value : "";
-} // readValue
+    return rc;
+} // performRead
 
 
 /**
@@ -394,14 +428,20 @@ int NimBLERemoteCharacteristic::onReadCB(uint16_t conn_handle,
     
     NIMBLE_LOGI(LOG_TAG, "Read complete; status=%d conn_handle=%d", error->status, conn_handle);
     
-    if (error->status == 0) {       
-        characteristic->m_value = std::string((char*) attr->om->om_data, attr->om->om_len);
+    if (error->status == 0) {
+        uint16_t len = OS_MBUF_PKTLEN(attr->om);
+        if (characteristic->m_readBuf != nullptr) {
+            characteristic->m_readLen = len < characteristic->m_readBufLen ? len : characteristic->m_readBufLen;
+            os_mbuf_copydata(attr->om, 0, characteristic->m_readLen, characteristic->m_readBuf);
+        } else {
+            characteristic->m_value.resize(len);
+            os_mbuf_copydata(attr->om, 0, len, &characteristic->m_value[0]);
+        }
         characteristic->m_semaphoreReadCharEvt.give(0);
-        //if(m_rawData != nullptr) free(m_rawData);
-        //m_rawData = (uint8_t*) calloc(evtParam->read.value_len, sizeof(uint8_t));
-        //memcpy(m_rawData, evtParam->read.value, evtParam->read.value_len);
     } else {
-        characteristic->m_value = "";
+        if (characteristic->m_readBuf == nullptr) {
+            characteristic->m_value = "";
+        }
         characteristic->m_semaphoreReadCharEvt.give(error->status);
     }
     
@@ -409,6 +449,279 @@ int NimBLERemoteCharacteristic::onReadCB(uint16_t conn_handle,
 }
 
 
+/**
+ * @brief Read the value of the remote characteristic without blocking.
+ * The callback is invoked from the host task with the result, the data pointer is only valid
+ * for the duration of the callback and the value is not stored in the characteristic.
+ * Only one asynchronous read can be pending per characteristic.
+ * Unlike readValue() the connection is not secured automatically on an authentication error.
+ * @param [in] completeCb The function called when the read completes.
+ * @param [in] arg Value passed to the callback.
+ * @return 0 if the read was started, otherwise the host error code.
+ */
+int NimBLERemoteCharacteristic::readValueAsync(read_complete_cb completeCb, void* arg) {
+    NIMBLE_LOGD(LOG_TAG, ">> readValueAsync(): uuid: %s, handle: %d 0x%.2x", getUUID().toString().c_str(), getHandle(), getHandle());
+    
+    NimBLEClient* pClient = getRemoteService()->getClient();
+    
+    if (!pClient->isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected");
+        return BLE_HS_ENOTCONN;
+    }
+    
+    if (m_readCb != nullptr) {
+        return BLE_HS_EBUSY;
+    }
+    
+    m_readCb = completeCb;
+    m_readCbArg = arg;
+    
+    int rc = ble_gattc_read(pClient->getConnId(), m_handle,
+                            NimBLERemoteCharacteristic::onReadAsyncCB, this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Error: Failed to read characteristic; rc=%d", rc);
+        m_readCb = nullptr;
+    }
+    
+    NIMBLE_LOGD(LOG_TAG, "<< readValueAsync()");
+    return rc;
+} // readValueAsync
+
+
+/**
+ * @brief Callback for the asynchronous characteristic read operation.
+ * @return 0.
+ */
+int NimBLERemoteCharacteristic::onReadAsyncCB(uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                struct ble_gatt_attr *attr, void *arg) 
+{
+    NimBLERemoteCharacteristic* characteristic = (NimBLERemoteCharacteristic*)arg;
+    read_complete_cb completeCb = characteristic->m_readCb;
+    characteristic->m_readCb = nullptr;
+    
+    // The read was started on a previous connection, it is lost with that link.
+    if(characteristic->getRemoteService()->getClient()->getConnId() != conn_handle){
+        if (completeCb != nullptr) {
+            completeCb(characteristic, BLE_HS_ENOTCONN, nullptr, 0, characteristic->m_readCbArg);
+        }
+        return 0;
+    }
+    
+    NIMBLE_LOGI(LOG_TAG, "Async read complete; status=%d conn_handle=%d", error->status, conn_handle);
+    
+    if (completeCb == nullptr) {
+        return 0;
+    }
+    
+    if (error->status != 0) {
+        completeCb(characteristic, error->status, nullptr, 0, characteristic->m_readCbArg);
+        return 0;
+    }
+    
+    // The value is passed from the host buffers, m_value belongs to the blocking reads.
+    if (SLIST_NEXT(attr->om, om_next) == nullptr) {
+        completeCb(characteristic, 0, attr->om->om_data, attr->om->om_len, characteristic->m_readCbArg);
+        return 0;
+    }
+    
+    uint8_t buf[BLE_ATT_ATTR_MAX_LEN];
+    uint16_t len = OS_MBUF_PKTLEN(attr->om);
+    if (len > sizeof(buf)) {
+        len = sizeof(buf);
+    }
+    os_mbuf_copydata(attr->om, 0, len, buf);
+    completeCb(characteristic, 0, buf, len, characteristic->m_readCbArg);
+    return 0;
+} // onReadAsyncCB
+
+
+/**
+ * @brief Read a long value of the remote characteristic, streaming each fragment to a callback.
+ * Uses the Read Long procedure so the value is not limited to MTU-1 bytes. The fragments are passed
+ * straight from the host buffers and are only valid during the callback, which runs in the host task.
+ * Blocks until the whole value has been received.
+ * @param [in] chunkCb Called for each fragment with its offset in the value, return false to stop the read.
+ * @param [in] arg Value passed to the callback.
+ * @return 0 on success, BLE_HS_EAPP if stopped by the callback, otherwise the host error code.
+ */
+int NimBLERemoteCharacteristic::readValueLong(read_chunk_cb chunkCb, void* arg) {
+    NIMBLE_LOGD(LOG_TAG, ">> readValueLong(): uuid: %s, handle: %d 0x%.2x", getUUID().toString().c_str(), getHandle(), getHandle());
+    
+    NimBLEClient* pClient = getRemoteService()->getClient();
+    
+    if (!pClient->isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected");
+        return BLE_HS_ENOTCONN;
+    }
+    
+    m_chunkCb = chunkCb;
+    m_chunkCbArg = arg;
+    m_longReadStats = {};
+    m_longReadStats.startTime = FreeRTOS::getTimeSinceStart();
+    
+    m_semaphoreReadCharEvt.take("readValueLong");
+    
+    int rc = ble_gattc_read_long(pClient->getConnId(), m_handle, 0,
+                                 NimBLERemoteCharacteristic::onReadLongCB, this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Error: Failed to read characteristic; rc=%d", rc);
+        m_semaphoreReadCharEvt.give();
+        return rc;
+    }
+    
+    rc = m_semaphoreReadCharEvt.wait("readValueLong");
+    
+    NIMBLE_LOGD(LOG_TAG, "<< readValueLong(): rc=%d, %d bytes in %d chunks, %d ms", rc, 
+                m_longReadStats.bytes, m_longReadStats.chunks, m_longReadStats.elapsedMs);
+    return rc;
+} // readValueLong
+
+
+/**
+ * @brief Read a long value of the remote characteristic into a caller provided buffer.
+ * @param [in] buf The buffer that receives the value.
+ * @param [in] bufLen The size of the buffer.
+ * @param [out] readLen The length of the value read.
+ * @return 0 on success, BLE_HS_EAPP if the value does not fit in the buffer, otherwise the host error code.
+ */
+int NimBLERemoteCharacteristic::readValueLong(uint8_t* buf, size_t bufLen, size_t* readLen) {
+    uint8_t* ctx[2] = {buf, buf + bufLen};
+    
+    int rc = readValueLong(NimBLERemoteCharacteristic::copyChunkCB, ctx);
+    *readLen = m_longReadStats.bytes;
+    return rc;
+} // readValueLong
+
+
+/**
+ * @brief Chunk callback used to copy a long read into a buffer, arg holds the buffer start and end.
+ */
+bool NimBLERemoteCharacteristic::copyChunkCB(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, 
+                                             const uint8_t* pData, size_t length, size_t offset, void* arg) 
+{
+    uint8_t** ctx = (uint8_t**)arg;
+    
+    if(ctx[0] + offset + length > ctx[1]) {
+        NIMBLE_LOGE(LOG_TAG, "Long read does not fit in the buffer");
+        return false;
+    }
+    
+    memcpy(ctx[0] + offset, pData, length);
+    return true;
+} // copyChunkCB
+
+
+/**
+ * @brief Callback for the Read Long procedure.
+ * Each response is handed to the chunk callback one mbuf at a time without copying.
+ * @return 0 to continue, non-zero to stop the procedure.
+ */
+int NimBLERemoteCharacteristic::onReadLongCB(uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                struct ble_gatt_attr *attr, void *arg) 
+{
+    NimBLERemoteCharacteristic* characteristic = (NimBLERemoteCharacteristic*)arg;
+    NimBLELongReadStats* stats = &characteristic->m_longReadStats;
+    
+    if(characteristic->getRemoteService()->getClient()->getConnId() != conn_handle){
+        return 0;
+    }
+    
+    stats->elapsedMs = FreeRTOS::getTimeSinceStart() - stats->startTime;
+    
+    switch(error->status) {
+        case 0: {
+            size_t offset = attr->offset;
+            stats->chunks++;
+            
+            for(struct os_mbuf* om = attr->om; om != nullptr; om = SLIST_NEXT(om, om_next)) {
+                if(om->om_len == 0) {
+                    continue;
+                }
+                if(characteristic->m_chunkCb != nullptr &&
+                  !characteristic->m_chunkCb(characteristic, om->om_data, om->om_len, offset, characteristic->m_chunkCbArg)) 
+                {
+                    // The procedure ends without another callback.
+                    characteristic->m_semaphoreReadCharEvt.give(BLE_HS_EAPP);
+                    return BLE_HS_EAPP;
+                }
+                offset += om->om_len;
+                stats->bytes += om->om_len;
+            }
+            return 0;
+        }
+        
+        // A value that is a multiple of MTU-1 long ends with an offset error from some peers.
+        case BLE_HS_ATT_ERR(BLE_ATT_ERR_INVALID_OFFSET):
+        case BLE_HS_ATT_ERR(BLE_ATT_ERR_ATTR_NOT_LONG):
+            if(stats->bytes > 0) {
+                characteristic->m_semaphoreReadCharEvt.give(0);
+                return 0;
+            }
+            characteristic->m_semaphoreReadCharEvt.give(error->status);
+            return 0;
+        
+        case BLE_HS_EDONE:
+            NIMBLE_LOGI(LOG_TAG, "Long read complete; %d bytes", stats->bytes);
+            characteristic->m_semaphoreReadCharEvt.give(0);
+            return 0;
+            
+        default:
+            NIMBLE_LOGE(LOG_TAG, "Long read failed; status=%d", error->status);
+            characteristic->m_semaphoreReadCharEvt.give(error->status);
+            return 0;
+    }
+} // onReadLongCB
+
+
+/**
+ * @brief Get the progress and throughput counters of the current or last long read.
+ * Can be polled from another task while readValueLong() is in progress.
+ * @return The long read counters.
+ */
+const NimBLELongReadStats& NimBLERemoteCharacteristic::getLongReadStats() {
+    return m_longReadStats;
+} // getLongReadStats
+
+
+/**
+ * @brief Get the length of the value if it cannot vary.
+ * The length is taken from the format of the Characteristic Presentation Format descriptor, the
+ * descriptor is read once and the result kept.  Strings, structures and characteristics without
+ * the descriptor have no fixed length.
+ * @return The length of the value, 0 if it is not known to be fixed.
+ */
+uint16_t NimBLERemoteCharacteristic::getFixedLength() {
+    if(m_haveFixedLength) {
+        return m_fixedLength;
+    }
+    
+    NimBLERemoteDescriptor* pDsc = getDescriptor(NimBLEUUID((uint16_t)0x2904));
+    if(pDsc == nullptr) {
+        m_haveFixedLength = true;
+        return 0;
+    }
+    
+    // Indexed by the format, from boolean (0x01) to duint16 (0x18).
+    static const uint8_t formatLength[] = {
+        0, 1, 1, 1, 1, 2, 2, 3, 4, 6, 8, 16, 1, 2, 2, 3,
+        4, 6, 8, 16, 4, 8, 2, 4, 4,
+    };
+    
+    std::string format = pDsc->readValue();
+    if(format.length() != 7) {
+        // Not cached, the read may have failed.
+        return 0;
+    }
+    
+    uint8_t type = format[0];
+    m_fixedLength = type < sizeof(formatLength) ? formatLength[type] : 0;
+    m_haveFixedLength = true;
+    return m_fixedLength;
+} // getFixedLength
+
+
 /**
  * @brief Register for notifications.
  * @param [in] notifyCallback A callback to be invoked for a notification.  If NULL is provided then we are
@@ -474,11 +787,25 @@ bool NimBLERemoteCharacteristic::registerForNotify(notify_callback notifyCallbac
         return false;
     }
 */
+    // Keep the client dispatch table in sync with the callback, before the write as a
+    // notification can arrive as soon as the descriptor is written.
+    NimBLEClient* pClient = getRemoteService()->getClient();
+    if(notifyCallback != nullptr) {
+        pClient->m_notifyMap[m_handle] = this;
+    } else {
+        pClient->m_notifyMap.erase(m_handle);
+    }
+    
+    bool ok = desc->writeValue(val, 2, response);
+    if(!ok && notifyCallback != nullptr) {
+        pClient->m_notifyMap.erase(m_handle);
+    }
+    
     NIMBLE_LOGD(LOG_TAG, "<< registerForNotify()");
 
     //m_registeredForNotify = true;
     
-    return desc->writeValue(val, 2, response);  //true;
+    return ok;
 } // registerForNotify
 //END_H2ZERO_MOD
 
@@ -492,12 +819,11 @@ bool NimBLERemoteCharacteristic::registerForNotify(notify_callback notifyCallbac
  * @return N/A.
  */
 void NimBLERemoteCharacteristic::removeDescriptors() {
-    // Iterate through all the descriptors releasing their storage and erasing them from the map.
+    // Iterate through all the descriptors releasing their storage, then empty the map.
     for (auto &myPair : m_descriptorMap) {
-       m_descriptorMap.erase(myPair.first);
        delete myPair.second;
     }
-    m_descriptorMap.clear();   // Technically not neeeded, but just to be sure.
+    m_descriptorMap.clear();
 } // removeCharacteristics
 
 
@@ -641,6 +967,189 @@ int NimBLERemoteCharacteristic::onWriteCB(uint16_t conn_handle,
 }
 
 
+/**
+ * @brief Write the value of the remote characteristic with response without blocking.
+ * The data is copied into the host buffers before returning. The callback is invoked from the
+ * host task once the peer has acknowledged the write. Only one asynchronous write can be
+ * pending per characteristic.
+ * @param [in] data The data to write.
+ * @param [in] length The length of the data.
+ * @param [in] completeCb The function called when the write completes.
+ * @param [in] arg Value passed to the callback.
+ * @return 0 if the write was started, otherwise the host error code.
+ */
+int NimBLERemoteCharacteristic::writeValueAsync(const uint8_t* data, size_t length, write_complete_cb completeCb, void* arg) {
+    NIMBLE_LOGD(LOG_TAG, ">> writeValueAsync(), length: %d", length);
+    
+    NimBLEClient* pClient = getRemoteService()->getClient();
+    
+    if (!pClient->isConnected()) {
+        NIMBLE_LOGE(LOG_TAG, "Disconnected");
+        return BLE_HS_ENOTCONN;
+    }
+    
+    if (m_writeCb != nullptr) {
+        return BLE_HS_EBUSY;
+    }
+    
+    m_writeCb = completeCb;
+    m_writeCbArg = arg;
+    
+    int rc = ble_gattc_write_flat(pClient->getConnId(), m_handle,
+                                  data, length, 
+                                  NimBLERemoteCharacteristic::onWriteAsyncCB, 
+                                  this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "Error: Failed to write characteristic; rc=%d", rc);
+        m_writeCb = nullptr;
+    }
+    
+    NIMBLE_LOGD(LOG_TAG, "<< writeValueAsync, rc: %d", rc);
+    return rc;
+} // writeValueAsync
+
+
+/**
+ * @brief Write a large payload with write commands as fast as the link allows.
+ * The payload is split at the negotiated MTU and up to window HCI ACL packets are kept queued
+ * in the host and controller, a write longer than the ACL buffers of the controller counts as
+ * several packets. When the window is full, or the host runs out of buffers, the writer sleeps
+ * until the controller reports completed packets for this connection and then refills the pipe.
+ * Blocks until the whole payload has been queued.
+ * @param [in] data The data to write.
+ * @param [in] length The length of the data.
+ * @param [in] window The maximum number of ACL packets in flight, 0 for the number of ACL buffers.
+ * @return 0 on success, BLE_HS_EBUSY if a stream is already running on this client, otherwise the host error code.
+ */
+int NimBLERemoteCharacteristic::writeValueStream(const uint8_t* data, size_t length, uint16_t window) {
+    NIMBLE_LOGD(LOG_TAG, ">> writeValueStream(), length: %d", length);
+    
+    NimBLEClient* pClient = getRemoteService()->getClient();
+    size_t chunkLen = pClient->getMTU() - 3;
+    size_t offset = 0;
+    int rc = 0;
+    
+    if(window == 0) {
+        window = MYNEWT_VAL(BLE_ACL_BUF_COUNT);
+    }
+    
+    // The credit counters belong to the client, only one stream can use them at a time.
+    portENTER_CRITICAL(&pClient->m_txMux);
+    if(pClient->m_txWaiting) {
+        portEXIT_CRITICAL(&pClient->m_txMux);
+        NIMBLE_LOGE(LOG_TAG, "A stream is already in progress on this client");
+        return BLE_HS_EBUSY;
+    }
+    pClient->m_txSent = 0;
+    pClient->m_txCompleted = 0;
+    pClient->m_txWaiting = true;
+    portEXIT_CRITICAL(&pClient->m_txMux);
+    
+    // Completions are counted and signaled from now on, a signal left from an earlier stream is cleared.
+    xSemaphoreTake(pClient->m_txCmplSem, 0);
+    
+    m_streamStats = {};
+    uint32_t startTime = FreeRTOS::getTimeSinceStart();
+    
+    while(offset < length) {
+        if (!pClient->isConnected()) {
+            NIMBLE_LOGE(LOG_TAG, "Disconnected");
+            rc = BLE_HS_ENOTCONN;
+            break;
+        }
+        
+        while(offset < length) {
+            size_t len = (length - offset < chunkLen) ? length - offset : chunkLen;
+            uint16_t frags = pClient->txFragments(len);
+            uint32_t inFlight = pClient->m_txSent - pClient->m_txCompleted;
+            // A write larger than the window is still sent once the pipe is empty.
+            if(inFlight > 0 && inFlight + frags > window) {
+                break;
+            }
+            
+            rc = ble_gattc_write_no_rsp_flat(pClient->getConnId(), m_handle, data + offset, len);
+            if(rc != 0) {
+                break;
+            }
+            offset += len;
+            pClient->m_txSent += frags;
+            m_streamStats.packets++;
+            m_streamStats.bytes += len;
+        }
+        
+        if(rc == BLE_HS_ENOMEM) {
+            m_streamStats.stalls++;
+            rc = 0;
+        } else if(rc != 0) {
+            NIMBLE_LOGE(LOG_TAG, "Error: Failed to write characteristic; rc=%d", rc);
+            break;
+        }
+        
+        if(offset >= length) {
+            break;
+        }
+        
+        if(pClient->m_txSent == pClient->m_txCompleted) {
+            // Out of buffers with nothing of ours in flight, no completion will wake us.
+            FreeRTOS::sleep(1);
+            continue;
+        }
+        
+        // A completion that arrived during the burst has already given the semaphore.
+        m_streamStats.creditWaits++;
+        xSemaphoreTake(pClient->m_txCmplSem, portMAX_DELAY);
+    }
+    
+    pClient->m_txWaiting = false;
+    
+    m_streamStats.elapsedMs = FreeRTOS::getTimeSinceStart() - startTime;
+    if(m_streamStats.elapsedMs > 0) {
+        m_streamStats.bytesPerSec = (uint64_t)m_streamStats.bytes * 1000 / m_streamStats.elapsedMs;
+    }
+    
+    NIMBLE_LOGD(LOG_TAG, "<< writeValueStream, rc: %d, %d bytes/s, %d stalls", rc, 
+                m_streamStats.bytesPerSec, m_streamStats.stalls);
+    return rc;
+} // writeValueStream
+
+
+/**
+ * @brief Get the counters of the current or last streaming write.
+ * @return The streaming write counters.
+ */
+const NimBLEStreamStats& NimBLERemoteCharacteristic::getStreamStats() {
+    return m_streamStats;
+} // getStreamStats
+
+
+/**
+ * @brief Callback for the asynchronous characteristic write operation.
+ * @return 0.
+ */
+int NimBLERemoteCharacteristic::onWriteAsyncCB(uint16_t conn_handle,
+                const struct ble_gatt_error *error,
+                struct ble_gatt_attr *attr, void *arg) 
+{
+    NimBLERemoteCharacteristic* characteristic = (NimBLERemoteCharacteristic*)arg;
+    write_complete_cb completeCb = characteristic->m_writeCb;
+    characteristic->m_writeCb = nullptr;
+    int status = error->status;
+    
+    // The write was started on a previous connection, it is lost with that link.
+    if(characteristic->getRemoteService()->getClient()->getConnId() != conn_handle){
+        status = BLE_HS_ENOTCONN;
+    }
+    
+    NIMBLE_LOGI(LOG_TAG, "Async write complete; status=%d conn_handle=%d", status, conn_handle);
+    
+    if (completeCb != nullptr) {
+        completeCb(characteristic, status, characteristic->m_writeCbArg);
+    }
+    
+    return 0;
+} // onWriteAsyncCB
+
+
 /**
  * @brief Read raw data from remote characteristic as hex bytes
  * @return return pointer data read
@@ -657,7 +1166,6 @@ void NimBLERemoteCharacteristic::releaseSemaphores() {
         dPair.second->releaseSemaphores();
     }
     m_semaphoreWriteCharEvt.give(1);
-    m_semaphoreGetDescEvt.give(1);
     m_semaphoreReadCharEvt.give(1);
 }
 #endif /* CONFIG_BT_ENABLED */
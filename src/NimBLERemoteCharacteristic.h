@@ -23,13 +23,41 @@
 #include "NimBLERemoteDescriptor.h"
 
 //#include <string>
+#include "NimBLEUUIDMap.h"
+
 #include <map>
+#include <type_traits>
 
 class NimBLERemoteService;
 class NimBLERemoteDescriptor;
 
 
 typedef void (*notify_callback)(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, uint8_t* pData, size_t length, bool isNotify);
+typedef void (*read_complete_cb)(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, int rc, const uint8_t* pData, size_t length, void* arg);
+typedef void (*write_complete_cb)(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, int rc, void* arg);
+typedef bool (*read_chunk_cb)(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, const uint8_t* pData, size_t length, size_t offset, void* arg);
+
+/**
+ * @brief Progress and throughput counters of a long read.
+ */
+struct NimBLELongReadStats {
+    uint32_t    bytes;          // Bytes received so far.
+    uint32_t    chunks;         // Read responses received so far.
+    uint32_t    startTime;      // Start of the read in ms since boot.
+    uint32_t    elapsedMs;      // Duration of the read, updated with every chunk.
+};
+
+/**
+ * @brief Counters of a streaming write.
+ */
+struct NimBLEStreamStats {
+    uint32_t    bytes;          // Bytes queued so far.
+    uint32_t    packets;        // Write commands queued so far.
+    uint32_t    creditWaits;    // Times the writer waited for the controller to free its buffers.
+    uint32_t    stalls;         // Times the host ran out of buffers (ENOMEM) before the window was full.
+    uint32_t    elapsedMs;      // Duration of the write.
+    uint32_t    bytesPerSec;    // Average throughput of the write.
+};
 
 /**
  * @brief A model of a remote %BLE characteristic.
@@ -46,11 +74,16 @@ public:
     bool        canWrite();
     bool        canWriteNoResponse();
     NimBLERemoteDescriptor* getDescriptor(NimBLEUUID uuid);
-    std::map<std::string, NimBLERemoteDescriptor*>* getDescriptors();
+    NimBLEUUIDMap<NimBLERemoteDescriptor*>* getDescriptors();
     uint16_t    getHandle();
     uint16_t    getDefHandle();
     NimBLEUUID  getUUID();
     std::string readValue();
+    size_t      readValue(uint8_t* buf, size_t bufLen);
+    int         readValueAsync(read_complete_cb completeCb, void* arg = nullptr);
+    int         readValueLong(read_chunk_cb chunkCb, void* arg = nullptr);
+    int         readValueLong(uint8_t* buf, size_t bufLen, size_t* readLen);
+    const NimBLELongReadStats& getLongReadStats();
     uint8_t     readUInt8();
     uint16_t    readUInt16();
     uint32_t    readUInt32();
@@ -58,7 +91,40 @@ public:
     bool        writeValue(uint8_t* data, size_t length, bool response = false);
     bool        writeValue(std::string newValue, bool response = false);
     bool        writeValue(uint8_t newValue, bool response = false);
+    int         writeValueAsync(const uint8_t* data, size_t length, write_complete_cb completeCb, void* arg = nullptr);
+    int         writeValueStream(const uint8_t* data, size_t length, uint16_t window = 0);
+    const NimBLEStreamStats& getStreamStats();
     std::string toString();
+
+    /**
+     * @brief Read the value of the remote characteristic as a trivially copyable type.
+     * The value is copied straight from the host buffers, a longer value is truncated.
+     * @return The value or a value initialized T if the read failed or the value is too short.
+     */
+    template<typename T>
+    T readValue() {
+        static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+        T value = T();
+        if(readValue((uint8_t*)&value, sizeof(T)) < sizeof(T)) {
+            return T();
+        }
+        return value;
+    }
+
+    /**
+     * @brief Write a trivially copyable value to the remote characteristic.
+     * The type must be given explicitly, e.g. writeValue<uint16_t>(interval), so that string
+     * literals and integers keep using the std::string and byte overloads.
+     * @param [in] value The value to write, sent as its sizeof(T) bytes.
+     * @param [in] response Whether we require a response from the write.
+     * @return false if not connected or cant perform write for some reason.
+     */
+    template<typename T>
+    bool writeValue(const typename std::common_type<T>::type& value, bool response = false) {
+        static_assert(std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value,
+                      "T must be trivially copyable and not a pointer");
+        return writeValue((uint8_t*)&value, sizeof(T), response);
+    }
 //  uint8_t*    readRawData();
     NimBLERemoteService* getRemoteService();
 
@@ -69,16 +135,23 @@ private:
     friend class NimBLEClient;
     friend class NimBLERemoteService;
     friend class NimBLERemoteDescriptor;
+    friend class NimBLENotifyQueue;
 
     // Private member functions
     void              removeDescriptors();
-    bool              retrieveDescriptors(uint16_t endHdl);
+    bool              retrieveDescriptors();
+    static int        descriptorDiscCB(uint16_t conn_handle, const struct ble_gatt_error *error,
+                                       uint16_t chr_val_handle, const struct ble_gatt_dsc *dsc,
+                                       void *arg);
     static int        onReadCB(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg);
     static int        onWriteCB(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg);
+    static int        onReadAsyncCB(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg);
+    static int        onWriteAsyncCB(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg);
+    static int        onReadLongCB(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg);
+    static bool       copyChunkCB(NimBLERemoteCharacteristic* pBLERemoteCharacteristic, const uint8_t* pData, size_t length, size_t offset, void* arg);
+    int               performRead(uint8_t* buf, size_t bufLen);
+    uint16_t          getFixedLength();
     void              releaseSemaphores();
-    static int        descriptorDiscCB(uint16_t conn_handle, const struct ble_gatt_error *error,
-                                uint16_t chr_val_handle, const struct ble_gatt_dsc *dsc,
-                                void *arg);
     
     // Private properties
     NimBLEUUID              m_uuid;
@@ -86,15 +159,28 @@ private:
     uint16_t                m_handle;
     uint16_t                m_defHandle;
     NimBLERemoteService*    m_pRemoteService;
-    FreeRTOS::Semaphore     m_semaphoreGetDescEvt       = FreeRTOS::Semaphore("GetDescEvt");
     FreeRTOS::Semaphore     m_semaphoreReadCharEvt      = FreeRTOS::Semaphore("ReadCharEvt");
     FreeRTOS::Semaphore     m_semaphoreWriteCharEvt     = FreeRTOS::Semaphore("WriteCharEvt");
     std::string             m_value;
+    uint8_t*                m_readBuf = nullptr;        // Receives the value instead of m_value when set.
+    size_t                  m_readBufLen = 0;
+    size_t                  m_readLen = 0;              // Bytes copied into m_readBuf by the last read.
     //uint8_t               *m_rawData = nullptr;
     notify_callback         m_notifyCallback;
+    bool                    m_haveDescriptors = false;  // Descriptors retrieved on demand in lazy discovery mode.
+    uint16_t                m_fixedLength = 0;          // Value length given by the presentation format, 0 if it varies.
+    bool                    m_haveFixedLength = false;  // m_fixedLength was looked up.
+    read_complete_cb        m_readCb = nullptr;         // Pending readValueAsync completion.
+    void*                   m_readCbArg = nullptr;
+    write_complete_cb       m_writeCb = nullptr;        // Pending writeValueAsync completion.
+    void*                   m_writeCbArg = nullptr;
+    read_chunk_cb           m_chunkCb = nullptr;        // Receives the fragments of a long read.
+    void*                   m_chunkCbArg = nullptr;
+    NimBLELongReadStats     m_longReadStats = {};
+    NimBLEStreamStats       m_streamStats = {};
 
     // We maintain a map of descriptors owned by this characteristic keyed by a string representation of the UUID.
-    std::map<std::string, NimBLERemoteDescriptor*> m_descriptorMap;
+    NimBLEUUIDMap<NimBLERemoteDescriptor*> m_descriptorMap;
 }; // BLERemoteCharacteristic
 #endif /* CONFIG_BT_ENABLED */
 #endif /* COMPONENTS_NIMBLEREMOTECHARACTERISTIC_H_ */
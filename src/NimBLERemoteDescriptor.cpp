@@ -47,7 +47,7 @@ NimBLERemoteDescriptor::NimBLERemoteDescriptor(NimBLERemoteCharacteristic* pRemo
             m_uuid = NimBLEUUID(const_cast<ble_uuid128_t*>(&dsc->uuid.u128));
             break;
         default:
-            m_uuid = nullptr;
+            m_uuid = NimBLEUUID();
             break;
     }
     m_handle                = dsc->handle;
@@ -100,11 +100,20 @@ int NimBLERemoteDescriptor::onReadCB(uint16_t conn_handle,
     
     NIMBLE_LOGI(LOG_TAG, "Read complete; status=%d conn_handle=%d", error->status, conn_handle);
     
-    if (error->status == 0) {       
-        desc->m_value = std::string((char*) attr->om->om_data, attr->om->om_len);
+    if (error->status == 0) {
+        uint16_t len = OS_MBUF_PKTLEN(attr->om);
+        if (desc->m_readBuf != nullptr) {
+            desc->m_readLen = len < desc->m_readBufLen ? len : desc->m_readBufLen;
+            os_mbuf_copydata(attr->om, 0, desc->m_readLen, desc->m_readBuf);
+        } else {
+            desc->m_value.resize(len);
+            os_mbuf_copydata(attr->om, 0, len, &desc->m_value[0]);
+        }
         desc->m_semaphoreReadDescrEvt.give(0);
     } else {
-        desc->m_value = "";
+        if (desc->m_readBuf == nullptr) {
+            desc->m_value = "";
+        }
         desc->m_semaphoreReadDescrEvt.give(error->status);
     }
     
@@ -115,6 +124,39 @@ int NimBLERemoteDescriptor::onReadCB(uint16_t conn_handle,
 std::string NimBLERemoteDescriptor::readValue() {
     NIMBLE_LOGD(LOG_TAG, ">> Descriptor readValue: %s", toString().c_str());
     
+    int rc = performRead(nullptr, 0);
+
+    NIMBLE_LOGD(LOG_TAG, "<< Descriptor readValue(): length: %d, rc: %d", m_value.length(), rc);
+    
+    return (rc == 0) ? m_value : "";
+} // readValue
+
+
+/**
+ * @brief Read the value of the remote descriptor into a caller provided buffer.
+ * Nothing is allocated and the value returned by readValue() is not updated.
+ * @param [in] buf The buffer that receives the value.
+ * @param [in] bufLen The size of the buffer, a longer value is truncated.
+ * @return The number of bytes copied, 0 if the read failed.
+ */
+size_t NimBLERemoteDescriptor::readValue(uint8_t* buf, size_t bufLen) {
+    NIMBLE_LOGD(LOG_TAG, ">> Descriptor readValue: handle: %d, buffer: %d bytes", m_handle, bufLen);
+    
+    int rc = performRead(buf, bufLen);
+
+    NIMBLE_LOGD(LOG_TAG, "<< Descriptor readValue(): length: %d, rc: %d", m_readLen, rc);
+    
+    return (rc == 0) ? m_readLen : 0;
+} // readValue
+
+
+/**
+ * @brief Read the value of the remote descriptor, securing the connection if the peer requires it.
+ * @param [in] buf The buffer that receives the value, nullptr to store it in m_value.
+ * @param [in] bufLen The size of the buffer.
+ * @return 0 on success, otherwise the host error code.
+ */
+int NimBLERemoteDescriptor::performRead(uint8_t* buf, size_t bufLen) {
     NimBLEClient* pClient = getRemoteCharacteristic()->getRemoteService()->getClient();
     
     int rc = 0;
@@ -123,11 +165,14 @@ std::string NimBLERemoteDescriptor::readValue() {
     // Check to see that we are connected.
     if (!pClient->isConnected()) {
         NIMBLE_LOGE(LOG_TAG, "Disconnected");
-        return "";
+        return BLE_HS_ENOTCONN;
     }
     
     do {
         m_semaphoreReadDescrEvt.take("ReadDescriptor");
+        m_readBuf = buf;
+        m_readBufLen = bufLen;
+        m_readLen = 0;
         
         rc = ble_gattc_read(pClient->getConnId(), m_handle,
                         NimBLERemoteDescriptor::onReadCB, this);
@@ -135,7 +180,7 @@ std::string NimBLERemoteDescriptor::readValue() {
         if (rc != 0) {
             NIMBLE_LOGE(LOG_TAG, "Descriptor read failed, code: %d", rc);
             m_semaphoreReadDescrEvt.give();
-            return "";
+            return rc;
         }
         
         rc = m_semaphoreReadDescrEvt.wait("ReadDescriptor");
@@ -151,40 +196,26 @@ std::string NimBLERemoteDescriptor::readValue() {
                     break;
                 
             default:
-                return "";
+                return rc;
         }
     } while(rc != 0 && retryCount--);
 
-    NIMBLE_LOGD(LOG_TAG, "<< Descriptor readValue(): length: %d, rc: %d", m_value.length(), rc);
-    
-    return (rc == 0) ? m_value : "";
-} // readValue
+    return rc;
+} // performRead
 
 
 uint8_t NimBLERemoteDescriptor::readUInt8() {
-    std::string value = readValue();
-    if (value.length() >= 1) {
-        return (uint8_t) value[0];
-    }
-    return 0;
+    return readValue<uint8_t>();
 } // readUInt8
 
 
 uint16_t NimBLERemoteDescriptor::readUInt16() {
-    std::string value = readValue();
-    if (value.length() >= 2) {
-        return *(uint16_t*) value.data();
-    }
-    return 0;
+    return readValue<uint16_t>();
 } // readUInt16
 
 
 uint32_t NimBLERemoteDescriptor::readUInt32() {
-    std::string value = readValue();
-    if (value.length() >= 4) {
-        return *(uint32_t*) value.data();
-    }
-    return 0;
+    return readValue<uint32_t>();
 } // readUInt32
 
 
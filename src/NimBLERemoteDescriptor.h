@@ -19,6 +19,8 @@
 
 #include "NimBLERemoteCharacteristic.h"
 
+#include <type_traits>
+
 class NimBLERemoteCharacteristic;
 /**
  * @brief A model of remote %BLE descriptor.
@@ -29,6 +31,7 @@ public:
     NimBLERemoteCharacteristic* getRemoteCharacteristic();
     NimBLEUUID     getUUID();
     std::string readValue(void);
+    size_t      readValue(uint8_t* buf, size_t bufLen);
     uint8_t     readUInt8(void);
     uint16_t    readUInt16(void);
     uint32_t    readUInt32(void);
@@ -37,17 +40,48 @@ public:
     bool        writeValue(std::string newValue, bool response = false);
     bool        writeValue(uint8_t newValue, bool response = false);
 
+    /**
+     * @brief Read the value of the remote descriptor as a trivially copyable type.
+     * @return The value or a value initialized T if the read failed or the value is too short.
+     */
+    template<typename T>
+    T readValue() {
+        static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+        T value = T();
+        if(readValue((uint8_t*)&value, sizeof(T)) < sizeof(T)) {
+            return T();
+        }
+        return value;
+    }
+
+    /**
+     * @brief Write a trivially copyable value to the remote descriptor, the type must be given explicitly.
+     * @param [in] value The value to write, sent as its sizeof(T) bytes.
+     * @param [in] response True if we expect a response.
+     */
+    template<typename T>
+    bool writeValue(const typename std::common_type<T>::type& value, bool response = false) {
+        static_assert(std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value,
+                      "T must be trivially copyable and not a pointer");
+        return writeValue((uint8_t*)&value, sizeof(T), response);
+    }
 
 private:
     friend class NimBLERemoteCharacteristic;
+    friend class NimBLERemoteService;
+    friend class NimBLEClient;
     NimBLERemoteDescriptor(NimBLERemoteCharacteristic* pRemoteCharacteristic, const struct ble_gatt_dsc *dsc);
     static int  onWriteCB(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg);
     static int  onReadCB(uint16_t conn_handle, const struct ble_gatt_error *error, struct ble_gatt_attr *attr, void *arg);
+    int         performRead(uint8_t* buf, size_t bufLen);
     void        releaseSemaphores();
 
     uint16_t                    m_handle;                  // Server handle of this descriptor.
     NimBLEUUID                  m_uuid;                    // UUID of this descriptor.
     std::string                 m_value;                   // Last received value of the descriptor.
+    uint8_t*                    m_readBuf = nullptr;       // Receives the value instead of m_value when set.
+    size_t                      m_readBufLen = 0;
+    size_t                      m_readLen = 0;             // Bytes copied into m_readBuf by the last read.
     NimBLERemoteCharacteristic* m_pRemoteCharacteristic;   // Reference to the Remote characteristic of which this descriptor is associated.
     FreeRTOS::Semaphore         m_semaphoreReadDescrEvt  = FreeRTOS::Semaphore("ReadDescrEvt");
     FreeRTOS::Semaphore         m_semaphoreDescWrite     = FreeRTOS::Semaphore("WriteDescEvt");
@@ -51,7 +51,7 @@ NimBLERemoteService::NimBLERemoteService(NimBLEClient* pClient, const struct ble
             m_uuid = NimBLEUUID(const_cast<ble_uuid128_t*>(&service->uuid.u128));
             break;
         default:
-            m_uuid = nullptr;
+            m_uuid = NimBLEUUID();
             break;
     }
     m_startHandle = service->start_handle;
@@ -87,21 +87,67 @@ NimBLERemoteCharacteristic* NimBLERemoteService::getCharacteristic(const char* u
  * @return Reference to the characteristic object, or nullptr if not found.
  */
 NimBLERemoteCharacteristic* NimBLERemoteService::getCharacteristic(NimBLEUUID uuid) {
-    if (m_haveCharacteristics) {
-        std::string v = uuid.toString();
-        for (auto &myPair : m_characteristicMap) {
-            if (myPair.first == v) {
-                return myPair.second;
-            }
+    if (m_haveCharacteristics || m_pClient->m_lazyDiscovery) {
+        auto it = m_characteristicMap.find(uuid);
+        if (it != m_characteristicMap.end()) {
+            return it->second;
         }
     }
+    
+    if (!m_haveCharacteristics && m_pClient->m_lazyDiscovery) {
+        return discoverCharacteristic(uuid);
+    }
 
     return nullptr;
 } // getCharacteristic
 
 
+/**
+ * @brief Discover a single characteristic of this service by UUID.
+ * Used in lazy discovery mode, the descriptors are not discovered until needed.
+ * @param [in] uuid Characteristic uuid.
+ * @return Reference to the characteristic object, or nullptr if not found.
+ */
+NimBLERemoteCharacteristic* NimBLERemoteService::discoverCharacteristic(NimBLEUUID uuid) {
+    NIMBLE_LOGD(LOG_TAG, ">> discoverCharacteristic: uuid: %s", uuid.toString().c_str());
+    
+    if(!m_pClient->isConnected() || uuid.getNative() == nullptr) {
+        return nullptr;
+    }
+    
+    m_pClient->m_semaphoreSearchCmplEvt.take("discoverCharacteristic");
+    
+    int rc = ble_gattc_disc_chrs_by_uuid(m_pClient->getConnId(),
+                                         m_startHandle,
+                                         m_endHandle,
+                                         &uuid.getNative()->u,
+                                         NimBLERemoteService::characteristicDiscCB,
+                                         this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_chrs_by_uuid: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        m_pClient->m_semaphoreSearchCmplEvt.give();
+        return nullptr;
+    }
+    
+    if(m_pClient->m_semaphoreSearchCmplEvt.wait("discoverCharacteristic") != 0) {
+        return nullptr;
+    }
+    
+    auto it = m_characteristicMap.find(uuid);
+    if(it != m_characteristicMap.end()) {
+        NIMBLE_LOGD(LOG_TAG, "<< discoverCharacteristic: found");
+        return it->second;
+    }
+    
+    NIMBLE_LOGD(LOG_TAG, "<< discoverCharacteristic: not found");
+    return nullptr;
+} // discoverCharacteristic
+
+
 /**
  * @brief Callback for Characterisic discovery.
+ * When the characteristics of this service are complete the descriptor discovery is started
+ * directly from the host task.
  */
 int NimBLERemoteService::characteristicDiscCB(uint16_t conn_handle, 
                                 const struct ble_gatt_error *error,
@@ -119,20 +165,29 @@ int NimBLERemoteService::characteristicDiscCB(uint16_t conn_handle,
     
     switch (error->status) {
         case 0: {
+            // Keep a characteristic a lazy lookup already found.
+            if(service->m_characteristicMapByHandle.count(chr->val_handle) > 0) {
+                break;
+            }
             // Found a service - add it to the map
             NimBLERemoteCharacteristic* pRemoteCharacteristic = new NimBLERemoteCharacteristic(service, chr);
-            service->m_characteristicMap.insert(std::pair<std::string, NimBLERemoteCharacteristic*>(pRemoteCharacteristic->getUUID().toString(), pRemoteCharacteristic));
+            service->m_characteristicMap.insert(std::make_pair(pRemoteCharacteristic->getUUID(), pRemoteCharacteristic));
             service->m_characteristicMapByHandle.insert(std::pair<uint16_t, NimBLERemoteCharacteristic*>(chr->val_handle, pRemoteCharacteristic));
             break;
         }
         case BLE_HS_EDONE:{
+            // A lazy lookup found its characteristic, unless discoverAsync() asked for the whole database.
+            if(service->m_pClient->m_lazyDiscovery && service->m_pClient->m_discoverCb == nullptr) {
+                // Single characteristic requested, the descriptors will be discovered when needed.
+                service->m_pClient->m_semaphoreSearchCmplEvt.give(0);
+                break;
+            }
             /* All characteristics in this service discovered; start discovering
-            * characteristics in the next service.
+            * the descriptors of the whole service.
             */
-
-            NIMBLE_LOGD(LOG_TAG,"Giving search Characteristic semaphore - completed");
-            service->m_semaphoreGetCharEvt.give(0);
-            rc = 0;
+            NIMBLE_LOGI(LOG_TAG, "Found %d Characteristics", service->m_characteristicMapByHandle.size());
+            service->m_haveCharacteristics = true;
+            rc = service->discoverDescriptors();
             break;
         }
         default:
@@ -145,7 +200,7 @@ int NimBLERemoteService::characteristicDiscCB(uint16_t conn_handle,
         // release memory from any characteristics we created
         //service->removeCharacteristics(); --this will now be done when we clear services on returning with error
         NIMBLE_LOGE(LOG_TAG, "characteristicDiscCB() rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
-        service->m_semaphoreGetCharEvt.give(1);
+        service->m_pClient->discoveryComplete(rc);
     }
     NIMBLE_LOGD(LOG_TAG,"<< Characteristic Discovered. status: %d", rc);
     return rc;
@@ -153,75 +208,141 @@ int NimBLERemoteService::characteristicDiscCB(uint16_t conn_handle,
 
 
 /**
- * @brief Retrieve all the characteristics for this service.
- * This function will not return until we have all the characteristics.
- * @return N/A
+ * @brief Callback for descriptor discovery over the whole service range.
+ * The procedure also reports the characteristic declarations and values, those are skipped
+ * and every other handle is added to the characteristic it follows.
  */
-bool NimBLERemoteService::retrieveCharacteristics() {
-    NIMBLE_LOGD(LOG_TAG, ">> retrieveCharacteristics() for service: %s", getUUID().toString().c_str());
-    
-    int rc = 0;
-    //removeCharacteristics(); // Forget any previous characteristics.
-    
-    m_semaphoreGetCharEvt.take("retrieveCharacteristics");
+int NimBLERemoteService::descriptorDiscCB(uint16_t conn_handle, 
+                                const struct ble_gatt_error *error,
+                                uint16_t chr_val_handle, 
+                                const struct ble_gatt_dsc *dsc,
+                                void *arg) 
+{
+    NIMBLE_LOGD(LOG_TAG,"Descriptor Discovered >> status: %d handle: %d", error->status, conn_handle);
     
-    rc = ble_gattc_disc_all_chrs(m_pClient->getConnId(),
-                                 m_startHandle,
-                                 m_endHandle,
-                                 NimBLERemoteService::characteristicDiscCB,
-                                 this);
-    if (rc != 0) {
-        NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_all_chrs: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
-        m_haveCharacteristics = false;
-        m_semaphoreGetCharEvt.give();
-        return false;
+    NimBLERemoteService *service = (NimBLERemoteService*)arg;
+    int rc=0;
+
+    // Make sure the discovery is for this device
+    if(service->getClient()->getConnId() != conn_handle){
+        return 0;
     }
     
-    m_haveCharacteristics = (m_semaphoreGetCharEvt.wait("retrieveCharacteristics") == 0);
-    if(m_haveCharacteristics){
-        uint16_t endHdl = 0xFFFF;
-        NIMBLE_LOGI(LOG_TAG, "Found %d Characteristics", m_characteristicMapByHandle.size());
-        for (auto it = m_characteristicMapByHandle.cbegin(); it != m_characteristicMapByHandle.cend(); ++it) {
-            NIMBLE_LOGD(LOG_TAG, "Found UUID: %s Handle: %d Def Handle: %d", (*it).second->getUUID().toString().c_str(), (*it).second->getHandle(), (*it).second->getDefHandle());
-            // The descriptor handle is between this characteristic val_handle and the next ones def_handle
-            // so make the end of the scan at the handle before the next characteristic def_handle
+    switch (error->status) {
+        case 0: {
+            // The first characteristic with a value handle at or above this one.
+            auto it = service->m_characteristicMapByHandle.lower_bound(dsc->handle);
             
-            // Make sure we don't go past the service end handle
-            if(++it != m_characteristicMapByHandle.cend()){
-                NIMBLE_LOGD(LOG_TAG, "Next UUID: %s Handle: %d Def Handle: %d", (*it).second->getUUID().toString().c_str(), (*it).second->getHandle(),(*it).second->getDefHandle());
-                
-                endHdl = (*it).second->getDefHandle()-1;
+            // Skip the value handles and the declaration of the next characteristic.
+            if(it != service->m_characteristicMapByHandle.end() && 
+              (it->first == dsc->handle || it->second->getDefHandle() == dsc->handle)) {
+                break;
             }
-            else{ 
-                NIMBLE_LOGD(LOG_TAG, "END CHARS");
-                endHdl = m_endHandle;
+            // Nothing before the first characteristic value can be a descriptor.
+            if(it == service->m_characteristicMapByHandle.begin()) {
+                break;
             }
-            --it;
             
-            //If there is no handles between this characteristic and the next there is no descriptor so skip to the next
-            if((*it).second->getHandle() != endHdl){
-                if(!m_pClient->m_isConnected || !(*it).second->retrieveDescriptors(endHdl)) {
-                    return false;
-                }
+            NimBLERemoteCharacteristic* pChr = (--it)->second;
+            // The descriptors of this characteristic were already retrieved on demand.
+            if(pChr->m_haveDescriptors) {
+                break;
+            }
+            NimBLERemoteDescriptor* pNewRemoteDescriptor = new NimBLERemoteDescriptor(pChr, dsc);
+            if(!pChr->m_descriptorMap.insert(std::make_pair(pNewRemoteDescriptor->getUUID(), pNewRemoteDescriptor)).second) {
+                delete pNewRemoteDescriptor;
             }
-            //NIMBLE_LOGD(LOG_TAG, "Found %d Characteristics in service UUID: %s", chars->size(), myPair.first.c_str());
+            break;
+        }
+        case BLE_HS_EDONE:{
+            /* All descriptors in this service discovered; move on to the next service. */
+            service->setHaveDescriptors();
+            service->m_pClient->discoverNextService();
+            rc = 0;
+            break;
         }
-        
-        NIMBLE_LOGD(LOG_TAG, "<< retrieveCharacteristics()");
-        return true;
+        default:
+            rc = error->status;
+            break;
     }
+    if (rc != 0) {
+        /* Error; abort discovery. */
+        NIMBLE_LOGE(LOG_TAG, "descriptorDiscCB() rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        service->m_pClient->discoveryComplete(rc);
+    }
+    NIMBLE_LOGD(LOG_TAG,"<< Descriptor Discovered. status: %d", rc);
+    return rc;
+}
+
+
+/**
+ * @brief Start the discovery of all the characteristics of this service.
+ * Does not wait for the result, the descriptors and the next service are discovered from the callbacks.
+ * @return 0 if the procedure was started, otherwise the host error code.
+ */
+int NimBLERemoteService::discoverCharacteristics() {
+    NIMBLE_LOGD(LOG_TAG, ">> discoverCharacteristics() for service: %s", getUUID().toString().c_str());
     
-    NIMBLE_LOGE(LOG_TAG, "Could not retrieve characteristics");
-    return false;
+    m_pClient->m_discProcCount++;
+    int rc = ble_gattc_disc_all_chrs(m_pClient->getConnId(),
+                                     m_startHandle,
+                                     m_endHandle,
+                                     NimBLERemoteService::characteristicDiscCB,
+                                     this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_all_chrs: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+        m_haveCharacteristics = false;
+    }
     
-} // retrieveCharacteristics
+    NIMBLE_LOGD(LOG_TAG, "<< discoverCharacteristics()");
+    return rc;
+} // discoverCharacteristics
+
+
+/**
+ * @brief Start the discovery of the descriptors of all the characteristics in this service.
+ * A single procedure covers the service range from the first characteristic value,
+ * if every handle is a declaration or value there are no descriptors and we go straight to the next service.
+ * @return 0 if the procedure was started or not needed, otherwise the host error code.
+ */
+int NimBLERemoteService::discoverDescriptors() {
+    if(m_characteristicMapByHandle.empty() || 
+       (uint32_t)(m_endHandle - m_startHandle) == m_characteristicMapByHandle.size() * 2) {
+        setHaveDescriptors();
+        m_pClient->discoverNextService();
+        return 0;
+    }
+    
+    m_pClient->m_discProcCount++;
+    int rc = ble_gattc_disc_all_dscs(m_pClient->getConnId(),
+                                     m_characteristicMapByHandle.begin()->first,
+                                     m_endHandle,
+                                     NimBLERemoteService::descriptorDiscCB,
+                                     this);
+    if (rc != 0) {
+        NIMBLE_LOGE(LOG_TAG, "ble_gattc_disc_all_dscs: rc=%d %s", rc, NimBLEUtils::returnCodeToString(rc));
+    }
+    
+    return rc;
+} // discoverDescriptors
+
+
+/**
+ * @brief Mark the descriptors of every characteristic as known after the service wide pass,
+ * so they are not discovered again on demand.
+ */
+void NimBLERemoteService::setHaveDescriptors() {
+    for(auto &chrPair : m_characteristicMapByHandle) {
+        chrPair.second->m_haveDescriptors = true;
+    }
+} // setHaveDescriptors
 
 
 /**
  * @brief Retrieve a map of all the characteristics of this service.
  * @return A map of all the characteristics of this service.
  */
-std::map<std::string, NimBLERemoteCharacteristic*>* NimBLERemoteService::getCharacteristics() {
+NimBLEUUIDMap<NimBLERemoteCharacteristic*>* NimBLERemoteService::getCharacteristics() {
     NIMBLE_LOGD(LOG_TAG, "getCharacteristics() for service: %s", getUUID().toString().c_str());
 
     return &m_characteristicMap;
@@ -292,6 +413,26 @@ std::string NimBLERemoteService::getValue(NimBLEUUID characteristicUuid) {
 } // readValue
 
 
+/**
+ * @brief Read the values of several characteristics of this service.
+ * The reads are batched into Read Multiple requests, see NimBLEClient::readValues().
+ * @param [in] characteristicUuids The characteristics to read.
+ * @returns The values in the same order, an empty string if not found or error.
+ */
+std::vector<std::string> NimBLERemoteService::getValues(const std::vector<NimBLEUUID> &characteristicUuids) {
+    NIMBLE_LOGD(LOG_TAG, ">> getValues: %d characteristics", characteristicUuids.size());
+    
+    std::vector<NimBLERemoteCharacteristic*> chars;
+    chars.reserve(characteristicUuids.size());
+    for(auto &uuid : characteristicUuids) {
+        chars.push_back(getCharacteristic(uuid));
+    }
+    
+    NIMBLE_LOGD(LOG_TAG, "<< getValues");
+    return m_pClient->readValues(chars);
+} // getValues
+
+
 /**
  * @brief Set the value of a characteristic.
  * @param [in] characteristicUuid The characteristic to set.
@@ -371,7 +512,6 @@ void NimBLERemoteService::releaseSemaphores() {
     for (auto &cPair : m_characteristicMapByHandle) {
        cPair.second->releaseSemaphores();
     }
-    m_semaphoreGetCharEvt.give(1);
 }
 
 #endif /* CONFIG_BT_ENABLED */
@@ -22,7 +22,10 @@
 #include "FreeRTOS.h"
 #include "NimBLERemoteCharacteristic.h"
 
+#include "NimBLEUUIDMap.h"
+
 #include <map>
+#include <vector>
 
 class NimBLEClient;
 class NimBLERemoteCharacteristic;
@@ -39,7 +42,7 @@ public:
     NimBLERemoteCharacteristic* getCharacteristic(const char* uuid);      // Get the specified characteristic reference.
     NimBLERemoteCharacteristic* getCharacteristic(NimBLEUUID uuid);       // Get the specified characteristic reference.
 //  BLERemoteCharacteristic* getCharacteristic(uint16_t uuid);      // Get the specified characteristic reference.
-    std::map<std::string, NimBLERemoteCharacteristic*>* getCharacteristics();
+    NimBLEUUIDMap<NimBLERemoteCharacteristic*>* getCharacteristics();
     std::map<uint16_t, NimBLERemoteCharacteristic*>* getCharacteristicsByHandle();  // Get the characteristics map.
 //  void getCharacteristics(std::map<uint16_t, BLERemoteCharacteristic*>* pCharacteristicMap);
 
@@ -47,6 +50,7 @@ public:
     uint16_t                 getHandle();                                               // Get the handle of this service.
     NimBLEUUID               getUUID(void);                                             // Get the UUID of this service.
     std::string              getValue(NimBLEUUID characteristicUuid);                      // Get the value of a characteristic.
+    std::vector<std::string> getValues(const std::vector<NimBLEUUID> &characteristicUuids);   // Get the values of several characteristics.
     bool                     setValue(NimBLEUUID characteristicUuid, std::string value);   // Set the value of a characteristic.
     std::string              toString(void);
 
@@ -59,10 +63,18 @@ private:
     friend class NimBLERemoteCharacteristic;
 
     // Private methods
-    bool                retrieveCharacteristics(void);   // Retrieve the characteristics from the BLE Server.
+    int                 discoverCharacteristics(void);   // Start retrieving the characteristics from the BLE Server.
+    int                 discoverDescriptors(void);       // Start retrieving the descriptors of all characteristics.
+    void                setHaveDescriptors();            // Mark the descriptors of all characteristics as discovered.
+    NimBLERemoteCharacteristic* discoverCharacteristic(NimBLEUUID uuid); // Retrieve a single characteristic by UUID.
     static int          characteristicDiscCB(uint16_t conn_handle, 
                                 const struct ble_gatt_error *error,
                                 const struct ble_gatt_chr *chr, void *arg);
+    static int          descriptorDiscCB(uint16_t conn_handle, 
+                                const struct ble_gatt_error *error,
+                                uint16_t chr_val_handle, 
+                                const struct ble_gatt_dsc *dsc,
+                                void *arg);
 
     uint16_t            getStartHandle();                // Get the start handle for this service.
     uint16_t            getEndHandle();                  // Get the end handle for this service.
@@ -72,14 +84,13 @@ private:
     // Properties
 
     // We maintain a map of characteristics owned by this service keyed by a string representation of the UUID.
-    std::map<std::string, NimBLERemoteCharacteristic*> m_characteristicMap;
+    NimBLEUUIDMap<NimBLERemoteCharacteristic*> m_characteristicMap;
 
     // We maintain a map of characteristics owned by this service keyed by a handle.
     std::map<uint16_t, NimBLERemoteCharacteristic*> m_characteristicMapByHandle;
 
     bool                m_haveCharacteristics; // Have we previously obtained the characteristics.
     NimBLEClient*       m_pClient;
-    FreeRTOS::Semaphore m_semaphoreGetCharEvt = FreeRTOS::Semaphore("GetCharEvt");
     NimBLEUUID          m_uuid;             // The UUID of this service.
     uint16_t            m_startHandle;      // The starting handle of this service.
     uint16_t            m_endHandle;        // The ending handle of this service.
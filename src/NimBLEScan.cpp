@@ -18,6 +18,8 @@
 #include "NimBLEUtils.h"
 #include "NimBLEDevice.h"
 
+#include "nimble/nimble_port.h"
+
 //#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 //#include "esp32-hal-log.h"
 //#define LOG_TAG ""
@@ -30,6 +32,8 @@
 #include "NimBLELog.h"
 
 #include <string>
+#include <string.h>
+#include <algorithm>
 
 static const char* LOG_TAG = "NimBLEScan";
 
@@ -57,6 +61,24 @@ static const char* LOG_TAG = "NimBLEScan";
 //#define BLE_HCI_SCAN_FILT_MAX               (3)
 
 
+/**
+ * @brief Get the key of a device in the result store, its packed address and address type.
+ */
+static uint64_t deviceKey(NimBLEAdvertisedDevice* pDevice) {
+    return pDevice->getAddress().getKey();
+} // deviceKey
+
+
+/**
+ * @brief Get the home slot of a key in the result store index.
+ * @param [in] key The device key.
+ * @param [in] bits The log2 of the index size.
+ */
+static uint16_t hashSlot(uint64_t key, uint8_t bits) {
+    return (uint16_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+} // hashSlot
+
+
 /**
  * @brief Scan constuctor.
  */
@@ -87,68 +109,17 @@ NimBLEScan::NimBLEScan() {
 /*STATIC*/int NimBLEScan::handleGapEvent(ble_gap_event* event, void* arg) {
     
     NimBLEScan* pScan = (NimBLEScan*)arg;
-    struct ble_hs_adv_fields fields;
-    int rc = 0;
     
     switch(event->type) {
 
         case BLE_GAP_EVENT_DISC: {
-            NimBLEAdvertisedDevice* advertisedDevice = nullptr;
-            
-            rc = ble_hs_adv_parse_fields(&fields, event->disc.data,
-                                     event->disc.length_data);
-            if (rc != 0) {
-                NIMBLE_LOGE(LOG_TAG, "Gap Event Parse ERROR.");
-                return 0;
-            }
-            
-            NimBLEAddress advertisedAddress(event->disc.addr);
-
-            // Print advertisement data
-            print_adv_fields(&fields);
-
-            // If we are not scanning, nothing to do with the extra results.
-            if (pScan->m_stopped) { 
-                return 0;
-            }
-
-            // Examine our list of ignored addresses and stop processing if we don't want to see it or are already connected
-            if(NimBLEDevice::isIgnored(advertisedAddress)) {
-                NIMBLE_LOGI(LOG_TAG, "Ignoring device address: %s", advertisedAddress.toString().c_str());
-                return 0;
-            }
-            
-            // If we've seen this device before get a pointer to it from the map
-            auto it = pScan->m_scanResults.m_advertisedDevicesMap.find(advertisedAddress.toString());
-            if(it != pScan->m_scanResults.m_advertisedDevicesMap.cend()) {
-                advertisedDevice = (*it).second;
-            }
-
-            // If we haven't seen this device before; create a new instance and insert it in the map.
-            // Otherwise just update the relevant parameters of the already known device.
-            if(advertisedDevice == nullptr){
-                advertisedDevice = new NimBLEAdvertisedDevice();
-                advertisedDevice->setAddressType(event->disc.addr.type);
-                advertisedDevice->setAddress(advertisedAddress);
-                pScan->m_scanResults.m_advertisedDevicesMap.insert(std::pair<std::string, NimBLEAdvertisedDevice*>(advertisedAddress.toString(), advertisedDevice));
-                NIMBLE_LOGI(LOG_TAG, "NEW DEVICE FOUND: %s", advertisedAddress.toString().c_str());
-            }
-            else{
-                NIMBLE_LOGI(LOG_TAG, "UPDATING PREVIOUSLY FOUND DEVICE: %s", advertisedAddress.toString().c_str());
-            }
-            advertisedDevice->setRSSI(event->disc.rssi); 
-            advertisedDevice->setAdvType(event->disc.event_type);
-            advertisedDevice->parseAdvertisement(&fields);
-            advertisedDevice->setScan(pScan);
-            advertisedDevice->setAdvertisementResult(event->disc.data, event->disc.length_data);
-
-            if (pScan->m_pAdvertisedDeviceCallbacks) {
-                pScan->m_pAdvertisedDeviceCallbacks->onResult(advertisedDevice);
-                //m_pAdvertisedDeviceCallbacks->onResult(*advertisedDevice);
-            }
-
-            return 0;
+            return pScan->handleReport(&event->disc, event->disc.length_data, BLE_HCI_LE_PHY_1M, 0, 0xFF);
         }
+#if MYNEWT_VAL(BLE_EXT_ADV)
+        case BLE_GAP_EVENT_EXT_DISC: {
+            return pScan->handleExtReport(&event->ext_disc);
+        }
+#endif
         case BLE_GAP_EVENT_DISC_COMPLETE: {
             NIMBLE_LOGI(LOG_TAG, "discovery complete; reason=%d\n",
                     event->disc_complete.reason);
@@ -156,8 +127,10 @@ NimBLEScan::NimBLEScan() {
             pScan->m_stopped = true;
 
             pScan->m_semaphoreScanEnd.give();
-            if (pScan->m_scanCompleteCB != nullptr) {
-                pScan->m_scanCompleteCB(pScan->m_scanResults);
+            if (pScan->m_scanCompleteCB != nullptr && NimBLEDevice::m_pExecutor != nullptr) {
+                NimBLEDevice::m_pExecutor->post({EXEC_EVT_SCAN_COMPLETE, 0, BLE_HS_CONN_HANDLE_NONE, 0, 0, pScan});
+            } else if (pScan->m_scanCompleteCB != nullptr) {
+                pScan->m_scanCompleteCB(pScan->getResults());
             }
             
             return 0;
@@ -169,6 +142,308 @@ NimBLEScan::NimBLEScan() {
 }  // gapEventHandler
 
 
+/**
+ * @brief Process an advertising report, legacy or reassembled extended, in the host task.
+ * @param [in] disc The report, its data holds length bytes.
+ * @param [in] length The length of the data, more than length_data for a reassembled extended report.
+ * @param [in] primPhy The primary advertising PHY.
+ * @param [in] secPhy The secondary advertising PHY, 0 for a legacy report.
+ * @param [in] sid The advertising set ID, 0xFF for a legacy report.
+ */
+int NimBLEScan::handleReport(const ble_gap_disc_desc* disc, size_t length, uint8_t primPhy, uint8_t secPhy, uint8_t sid) {
+    NimBLEAdvertisedDevice* advertisedDevice = nullptr;
+
+    // If we are not scanning, nothing to do with the extra results.
+    if (m_stopped) { 
+        return 0;
+    }
+
+    bool isScanResponse = disc->event_type == BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP;
+    NimBLEAddress advertisedAddress(disc->addr);
+    uint64_t key = advertisedAddress.getKey();
+
+    // The controller already dropped the other devices when the white list is in use.
+    if(!m_whiteListActive && !m_allowSet.empty() && m_allowSet.count(advertisedAddress) == 0) {
+        return 0;
+    }
+
+    // A scan response completes a device that already passed the filters, any other
+    // report is filtered on its own raw data before the result store is touched, the
+    // advertisement and scan response of a device are not combined.
+    if(isScanResponse) {
+        advertisedDevice = findDevice(key);
+    }
+    if(advertisedDevice == nullptr && !m_filter.matches(disc, length)) {
+        return 0;
+    }
+
+    // Examine our list of ignored addresses and stop processing if we don't want to see it or are already connected
+    if(NimBLEDevice::isIgnored(advertisedAddress)) {
+        return 0;
+    }
+
+    // If we've seen this device before get a pointer to it from the result store
+    if(advertisedDevice == nullptr && !isScanResponse) {
+        advertisedDevice = findDevice(key);
+    }
+
+    // With the host duplicate filter only changed reports of a known device go further.
+    if(m_dedup.isEnabled() && !m_dedup.shouldForward(disc, length, advertisedDevice != nullptr)) {
+        return 0;
+    }
+
+    // If we haven't seen this device before take a free slot in the store, evicting one if it is full.
+    // Otherwise just update the relevant parameters of the already known device,
+    // the payload is copied into its fixed buffer and parsed lazily by the getters.
+    if(advertisedDevice == nullptr){
+        m_stats.misses++;
+        advertisedDevice = addDevice(disc->addr);
+        if(advertisedDevice == nullptr) {
+            return 0;
+        }
+        advertisedDevice->setScan(this);
+        NIMBLE_LOGD(LOG_TAG, "New device found");
+    } else {
+        // A deferred callback is reading this device, the report is lost rather than tearing it.
+        if(!beginUpdate(advertisedDevice - &m_devicePool[0])) {
+            m_stats.held++;
+            return 0;
+        }
+        m_stats.hits++;
+    }
+    advertisedDevice->m_lastSeen = FreeRTOS::getTimeSinceStart();
+    advertisedDevice->setRSSI(disc->rssi); 
+    advertisedDevice->setAdvType(disc->event_type);
+    advertisedDevice->m_primPhy = primPhy;
+    advertisedDevice->m_secPhy = secPhy;
+    advertisedDevice->m_sid = sid;
+    advertisedDevice->setPayload(disc->data, length, isScanResponse);
+    endUpdate();
+
+    bool arrived = false;
+    if (m_tracker.isEnabled()) {
+        arrived = m_tracker.update(advertisedDevice - &m_devicePool[0], disc->rssi,
+                                   isScanResponse, advertisedDevice->m_lastSeen);
+        if (!ble_npl_callout_is_active(&m_presenceTimer)) {
+            ble_npl_callout_reset(&m_presenceTimer, ble_npl_time_ms_to_ticks32(m_tracker.getTickMs()));
+        }
+    }
+
+    if (m_pBatch != nullptr) {
+        m_pBatch->push(disc);
+    }
+
+    if (m_pRing != nullptr) {
+        m_pRing->push(disc);
+    }
+
+    if (m_pAdvertisedDeviceCallbacks && NimBLEDevice::m_pExecutor != nullptr) {
+        NimBLEDevice::m_pExecutor->post({EXEC_EVT_SCAN_RESULT, (uint8_t)(arrived ? NIMBLE_EXEC_FLAG_ARRIVED : 0), 
+                                         BLE_HS_CONN_HANDLE_NONE, (uint32_t)(advertisedDevice - &m_devicePool[0]), key, this});
+    } else if (m_pAdvertisedDeviceCallbacks) {
+        if (arrived) {
+            m_pAdvertisedDeviceCallbacks->onArrived(advertisedDevice);
+        }
+        m_pAdvertisedDeviceCallbacks->onResult(advertisedDevice);
+        //m_pAdvertisedDeviceCallbacks->onResult(*advertisedDevice);
+    }
+
+    return 0;
+} // handleReport
+
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+/**
+ * @brief Reassemble an extended advertising report and process it once complete.
+ *
+ * The fragments of a chained report arrive as separate events, each is appended once to a
+ * preallocated chain buffer for its address and advertising set and the report is processed
+ * when the last fragment arrives.  Data beyond the buffer size is dropped.
+ *
+ * @param [in] ext The extended report fragment received from the host.
+ */
+int NimBLEScan::handleExtReport(const ble_gap_ext_disc_desc* ext) {
+    if (m_stopped) {
+        return 0;
+    }
+
+    ble_gap_disc_desc disc;
+    disc.addr = ext->addr;
+    disc.rssi = ext->rssi;
+    disc.direct_addr = ext->direct_addr;
+    disc.data = ext->data;
+    disc.length_data = ext->length_data;
+    size_t length = ext->length_data;
+
+    // Report the type of an extended advertisement as the legacy type with the same properties.
+    if(ext->props & BLE_HCI_ADV_LEGACY_MASK) {
+        disc.event_type = ext->legacy_event_type;
+    } else if(ext->props & BLE_HCI_ADV_SCAN_RSP_MASK) {
+        disc.event_type = BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP;
+    } else if(ext->props & BLE_HCI_ADV_DIRECT_MASK) {
+        disc.event_type = BLE_HCI_ADV_RPT_EVTYPE_DIR_IND;
+    } else if(ext->props & BLE_HCI_ADV_CONN_MASK) {
+        disc.event_type = BLE_HCI_ADV_RPT_EVTYPE_ADV_IND;
+    } else if(ext->props & BLE_HCI_ADV_SCAN_MASK) {
+        disc.event_type = BLE_HCI_ADV_RPT_EVTYPE_SCAN_IND;
+    } else {
+        disc.event_type = BLE_HCI_ADV_RPT_EVTYPE_NONCONN_IND;
+    }
+
+    uint64_t key = NimBLEAddress(ext->addr).getKey();
+    ExtChain* pChain = findChain(key, ext->sid);
+
+    if(pChain != nullptr || ext->data_status == BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+        if(pChain == nullptr) {
+            pChain = startChain(key, ext->sid);
+        }
+
+        size_t room = pChain->data.size() - pChain->length;
+        size_t fragment = ext->length_data < room ? ext->length_data : room;
+        memcpy(pChain->data.data() + pChain->length, ext->data, fragment);
+        pChain->length += fragment;
+
+        if(ext->data_status == BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+            return 0;
+        }
+
+        // The chain is released now, its buffer is only read until handleReport returns.
+        pChain->active = false;
+        disc.data = pChain->data.data();
+        length = pChain->length;
+        disc.length_data = length < UINT8_MAX ? length : UINT8_MAX;
+    }
+
+    return handleReport(&disc, length, ext->prim_phy, ext->sec_phy, ext->sid);
+} // handleExtReport
+
+
+/**
+ * @brief Find the chain buffer receiving the fragments of an advertising set.
+ * @param [in] key The device key.
+ * @param [in] sid The advertising set ID.
+ * @return The chain or nullptr if no fragments of this set are pending.
+ */
+NimBLEScan::ExtChain* NimBLEScan::findChain(uint64_t key, uint8_t sid) {
+    for(auto &chain : m_extChains) {
+        if(chain.active && chain.key == key && chain.sid == sid) {
+            return &chain;
+        }
+    }
+    return nullptr;
+} // findChain
+
+
+/**
+ * @brief Take a chain buffer for the first fragment of a report.
+ * A chain whose last fragment was lost is reused, the oldest first, when none is free.
+ * @param [in] key The device key.
+ * @param [in] sid The advertising set ID.
+ * @return The empty chain.
+ */
+NimBLEScan::ExtChain* NimBLEScan::startChain(uint64_t key, uint8_t sid) {
+    uint32_t now = FreeRTOS::getTimeSinceStart();
+    ExtChain* pChain = &m_extChains[0];
+
+    for(auto &chain : m_extChains) {
+        if(!chain.active) {
+            pChain = &chain;
+            break;
+        }
+        if(now - chain.started > now - pChain->started) {
+            pChain = &chain;
+        }
+    }
+
+    if(pChain->active) {
+        NIMBLE_LOGD(LOG_TAG, "Dropping incomplete extended report");
+    }
+
+    pChain->active = true;
+    pChain->key = key;
+    pChain->sid = sid;
+    pChain->length = 0;
+    pChain->started = now;
+    return pChain;
+} // startChain
+
+
+/**
+ * @brief Scan for extended advertisements on the primary PHYs given.
+ *
+ * Legacy advertisements are still reported, extended ones are reassembled from their chained
+ * reports into one payload of up to CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN bytes and delivered
+ * through the same callbacks and results.  Advertisements using the 2M PHY are received while
+ * scanning the 1M primary PHY.  Should only be called while not scanning.  The devices only get room
+ * for an extended payload while extended scanning is enabled, a change clears the results at the
+ * next start.  The batch and stream reports keep the first BLE_HS_ADV_MAX_SZ bytes of an
+ * extended payload only.
+ *
+ * @param [in] phyMask BLE_HCI_LE_PHY_1M_PREF_MASK and/or BLE_HCI_LE_PHY_CODED_PREF_MASK,
+ * 0 to go back to legacy scanning.
+ * @return False if a scan is in progress.
+ */
+bool NimBLEScan::setExtendedScan(uint8_t phyMask) {
+    if(!m_stopped) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot change extended scanning while scanning");
+        return false;
+    }
+
+    m_extPhys = phyMask & (BLE_HCI_LE_PHY_1M_PREF_MASK | BLE_HCI_LE_PHY_CODED_PREF_MASK);
+
+    if(m_extPhys == 0) {
+        std::vector<ExtChain>().swap(m_extChains);
+        return true;
+    }
+
+    if(m_extChains.empty()) {
+        m_extChains.resize(NIMBLE_SCAN_EXT_CHAINS);
+        for(auto &chain : m_extChains) {
+            chain.data.resize(CONFIG_BT_NIMBLE_MAX_EXT_ADV_DATA_LEN);
+        }
+    }
+    return true;
+} // setExtendedScan
+
+
+/**
+ * @brief Set the interval and window of extended scanning on one primary PHY.
+ * @param [in] phy BLE_HCI_LE_PHY_1M or BLE_HCI_LE_PHY_CODED.
+ * @param [in] intervalMSecs The scan interval in msecs, 0 for the default.
+ * @param [in] windowMSecs The scan window in msecs, 0 for the default.
+ */
+void NimBLEScan::setPhyScanParams(uint8_t phy, uint16_t intervalMSecs, uint16_t windowMSecs) {
+    ble_gap_ext_disc_params* pParams = (phy == BLE_HCI_LE_PHY_CODED) ? &m_extParams[1] : &m_extParams[0];
+    pParams->itvl = intervalMSecs / 0.625;
+    pParams->window = windowMSecs / 0.625;
+} // setPhyScanParams
+#endif
+
+
+/**
+ * @brief Expire the departure timeouts, runs periodically in the host task while devices are present.
+ * @param [in] event The timer event, its argument is the scan.
+ */
+/*STATIC*/void NimBLEScan::presenceTimerCb(ble_npl_event* event) {
+    NimBLEScan* pScan = (NimBLEScan*)ble_npl_event_get_arg(event);
+    uint32_t now = FreeRTOS::getTimeSinceStart();
+    uint16_t pos;
+
+    while((pos = pScan->m_tracker.nextDeparted(now)) != 0) {
+        if(pScan->m_pAdvertisedDeviceCallbacks && NimBLEDevice::m_pExecutor != nullptr) {
+            NimBLEDevice::m_pExecutor->post({EXEC_EVT_SCAN_DEPARTED, 0, BLE_HS_CONN_HANDLE_NONE, (uint32_t)(pos - 1),
+                                             deviceKey(&pScan->m_devicePool[pos - 1]), pScan});
+        } else if(pScan->m_pAdvertisedDeviceCallbacks) {
+            pScan->m_pAdvertisedDeviceCallbacks->onDeparted(&pScan->m_devicePool[pos - 1]);
+        }
+    }
+
+    if(pScan->m_tracker.getStats().present > 0) {
+        ble_npl_callout_reset(&pScan->m_presenceTimer, ble_npl_time_ms_to_ticks32(pScan->m_tracker.getTickMs()));
+    }
+} // presenceTimerCb
+
+
 /**
  * @brief Should we perform an active or passive scan?
  * The default is a passive scan.  An active scan means that we will wish a scan response.
@@ -231,9 +506,15 @@ bool NimBLEScan::start(uint32_t duration, void (*scanCompleteCB)(NimBLEScanResul
     
     //  if we are connecting to devices that are advertising even after being connected, multiconnecting peripherals
     //  then we should not clear map or we will connect the same device few times
-    if(!is_continue) {
+    if(m_devicePool.size() != m_maxResults || m_payloadSize != payloadSize()) {
+        allocateResults();
+    } else if(!is_continue) {
         clearResults();
     }
+
+    if(!is_continue) {
+        m_dedup.clear();
+    }
     
     // If Host is not synced we cannot start scanning.
     if(!NimBLEDevice::m_synced) {
@@ -241,6 +522,8 @@ bool NimBLEScan::start(uint32_t duration, void (*scanCompleteCB)(NimBLEScanResul
         return false;
     }
     
+    applyWhiteList();
+
     m_semaphoreScanEnd.take("start");
     // Save the callback to be invoked when the scan completes.
     m_scanCompleteCB = scanCompleteCB;                  
@@ -253,7 +536,29 @@ bool NimBLEScan::start(uint32_t duration, void (*scanCompleteCB)(NimBLEScanResul
         duration = duration*1000; // convert duration to milliseconds
     }
     
-    int rc = ble_gap_disc(m_own_addr_type, duration, &m_scan_params, NimBLEScan::handleGapEvent, this);
+    int rc;
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    if(m_extPhys != 0) {
+        for(auto &chain : m_extChains) {
+            chain.active = false;
+        }
+        m_extParams[0].passive = m_scan_params.passive;
+        m_extParams[1].passive = m_scan_params.passive;
+
+        // The extended scan duration is in 10ms units, 0 to scan until stopped.
+        uint32_t extDuration = duration == BLE_HS_FOREVER ? 0 : duration / 10;
+        if(extDuration > UINT16_MAX) {
+            extDuration = UINT16_MAX;
+        }
+
+        rc = ble_gap_ext_disc(m_own_addr_type, extDuration, 0, m_scan_params.filter_duplicates,
+                              m_scan_params.filter_policy, m_scan_params.limited,
+                              (m_extPhys & BLE_HCI_LE_PHY_1M_PREF_MASK) ? &m_extParams[0] : nullptr,
+                              (m_extPhys & BLE_HCI_LE_PHY_CODED_PREF_MASK) ? &m_extParams[1] : nullptr,
+                              NimBLEScan::handleGapEvent, this);
+    } else
+#endif
+    rc = ble_gap_disc(m_own_addr_type, duration, &m_scan_params, NimBLEScan::handleGapEvent, this);
     if (rc != 0) {
         NIMBLE_LOGE(LOG_TAG, "Error initiating GAP discovery procedure; rc=%d\n", rc);
         m_semaphoreScanEnd.give();
@@ -276,7 +581,7 @@ NimBLEScanResults NimBLEScan::start(uint32_t duration, bool is_continue) {
     if(start(duration, nullptr, is_continue)) {
         m_semaphoreScanEnd.wait("start");   // Wait for the semaphore to release.
     }
-    return m_scanResults;
+    return getResults();
 } // start
 
 
@@ -297,7 +602,7 @@ void NimBLEScan::stop() {
     m_semaphoreScanEnd.give();
     
     if (m_scanCompleteCB != nullptr) {
-        m_scanCompleteCB(m_scanResults);
+        m_scanCompleteCB(getResults());
     }
 
     NIMBLE_LOGD(LOG_TAG, "<< stop()");
@@ -307,9 +612,13 @@ void NimBLEScan::stop() {
 // delete peer device from cache after disconnecting, it is required in case we are connecting to devices with not public address
 void NimBLEScan::erase(NimBLEAddress address) {
     NIMBLE_LOGI(LOG_TAG, "erase device: %s", address.toString().c_str());
-    NimBLEAdvertisedDevice *advertisedDevice = m_scanResults.m_advertisedDevicesMap.find(address.toString())->second;
-    m_scanResults.m_advertisedDevicesMap.erase(address.toString());
-    delete advertisedDevice;
+    // The address type is not known here, remove the device for any of them.
+    for(uint8_t type = 0; type <= BLE_ADDR_RANDOM_ID; type++) {
+        NimBLEAdvertisedDevice* pDevice = findDevice(NimBLEAddress((uint64_t)address, type).getKey());
+        if(pDevice != nullptr) {
+            removeDevice(pDevice);
+        }
+    }
 }
 
 
@@ -328,28 +637,682 @@ void NimBLEScan::onHostReset() {
  * @return NimBLEScanResults object.
  */
 NimBLEScanResults NimBLEScan::getResults() {
-    return m_scanResults;
+    NimBLEScanResults results;
+    // Reserved first so the copy made in the critical section does not allocate.
+    results.m_devices.reserve(m_maxResults);
+    portENTER_CRITICAL(&m_devicesMux);
+    results.m_devices.assign(m_devices.begin(), m_devices.end());
+    portEXIT_CRITICAL(&m_devicesMux);
+    return results;
 }
 
 
 /**
  * @brief Clear the results of the scan.
+ * The devices are returned to the result store, no memory is released.
  */
 void NimBLEScan::clearResults() {
-    for(auto _dev : m_scanResults.m_advertisedDevicesMap){
-        delete _dev.second;
+    portENTER_CRITICAL(&m_devicesMux);
+    m_devices.clear();
+    portEXIT_CRITICAL(&m_devicesMux);
+    m_tracker.clear();
+
+    std::fill(m_deviceIndex.begin(), m_deviceIndex.end(), 0);
+    m_freeDevices.clear();
+    for(uint16_t i = m_devicePool.size(); i > 0; i--) {
+        m_freeDevices.push_back(i - 1);
     }
-    m_scanResults.m_advertisedDevicesMap.clear();
 }
 
 
+/**
+ * @brief Only report this device, in addition to the others already allowed.
+ *
+ * When devices are allowed the scan uses the controller white list so the reports of other
+ * devices are not sent to the host.  If the controller cannot hold them all they are filtered
+ * by the host instead.  The controller white list is shared with connections and advertising and
+ * is updated when a scan starts, the allowed devices can only be changed while not scanning.
+ *
+ * @param [in] address The address of the device.
+ * @param [in] type The address type of the device.
+ * @return False if a scan is in progress.
+ */
+bool NimBLEScan::addAllowed(NimBLEAddress address, uint8_t type) {
+    if(!m_stopped) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot change the allowed devices while scanning");
+        return false;
+    }
+
+    m_allowSet.insert(NimBLEAddress((uint64_t)address, type));
+    m_whiteListActive = false;
+    return true;
+} // addAllowed
+
+
+/**
+ * @brief Stop reporting a device that was allowed.
+ * @param [in] address The address of the device.
+ * @param [in] type The address type of the device.
+ * @return False if a scan is in progress.
+ */
+bool NimBLEScan::removeAllowed(NimBLEAddress address, uint8_t type) {
+    if(!m_stopped) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot change the allowed devices while scanning");
+        return false;
+    }
+
+    m_allowSet.erase(NimBLEAddress((uint64_t)address, type));
+    m_whiteListActive = false;
+    return true;
+} // removeAllowed
+
+
+/**
+ * @brief Report all devices again from the next scan on.
+ * @return False if a scan is in progress.
+ */
+bool NimBLEScan::clearAllowed() {
+    if(!m_stopped) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot change the allowed devices while scanning");
+        return false;
+    }
+
+    m_allowSet.clear();
+    m_whiteListActive = false;
+    return true;
+} // clearAllowed
+
+
+/**
+ * @brief Load the allowed devices in the controller white list before a scan starts.
+ */
+void NimBLEScan::applyWhiteList() {
+    m_whiteListActive = false;
+    m_scan_params.filter_policy = BLE_HCI_SCAN_FILT_NO_WL;
+
+    if(m_allowSet.empty()) {
+        return;
+    }
+
+    std::vector<ble_addr_t> addrs;
+    addrs.reserve(m_allowSet.size());
+    for(auto &address : m_allowSet) {
+        addrs.push_back(address.getBase());
+    }
+
+    int rc = ble_gap_wl_set(addrs.data(), addrs.size());
+    if(rc != 0) {
+        NIMBLE_LOGW(LOG_TAG, "Cannot load %d devices in the white list, filtering on the host; rc=%d %s",
+                    addrs.size(), rc, NimBLEUtils::returnCodeToString(rc));
+        return;
+    }
+
+    m_scan_params.filter_policy = BLE_HCI_SCAN_FILT_USE_WL;
+    m_whiteListActive = true;
+} // applyWhiteList
+
+
+/**
+ * @brief Set the capacity of the scan results and how to make room once it is reached.
+ *
+ * The devices are preallocated so memory use does not depend on how long the scan runs.
+ * An evicted device is reused for the new one, so a pointer received in onResult() is only
+ * valid until the next result when the store is full.
+ *
+ * @param [in] maxResults The maximum number of devices kept in the results, at most
+ * NIMBLE_SCAN_MAX_RESULTS_LIMIT, a larger value is reduced to it.
+ * @param [in] policy Which device to replace when a new one is found and the results are full.
+ * @return False if a scan is in progress.
+ */
+bool NimBLEScan::setMaxResults(uint16_t maxResults, scan_evict_policy policy) {
+    if(!m_stopped) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot change the scan results capacity while scanning");
+        return false;
+    }
+
+    if(maxResults > NIMBLE_SCAN_MAX_RESULTS_LIMIT) {
+        NIMBLE_LOGW(LOG_TAG, "Scan results capacity limited to %d", NIMBLE_SCAN_MAX_RESULTS_LIMIT);
+        maxResults = NIMBLE_SCAN_MAX_RESULTS_LIMIT;
+    }
+
+    m_maxResults = maxResults > 0 ? maxResults : 1;
+    m_evictPolicy = policy;
+    allocateResults();
+    return true;
+} // setMaxResults
+
+
+/**
+ * @brief Get the counters of the scan result store.
+ * @return A copy of the counters.
+ */
+NimBLEScanStats NimBLEScan::getStats() {
+    return m_stats;
+} // getStats
+
+
+/**
+ * @brief Reset the counters of the scan result store.
+ */
+void NimBLEScan::resetStats() {
+    m_stats = {};
+} // resetStats
+
+
+/**
+ * @brief Get the filters applied to the advertising reports before they are added to the results.
+ * The filters should only be changed while not scanning.
+ * @return A pointer to the scan filter.
+ */
+NimBLEScanFilter* NimBLEScan::getFilter() {
+    return &m_filter;
+} // getFilter
+
+
+/**
+ * @brief Replace the controller duplicate filter with a change detecting one on the host.
+ *
+ * The controller only reports the first advertisement of each device, so changing data is missed.
+ * The host filter receives every report but only passes on those whose payload changed, whose RSSI
+ * moved by at least rssiThreshold or that were last passed on more than refreshMs ago.
+ *
+ * @param [in] numEntries The number of devices tracked, 0 to go back to the controller duplicate filter.
+ * @param [in] rssiThreshold The RSSI change in dBm that forwards an unchanged report, 0 to ignore the RSSI.
+ * @param [in] refreshMs The time after which an unchanged report is forwarded, 0 to only forward changes.
+ * @return False if a scan is in progress.
+ */
+bool NimBLEScan::setDuplicateFilter(uint16_t numEntries, uint8_t rssiThreshold, uint32_t refreshMs) {
+    if(!m_stopped) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot change the duplicate filter while scanning");
+        return false;
+    }
+
+    m_dedup.configure(numEntries, rssiThreshold, refreshMs);
+    m_scan_params.filter_duplicates = m_dedup.isEnabled() ? 0 : 1;
+    return true;
+} // setDuplicateFilter
+
+
+/**
+ * @brief Get the counters of the host duplicate filter.
+ * @return A copy of the counters.
+ */
+NimBLEScanDedupStats NimBLEScan::getDuplicateFilterStats() {
+    return m_dedup.getStats();
+} // getDuplicateFilterStats
+
+
+/**
+ * @brief Deliver the reports to an application task in batches.
+ *
+ * Each report that passes the filters is copied into a preallocated buffer, the application
+ * task receives them with takeBatch() as one array per batchSize reports or once the first
+ * report of the batch is maxLatencyMs old.  The result callbacks are still invoked if set.
+ * An extended advertisement is cut to BLE_HS_ADV_MAX_SZ bytes in its report, see NimBLEScanReport.
+ * Should only be called while not scanning and with no task waiting in takeBatch().
+ *
+ * @param [in] batchSize The maximum number of reports in a batch, 0 to stop batch delivery.
+ * @param [in] maxLatencyMs The maximum time a report waits before its batch is delivered.
+ * @return False if a scan is in progress.
+ */
+bool NimBLEScan::setBatchDelivery(uint16_t batchSize, uint32_t maxLatencyMs) {
+    if(!m_stopped) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot change batch delivery while scanning");
+        return false;
+    }
+
+    if(m_pBatch != nullptr) {
+        delete m_pBatch;
+        m_pBatch = nullptr;
+    }
+
+    if(batchSize > 0) {
+        m_pBatch = new NimBLEScanBatch(batchSize, maxLatencyMs);
+    }
+    return true;
+} // setBatchDelivery
+
+
+/**
+ * @brief Wait for the next batch of reports, to be called from an application task.
+ * @param [out] count The number of reports in the batch.
+ * @param [in] timeoutMs How long to wait in milliseconds, UINT32_MAX to wait forever.
+ * @return The reports, valid until releaseBatch() or the next call, or nullptr on timeout
+ * or if batch delivery is not enabled.
+ */
+const NimBLEScanReport* NimBLEScan::takeBatch(size_t* count, uint32_t timeoutMs) {
+    if(m_pBatch == nullptr) {
+        *count = 0;
+        return nullptr;
+    }
+    return m_pBatch->take(count, timeoutMs);
+} // takeBatch
+
+
+/**
+ * @brief Give the last batch back so its buffer can be filled again.
+ */
+void NimBLEScan::releaseBatch() {
+    if(m_pBatch != nullptr) {
+        m_pBatch->release();
+    }
+} // releaseBatch
+
+
+/**
+ * @brief Get the counters of the batch delivery.
+ * @return A copy of the counters, all zero if batch delivery is not enabled.
+ */
+NimBLEScanBatchStats NimBLEScan::getBatchStats() {
+    if(m_pBatch == nullptr) {
+        return NimBLEScanBatchStats();
+    }
+    return m_pBatch->getStats();
+} // getBatchStats
+
+
+/**
+ * @brief Stream the reports to an application task through a lock free ring.
+ *
+ * Each report that passes the filters is copied into a preallocated single producer, single
+ * consumer ring that one application task reads with getReportStream()->wait() and pop() or peek().
+ * An extended advertisement is cut to BLE_HS_ADV_MAX_SZ bytes in its report, see NimBLEScanReport.
+ * Should only be called while not scanning and with no task reading the stream.
+ *
+ * @param [in] capacity The number of reports the ring holds, 0 to stop streaming.
+ * @return False if a scan is in progress.
+ */
+bool NimBLEScan::setReportStream(uint16_t capacity) {
+    if(!m_stopped) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot change the report stream while scanning");
+        return false;
+    }
+
+    if(m_pRing != nullptr) {
+        delete m_pRing;
+        m_pRing = nullptr;
+    }
+
+    if(capacity > 0) {
+        m_pRing = new NimBLEScanRing(capacity);
+    }
+    return true;
+} // setReportStream
+
+
+/**
+ * @brief Get the report stream to read from.
+ * @return The ring or nullptr if streaming is not enabled.
+ */
+NimBLEScanRing* NimBLEScan::getReportStream() {
+    return m_pRing;
+} // getReportStream
+
+
+/**
+ * @brief Track the presence of the devices in the scan results.
+ *
+ * The smoothed RSSI, first and last seen times and advertising interval of each device are kept
+ * in a table preallocated for the capacity of the results and updated in the host task.
+ * onArrived() is called when a device is seen after being absent and onDeparted() when it was
+ * not seen for departMs or is evicted from the results.  The controller duplicate filter only
+ * reports a device once, use setDuplicateFilter() to receive its following advertisements.
+ * Should only be called while not scanning.
+ *
+ * @param [in] departMs The time after which a device that was not seen departs, 0 to stop tracking.
+ * @return False if a scan is in progress.
+ */
+bool NimBLEScan::setPresenceTracking(uint32_t departMs) {
+    if(!m_stopped) {
+        NIMBLE_LOGE(LOG_TAG, "Cannot change presence tracking while scanning");
+        return false;
+    }
+
+    if(!m_presenceTimerInit) {
+        ble_npl_callout_init(&m_presenceTimer, nimble_port_get_dflt_eventq(), NimBLEScan::presenceTimerCb, this);
+        m_presenceTimerInit = true;
+    }
+    ble_npl_callout_stop(&m_presenceTimer);
+
+    m_tracker.configure(departMs);
+    m_tracker.allocate(m_devicePool.size());
+    return true;
+} // setPresenceTracking
+
+
+/**
+ * @brief Get the presence tracker to choose how the RSSI is smoothed and read its counters.
+ * @return A pointer to the tracker.
+ */
+NimBLEScanTracker* NimBLEScan::getTracker() {
+    return &m_tracker;
+} // getTracker
+
+
+/**
+ * @brief Get the presence state of a device in the scan results.
+ * @param [in] pDevice A device from the scan results.
+ * @return The state, valid until the device is removed from the results, or nullptr if tracking is disabled.
+ */
+const NimBLEPresence* NimBLEScan::getPresence(NimBLEAdvertisedDevice* pDevice) {
+    if(m_devicePool.empty() || pDevice < &m_devicePool.front() || pDevice > &m_devicePool.back()) {
+        return nullptr;
+    }
+    return m_tracker.get(pDevice - &m_devicePool[0]);
+} // getPresence
+
+
+/**
+ * @brief Get the payload storage needed by each device.
+ * Room for an extended advertisement is only reserved when extended scanning is enabled.
+ */
+uint16_t NimBLEScan::payloadSize() {
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    if(m_extPhys != 0) {
+        return NIMBLE_ADV_PAYLOAD_EXT_SZ;
+    }
+#endif
+    return NIMBLE_ADV_PAYLOAD_LEGACY_SZ;
+} // payloadSize
+
+
+/**
+ * @brief Allocate the result store for the current capacity and payload size, the results are cleared.
+ */
+void NimBLEScan::allocateResults() {
+    waitReleased();
+    std::vector<NimBLEAdvertisedDevice>(m_maxResults).swap(m_devicePool);
+    m_payloadSize = payloadSize();
+    for(auto &device : m_devicePool) {
+        device.allocatePayload(m_payloadSize);
+    }
+    m_tracker.allocate(m_maxResults);
+
+    // Allocated before the swap, the executor reads the flags under the lock.
+    std::vector<uint8_t> departing(m_maxResults, 0);
+    portENTER_CRITICAL(&m_holdMux);
+    m_departing.swap(departing);
+    portEXIT_CRITICAL(&m_holdMux);
+
+    // Keep the index at most half full so the probe sequences stay short.
+    m_deviceIndexBits = 1;
+    while((1U << m_deviceIndexBits) < m_maxResults * 2U) {
+        m_deviceIndexBits++;
+    }
+    std::vector<uint16_t>(1U << m_deviceIndexBits, 0).swap(m_deviceIndex);
+
+    m_freeDevices.reserve(m_maxResults);
+    m_devices.reserve(m_maxResults);
+    clearResults();
+} // allocateResults
+
+
+/**
+ * @brief Find the index slot of a key.
+ * @param [in] key The device key.
+ * @return The slot holding the key, or the empty slot where it would be inserted.
+ */
+uint16_t NimBLEScan::indexSlot(uint64_t key) {
+    uint16_t mask = m_deviceIndex.size() - 1;
+    uint16_t slot = hashSlot(key, m_deviceIndexBits);
+
+    while(m_deviceIndex[slot] != 0 && deviceKey(&m_devicePool[m_deviceIndex[slot] - 1]) != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+} // indexSlot
+
+
+/**
+ * @brief Find a device in the result store.
+ * @param [in] key The device key.
+ * @return The device or nullptr if it is not in the results.
+ */
+NimBLEAdvertisedDevice* NimBLEScan::findDevice(uint64_t key) {
+    if(m_devicePool.empty()) {
+        return nullptr;
+    }
+
+    uint16_t pos = m_deviceIndex[indexSlot(key)];
+    return pos != 0 ? &m_devicePool[pos - 1] : nullptr;
+} // findDevice
+
+
+/**
+ * @brief Take a device from the result store for a new address, evicting one if the store is full.
+ * @param [in] addr The address of the new device.
+ * @return The reset device or nullptr if the store is full and the policy is SCAN_EVICT_NONE.
+ */
+NimBLEAdvertisedDevice* NimBLEScan::addDevice(const ble_addr_t &addr) {
+    std::vector<NimBLEAdvertisedDevice*> &devices = m_devices;
+
+    if(m_freeDevices.empty()) {
+        if(m_evictPolicy == SCAN_EVICT_NONE || devices.empty()) {
+            m_stats.rejected++;
+            return nullptr;
+        }
+
+        // The results are in the order the devices were found, the device held by a deferred
+        // callback is not replaced.
+        portENTER_CRITICAL(&m_holdMux);
+        uint16_t heldPos = m_heldPos;
+        portEXIT_CRITICAL(&m_holdMux);
+
+        NimBLEAdvertisedDevice* pVictim = nullptr;
+        for(auto &pDevice : devices) {
+            if(pDevice - &m_devicePool[0] + 1 == heldPos) {
+                continue;
+            }
+            if(pVictim == nullptr ||
+               (m_evictPolicy == SCAN_EVICT_LRU && pDevice->m_lastSeen < pVictim->m_lastSeen) ||
+               (m_evictPolicy == SCAN_EVICT_WEAKEST_RSSI && pDevice->m_rssi < pVictim->m_rssi))
+            {
+                pVictim = pDevice;
+            }
+        }
+
+        if(pVictim == nullptr) {
+            m_stats.rejected++;
+            return nullptr;
+        }
+
+        removeDevice(pVictim);
+        m_stats.evictions++;
+    }
+
+    // A free device may still be held by the callback of its last report, take another one.
+    size_t i = m_freeDevices.size();
+    while(i > 0 && !beginUpdate(m_freeDevices[i - 1])) {
+        i--;
+    }
+    if(i == 0) {
+        m_stats.held++;
+        return nullptr;
+    }
+
+    uint16_t pos = m_freeDevices[i - 1];
+    m_freeDevices.erase(m_freeDevices.begin() + (i - 1));
+
+    NimBLEAdvertisedDevice* pDevice = &m_devicePool[pos];
+    pDevice->reset();
+    pDevice->setAddress(NimBLEAddress(addr));
+    pDevice->setAddressType(addr.type);
+    m_deviceIndex[indexSlot(deviceKey(pDevice))] = pos + 1;
+    portENTER_CRITICAL(&m_devicesMux);
+    devices.push_back(pDevice);
+    portEXIT_CRITICAL(&m_devicesMux);
+    return pDevice;
+} // addDevice
+
+
+/**
+ * @brief Mark a device as being written by the host task.
+ * @param [in] pos The position of the device in the result store.
+ * @return False if the device is held by a deferred callback or waits for its onDeparted()
+ * and must not be changed.
+ */
+bool NimBLEScan::beginUpdate(uint16_t pos) {
+    bool ok;
+    portENTER_CRITICAL(&m_holdMux);
+    ok = m_heldPos != pos + 1 && m_departing[pos] == 0;
+    if(ok) {
+        m_updatePos = pos + 1;
+    }
+    portEXIT_CRITICAL(&m_holdMux);
+    return ok;
+} // beginUpdate
+
+
+/**
+ * @brief End the write started by beginUpdate().
+ */
+void NimBLEScan::endUpdate() {
+    portENTER_CRITICAL(&m_holdMux);
+    m_updatePos = 0;
+    portEXIT_CRITICAL(&m_holdMux);
+} // endUpdate
+
+
+/**
+ * @brief Hold a device for a deferred callback, the host task leaves it unchanged until released.
+ * Waits for a write of the host task to that device to finish.
+ * @param [in] pos The position of the device in the result store.
+ * @param [in] key The key of the device the callback is for.
+ * @return The device or nullptr if the position now holds another device.
+ */
+NimBLEAdvertisedDevice* NimBLEScan::holdDevice(uint32_t pos, uint64_t key) {
+    for(;;) {
+        NimBLEAdvertisedDevice* pDevice = nullptr;
+        bool writing = false;
+
+        portENTER_CRITICAL(&m_holdMux);
+        if(pos < m_devicePool.size()) {
+            writing = m_updatePos == pos + 1;
+            if(!writing && deviceKey(&m_devicePool[pos]) == key) {
+                pDevice = &m_devicePool[pos];
+                m_heldPos = pos + 1;
+                m_holder = xTaskGetCurrentTaskHandle();
+            }
+        }
+        portEXIT_CRITICAL(&m_holdMux);
+
+        if(!writing) {
+            return pDevice;
+        }
+        vTaskDelay(1);
+    }
+} // holdDevice
+
+
+/**
+ * @brief Release the device held by holdDevice().
+ */
+void NimBLEScan::releaseDevice() {
+    portENTER_CRITICAL(&m_holdMux);
+    m_heldPos = 0;
+    m_holder = nullptr;
+    portEXIT_CRITICAL(&m_holdMux);
+} // releaseDevice
+
+
+/**
+ * @brief Wait until no deferred callback holds a device, before the result store is reallocated.
+ * Does not wait when called from that callback.
+ */
+void NimBLEScan::waitReleased() {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for(;;) {
+        portENTER_CRITICAL(&m_holdMux);
+        bool held = m_heldPos != 0 && m_holder != self;
+        portEXIT_CRITICAL(&m_holdMux);
+        if(!held) {
+            return;
+        }
+        vTaskDelay(1);
+    }
+} // waitReleased
+
+
+/**
+ * @brief Let the host task reuse a removed device once its deferred onDeparted() has run.
+ * @param [in] pos The position of the device in the result store.
+ */
+void NimBLEScan::endDeparture(uint32_t pos) {
+    portENTER_CRITICAL(&m_holdMux);
+    if(pos < m_departing.size()) {
+        m_departing[pos] = 0;
+    }
+    portEXIT_CRITICAL(&m_holdMux);
+} // endDeparture
+
+
+/**
+ * @brief Return a device to the result store.
+ * With an event executor onDeparted() is called from the worker and the device is only reused
+ * after that, see beginUpdate().
+ * @param [in] pDevice The device to remove from the results.
+ */
+void NimBLEScan::removeDevice(NimBLEAdvertisedDevice* pDevice) {
+    std::vector<NimBLEAdvertisedDevice*> &devices = m_devices;
+    uint16_t pos = pDevice - &m_devicePool[0];
+    uint16_t mask = m_deviceIndex.size() - 1;
+    uint16_t i = indexSlot(deviceKey(pDevice));
+    uint16_t j = i;
+
+    // Linear probing deletion, shift back the following entries that would no longer be reachable.
+    m_deviceIndex[i] = 0;
+    for(;;) {
+        j = (j + 1) & mask;
+        if(m_deviceIndex[j] == 0) {
+            break;
+        }
+
+        uint16_t home = hashSlot(deviceKey(&m_devicePool[m_deviceIndex[j] - 1]), m_deviceIndexBits);
+        if((i <= j) ? (i < home && home <= j) : (i < home || home <= j)) {
+            continue;
+        }
+
+        m_deviceIndex[i] = m_deviceIndex[j];
+        m_deviceIndex[j] = 0;
+        i = j;
+    }
+
+    portENTER_CRITICAL(&m_devicesMux);
+    for(auto it = devices.begin(); it != devices.end(); ++it) {
+        if(*it == pDevice) {
+            devices.erase(it);
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&m_devicesMux);
+
+    if(m_tracker.remove(pos) && m_pAdvertisedDeviceCallbacks) {
+        if(NimBLEDevice::m_pExecutor != nullptr) {
+            // Flagged before posting, the worker may run the callback straight away.
+            portENTER_CRITICAL(&m_holdMux);
+            m_departing[pos] = 1;
+            portEXIT_CRITICAL(&m_holdMux);
+
+            if(!NimBLEDevice::m_pExecutor->post({EXEC_EVT_SCAN_DEPARTED, NIMBLE_EXEC_FLAG_REMOVED,
+                                                 BLE_HS_CONN_HANDLE_NONE, pos, deviceKey(pDevice), this})) {
+                endDeparture(pos);
+            }
+        } else {
+            m_pAdvertisedDeviceCallbacks->onDeparted(pDevice);
+        }
+    }
+
+    m_freeDevices.push_back(pos);
+} // removeDevice
+
+
 /**
  * @brief Dump the scan results to the log.
  */
 void NimBLEScanResults::dump() {
     NIMBLE_LOGD(LOG_TAG, ">> Dump scan results:");
-    for (int i=0; i<getCount(); i++) {
-        NIMBLE_LOGI(LOG_TAG, "- %s", getDevice(i).toString().c_str());
+    for (auto pDevice : *this) {
+        NIMBLE_LOGI(LOG_TAG, "- %s", pDevice->toString().c_str());
     }
 } // dump
 
@@ -359,25 +1322,38 @@ void NimBLEScanResults::dump() {
  * @return The number of devices found in the last scan.
  */
 int NimBLEScanResults::getCount() {
-    return m_advertisedDevicesMap.size();
+    return m_devices.size();
 } // getCount
 
 
 /**
  * @brief Return the specified device at the given index.
  * The index should be between 0 and getCount()-1.
+ * The device is not copied, it lives in the result store of the scan like the devices of begin() and end().
  * @param [in] i The index of the device.
- * @return The device at the specified index.
+ * @return A pointer to the device at the specified index or nullptr if the index is out of range.
  */
-NimBLEAdvertisedDevice NimBLEScanResults::getDevice(uint32_t i) {
-    uint32_t x = 0;
-    NimBLEAdvertisedDevice dev = *m_advertisedDevicesMap.begin()->second;
-    for (auto it = m_advertisedDevicesMap.begin(); it != m_advertisedDevicesMap.end(); it++) {
-        dev = *it->second;
-        if (x==i)   break;
-        x++;
+NimBLEAdvertisedDevice* NimBLEScanResults::getDevice(uint32_t i) {
+    if(i >= m_devices.size()) {
+        return nullptr;
     }
-    return dev;
-}
+    return m_devices[i];
+} // getDevice
+
+
+/**
+ * @brief Get an iterator to the first device pointer, for range based for loops.
+ */
+NimBLEAdvertisedDevice* const* NimBLEScanResults::begin() {
+    return m_devices.data();
+} // begin
+
+
+/**
+ * @brief Get an iterator past the last device pointer.
+ */
+NimBLEAdvertisedDevice* const* NimBLEScanResults::end() {
+    return begin() + getCount();
+} // end
 
 #endif /* CONFIG_BT_ENABLED */
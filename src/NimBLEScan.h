@@ -17,33 +17,82 @@
 #if defined(CONFIG_BT_ENABLED)
 
 #include "NimBLEAdvertisedDevice.h"
+#include "NimBLEScanFilter.h"
+#include "NimBLEScanDedup.h"
+#include "NimBLEScanBatch.h"
+#include "NimBLEScanRing.h"
+#include "NimBLEScanTracker.h"
 #include "FreeRTOS.h"
 
 #include "host/ble_gap.h"
+#include "nimble/nimble_npl.h"
 
-#include <map>
+#include <vector>
+#include <unordered_set>
+
+#if !defined(CONFIG_BT_NIMBLE_MAX_SCAN_RESULTS)
+#define CONFIG_BT_NIMBLE_MAX_SCAN_RESULTS 64
+#endif
+
+/// Number of extended advertising reports that can be reassembled at the same time.
+#define NIMBLE_SCAN_EXT_CHAINS 4
+
+/// Largest capacity of the scan results, the 16 bit result index holds twice as many slots.
+#define NIMBLE_SCAN_MAX_RESULTS_LIMIT 32768
 
 class NimBLEDevice;
 class NimBLEScan;
 class NimBLEAdvertisedDevice;
 class NimBLEAdvertisedDeviceCallbacks;
 
+/**
+ * @brief Which device to replace when a new one is found and the scan results are full.
+ */
+typedef enum {
+    SCAN_EVICT_LRU,             // Replace the device that was seen least recently.
+    SCAN_EVICT_WEAKEST_RSSI,    // Replace the device with the weakest signal.
+    SCAN_EVICT_OLDEST,          // Replace the device that was found first.
+    SCAN_EVICT_NONE,            // Keep the devices already found and ignore the new one.
+} scan_evict_policy;
+
+
+/**
+ * @brief Counters of the scan result store.
+ */
+struct NimBLEScanStats {
+    uint32_t    hits;           // Reports from a device already in the results.
+    uint32_t    misses;         // Reports from a device not in the results.
+    uint32_t    evictions;      // Devices replaced to make room for a new one.
+    uint32_t    rejected;       // New devices ignored because the results were full (SCAN_EVICT_NONE).
+    uint32_t    held;           // Reports skipped because their device was in use by a deferred callback.
+};
+
+
 /**
  * @brief The result of having performed a scan.
  * When a scan completes, we have a set of found devices.  Each device is described
  * by a BLEAdvertisedDevice object.  The number of items in the set is given by
  * getCount().  We can retrieve a device by calling getDevice() passing in the
- * index (starting at 0) of the desired device.
+ * index (starting at 0) of the desired device, or iterate over the device pointers
+ * with begin() and end().
+ *
+ * This is a snapshot of the list of devices found, taken when the results were requested,
+ * the devices themselves stay in the scan result store.  While a scan is running the host
+ * keeps updating them and an evicted device is reused for a new one, so read the devices
+ * after the scan stopped or from the scan complete callback.  The snapshot stays valid
+ * until the results are cleared.
  */
 class NimBLEScanResults {
 public:
     void                dump();
     int                 getCount();
-    NimBLEAdvertisedDevice getDevice(uint32_t i);
+    NimBLEAdvertisedDevice* getDevice(uint32_t i);
+    NimBLEAdvertisedDevice* const* begin();
+    NimBLEAdvertisedDevice* const* end();
 
 private:
     friend NimBLEScan;
-    std::map<std::string, NimBLEAdvertisedDevice*> m_advertisedDevicesMap;
+    std::vector<NimBLEAdvertisedDevice*> m_devices;
 };
 
 /**
@@ -63,13 +112,51 @@ public:
     void                clearResults();
     NimBLEScanResults   getResults();
     void                erase(NimBLEAddress address);
+    bool                addAllowed(NimBLEAddress address, uint8_t type = BLE_ADDR_PUBLIC);
+    bool                removeAllowed(NimBLEAddress address, uint8_t type = BLE_ADDR_PUBLIC);
+    bool                clearAllowed();
+    bool                setMaxResults(uint16_t maxResults, scan_evict_policy policy = SCAN_EVICT_LRU);
+    NimBLEScanStats     getStats();
+    void                resetStats();
+    NimBLEScanFilter*   getFilter();
+    bool                setDuplicateFilter(uint16_t numEntries, uint8_t rssiThreshold = 0, uint32_t refreshMs = 0);
+    NimBLEScanDedupStats getDuplicateFilterStats();
+    bool                setBatchDelivery(uint16_t batchSize, uint32_t maxLatencyMs = 100);
+    const NimBLEScanReport* takeBatch(size_t* count, uint32_t timeoutMs = UINT32_MAX);
+    void                releaseBatch();
+    NimBLEScanBatchStats getBatchStats();
+    bool                setReportStream(uint16_t capacity);
+    NimBLEScanRing*     getReportStream();
+    bool                setPresenceTracking(uint32_t departMs);
+    NimBLEScanTracker*  getTracker();
+    const NimBLEPresence* getPresence(NimBLEAdvertisedDevice* pDevice);
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    bool                setExtendedScan(uint8_t phyMask);
+    void                setPhyScanParams(uint8_t phy, uint16_t intervalMSecs, uint16_t windowMSecs);
+#endif
     
     
 private:
     NimBLEScan();
     friend class NimBLEDevice;
+    friend class NimBLEEventExecutor;
     static int          handleGapEvent(ble_gap_event*  event, void* arg);
+    static void         presenceTimerCb(ble_npl_event* event);
+    int                 handleReport(const ble_gap_disc_desc* disc, size_t length, uint8_t primPhy, uint8_t secPhy, uint8_t sid);
     void                onHostReset();
+    void                allocateResults();
+    uint16_t            payloadSize();
+    void                applyWhiteList();
+    NimBLEAdvertisedDevice* findDevice(uint64_t key);
+    NimBLEAdvertisedDevice* addDevice(const ble_addr_t &addr);
+    void                removeDevice(NimBLEAdvertisedDevice* pDevice);
+    bool                beginUpdate(uint16_t pos);
+    void                endUpdate();
+    NimBLEAdvertisedDevice* holdDevice(uint32_t pos, uint64_t key);
+    void                releaseDevice();
+    void                waitReleased();
+    void                endDeparture(uint32_t pos);
+    uint16_t            indexSlot(uint64_t key);
     
     NimBLEAdvertisedDeviceCallbacks*    m_pAdvertisedDeviceCallbacks = nullptr;
     void                                (*m_scanCompleteCB)(NimBLEScanResults scanResults);
@@ -77,8 +164,57 @@ private:
     uint8_t                             m_own_addr_type;
     bool                                m_stopped;
     bool                                m_wantDuplicates;
-    NimBLEScanResults                   m_scanResults;
+    std::vector<NimBLEAdvertisedDevice*> m_devices;        // The scan results in the order found.
+    portMUX_TYPE                        m_devicesMux = portMUX_INITIALIZER_UNLOCKED;  // Guards m_devices against getResults().
+    std::unordered_set<NimBLEAddress>   m_allowSet;         // Address and address type of the devices wanted.
+    bool                                m_whiteListActive = false;
     FreeRTOS::Semaphore                 m_semaphoreScanEnd = FreeRTOS::Semaphore("ScanEnd");
+
+    // Fixed capacity result store, the devices are preallocated and found through an open addressing
+    // hash table of pool positions + 1 keyed by the packed address and address type.
+    std::vector<NimBLEAdvertisedDevice> m_devicePool;
+    std::vector<uint16_t>               m_freeDevices;
+    std::vector<uint16_t>               m_deviceIndex;
+    uint8_t                             m_deviceIndexBits = 0;
+    uint16_t                            m_maxResults = CONFIG_BT_NIMBLE_MAX_SCAN_RESULTS;
+    uint16_t                            m_payloadSize = 0;   // Payload storage of each device, see payloadSize().
+    scan_evict_policy                   m_evictPolicy = SCAN_EVICT_LRU;
+    NimBLEScanStats                     m_stats = {};
+
+    // A device passed to a callback by the event executor is held, the host task does not
+    // update or reuse it until the callback returns.  Positions + 1, 0 for none.
+    portMUX_TYPE                        m_holdMux = portMUX_INITIALIZER_UNLOCKED;
+    uint16_t                            m_heldPos = 0;
+    uint16_t                            m_updatePos = 0;
+    TaskHandle_t                        m_holder = nullptr;
+    std::vector<uint8_t>                m_departing;        // Removed devices whose onDeparted() is queued.
+    NimBLEScanFilter                    m_filter;
+    NimBLEScanDedup                     m_dedup;
+    NimBLEScanBatch*                    m_pBatch = nullptr;
+    NimBLEScanRing*                     m_pRing = nullptr;
+    NimBLEScanTracker                   m_tracker;
+    ble_npl_callout                     m_presenceTimer;
+    bool                                m_presenceTimerInit = false;
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    // Extended reports being reassembled, one buffer per address and advertising set.
+    struct ExtChain {
+        uint64_t                        key = 0;
+        uint8_t                         sid = 0;
+        bool                            active = false;
+        size_t                          length = 0;
+        uint32_t                        started = 0;
+        std::vector<uint8_t>            data;
+    };
+
+    int                                 handleExtReport(const ble_gap_ext_disc_desc* ext);
+    ExtChain*                           findChain(uint64_t key, uint8_t sid);
+    ExtChain*                           startChain(uint64_t key, uint8_t sid);
+
+    std::vector<ExtChain>               m_extChains;
+    uint8_t                             m_extPhys = 0;
+    ble_gap_ext_disc_params             m_extParams[2] = {};   // Uncoded and coded PHY.
+#endif
 };
 
 
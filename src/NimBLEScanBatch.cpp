@@ -0,0 +1,227 @@
+/*
+ * NimBLEScanBatch.cpp
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEScanBatch.h"
+#include "FreeRTOS.h"
+
+#include <string.h>
+
+
+/**
+ * @brief Copy an advertising report.
+ * @param [in] disc The report received from the host.
+ * @param [in] time The time the report was received in milliseconds since boot.
+ */
+void NimBLEScanReport::set(const struct ble_gap_disc_desc* disc, uint32_t time) {
+    memcpy(addr, disc->addr.val, sizeof(addr));
+    addrType = disc->addr.type;
+    advType = disc->event_type;
+    rssi = disc->rssi;
+    length = disc->length_data < BLE_HS_ADV_MAX_SZ ? disc->length_data : BLE_HS_ADV_MAX_SZ;
+    totalLength = disc->length_data;
+    timestamp = time;
+    memcpy(data, disc->data, length);
+} // set
+
+
+/**
+ * @brief Constructor.
+ * @param [in] batchSize The maximum number of reports in a batch.
+ * @param [in] maxLatencyMs The maximum age of the first report of a batch before it is delivered.
+ */
+NimBLEScanBatch::NimBLEScanBatch(uint16_t batchSize, uint32_t maxLatencyMs) {
+    m_batchSize = batchSize > 0 ? batchSize : 1;
+    m_maxLatencyMs = maxLatencyMs;
+    m_buffers[0].resize(m_batchSize);
+    m_buffers[1].resize(m_batchSize);
+    m_batchReady = xSemaphoreCreateBinary();
+} // NimBLEScanBatch
+
+
+/**
+ * @brief Destructor.
+ */
+NimBLEScanBatch::~NimBLEScanBatch() {
+    vSemaphoreDelete(m_batchReady);
+} // ~NimBLEScanBatch
+
+
+/**
+ * @brief Copy a report into the active buffer, called from the host task.
+ * @param [in] disc The report received from the host.
+ */
+void NimBLEScanBatch::push(const struct ble_gap_disc_desc* disc) {
+    uint32_t now = FreeRTOS::getTimeSinceStart();
+    bool signal = false;
+
+    portENTER_CRITICAL(&m_mux);
+
+    if(m_count == m_batchSize) {
+        // The active buffer is full and the application still has the other one.
+        m_stats.dropped++;
+        portEXIT_CRITICAL(&m_mux);
+        return;
+    }
+
+    if(m_count == 0) {
+        m_firstTime = now;
+    }
+
+    m_buffers[m_active][m_count++].set(disc, now);
+
+    if(m_count == m_batchSize || isOverdue(now)) {
+        signal = swap();
+    }
+
+    portEXIT_CRITICAL(&m_mux);
+
+    if(signal) {
+        xSemaphoreGive(m_batchReady);
+    }
+} // push
+
+
+/**
+ * @brief Wait for a batch, called from the application task.
+ *
+ * The previous batch is released if the application did not call release().
+ *
+ * @param [out] count The number of reports in the batch.
+ * @param [in] timeoutMs How long to wait for a batch, UINT32_MAX to wait forever.
+ * @return A pointer to the reports, valid until release() or the next take(), or nullptr on timeout.
+ */
+const NimBLEScanReport* NimBLEScanBatch::take(size_t* count, uint32_t timeoutMs) {
+    uint32_t start = FreeRTOS::getTimeSinceStart();
+
+    release();
+
+    for(;;) {
+        uint32_t now = FreeRTOS::getTimeSinceStart();
+        TickType_t wait;
+
+        portENTER_CRITICAL(&m_mux);
+
+        // Deliver a partial batch once its first report is too old.
+        if(!m_ready && isOverdue(now)) {
+            swap();
+        }
+
+        if(m_ready) {
+            m_ready = false;
+            m_held = true;
+            *count = m_readyCount;
+
+            uint32_t latency = now - m_readyTime;
+            m_totalLatencyMs += latency;
+            if(latency > m_stats.maxLatencyMs) {
+                m_stats.maxLatencyMs = latency;
+            }
+
+            const NimBLEScanReport* reports = m_buffers[m_active ^ 1].data();
+            portEXIT_CRITICAL(&m_mux);
+            return reports;
+        }
+
+        uint32_t elapsed = now - start;
+        if(timeoutMs != UINT32_MAX && elapsed >= timeoutMs) {
+            portEXIT_CRITICAL(&m_mux);
+            *count = 0;
+            return nullptr;
+        }
+
+        // Wake up in time to flush the partial batch.
+        uint32_t waitMs = UINT32_MAX;
+        if(timeoutMs != UINT32_MAX) {
+            waitMs = timeoutMs - elapsed;
+        }
+        if(m_count > 0) {
+            uint32_t due = m_maxLatencyMs - (now - m_firstTime);
+            if(due < waitMs) {
+                waitMs = due;
+            }
+        }
+
+        portEXIT_CRITICAL(&m_mux);
+
+        wait = (waitMs == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(waitMs) + 1;
+        xSemaphoreTake(m_batchReady, wait);
+    }
+} // take
+
+
+/**
+ * @brief Give the batch returned by take() back to the host task.
+ */
+void NimBLEScanBatch::release() {
+    bool signal = false;
+    uint32_t now = FreeRTOS::getTimeSinceStart();
+
+    portENTER_CRITICAL(&m_mux);
+    if(m_held) {
+        m_held = false;
+        if(m_count == m_batchSize || isOverdue(now)) {
+            signal = swap();
+        }
+    }
+    portEXIT_CRITICAL(&m_mux);
+
+    if(signal) {
+        xSemaphoreGive(m_batchReady);
+    }
+} // release
+
+
+/**
+ * @brief Get the delivery counters.
+ * @return A copy of the counters with the averages.
+ */
+NimBLEScanBatchStats NimBLEScanBatch::getStats() {
+    portENTER_CRITICAL(&m_mux);
+    NimBLEScanBatchStats stats = m_stats;
+    uint64_t totalLatencyMs = m_totalLatencyMs;
+    portEXIT_CRITICAL(&m_mux);
+
+    if(stats.batches > 0) {
+        stats.avgBatchSize = (float)stats.reports / stats.batches;
+        stats.avgLatencyMs = (float)totalLatencyMs / stats.batches;
+    }
+    return stats;
+} // getStats
+
+
+/**
+ * @brief Check if the reports in the active buffer waited long enough, called in a critical section.
+ */
+bool NimBLEScanBatch::isOverdue(uint32_t now) {
+    return m_count > 0 && now - m_firstTime >= m_maxLatencyMs;
+} // isOverdue
+
+
+/**
+ * @brief Make the active buffer the ready batch if the other buffer is free, called in a critical section.
+ * @return True if a batch became ready.
+ */
+bool NimBLEScanBatch::swap() {
+    if(m_ready || m_held || m_count == 0) {
+        return false;
+    }
+
+    m_ready = true;
+    m_readyCount = m_count;
+    m_readyTime = m_firstTime;
+    m_active ^= 1;
+    m_count = 0;
+
+    m_stats.batches++;
+    m_stats.reports += m_readyCount;
+    return true;
+} // swap
+
+#endif // CONFIG_BT_ENABLED
@@ -0,0 +1,94 @@
+/*
+ * NimBLEScanBatch.h
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef COMPONENTS_NIMBLESCANBATCH_H_
+#define COMPONENTS_NIMBLESCANBATCH_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "nimble/hci_common.h"
+#include "host/ble_gap.h"
+#include "host/ble_hs_adv.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include <vector>
+
+
+/**
+ * @brief A compact copy of an advertising report.
+ * Only the first BLE_HS_ADV_MAX_SZ bytes of a reassembled extended advertisement are kept,
+ * totalLength gives its full length.
+ */
+struct NimBLEScanReport {
+    uint8_t     addr[6];                    // Native (little endian) address.
+    uint8_t     addrType;
+    uint8_t     advType;                    // BLE_HCI_ADV_RPT_EVTYPE_*.
+    int8_t      rssi;
+    uint8_t     length;                     // Length of data.
+    uint16_t    totalLength;                // Length of the advertisement, more than length when truncated.
+    uint32_t    timestamp;                  // Milliseconds since boot when the report was received.
+    uint8_t     data[BLE_HS_ADV_MAX_SZ];    // Raw advertisement or scan response data.
+
+    void        set(const struct ble_gap_disc_desc* disc, uint32_t time);
+};
+
+
+/**
+ * @brief Counters of the batched scan delivery.
+ */
+struct NimBLEScanBatchStats {
+    uint32_t    batches;        // Batches handed to the application.
+    uint32_t    reports;        // Reports in those batches.
+    uint32_t    dropped;        // Reports lost because both buffers were in use.
+    float       avgBatchSize;
+    uint32_t    maxLatencyMs;   // Longest time from the first report of a batch to its delivery.
+    float       avgLatencyMs;
+};
+
+
+/**
+ * @brief Accumulates advertising reports and hands them to an application task in batches.
+ *
+ * Two preallocated buffers are used, the host task fills one while the application holds the other.
+ * A batch is ready when it has batchSize reports or its first report is maxLatencyMs old.
+ * The application task calls take() to wait for a batch and release() when it is done with it.
+ */
+class NimBLEScanBatch {
+public:
+    NimBLEScanBatch(uint16_t batchSize, uint32_t maxLatencyMs);
+    ~NimBLEScanBatch();
+
+    void                    push(const struct ble_gap_disc_desc* disc);
+    const NimBLEScanReport* take(size_t* count, uint32_t timeoutMs);
+    void                    release();
+    NimBLEScanBatchStats    getStats();
+
+private:
+    bool                    swap();
+    bool                    isOverdue(uint32_t now);
+
+    std::vector<NimBLEScanReport> m_buffers[2];
+    uint8_t                 m_active = 0;       // Buffer filled by the host task.
+    uint16_t                m_count = 0;        // Reports in the active buffer.
+    uint32_t                m_firstTime = 0;    // Time of the first report in the active buffer.
+    bool                    m_ready = false;    // The other buffer holds a batch waiting for take().
+    bool                    m_held = false;     // The other buffer is held by the application.
+    uint16_t                m_readyCount = 0;
+    uint32_t                m_readyTime = 0;
+    uint16_t                m_batchSize;
+    uint32_t                m_maxLatencyMs;
+    uint64_t                m_totalLatencyMs = 0;
+    portMUX_TYPE            m_mux = portMUX_INITIALIZER_UNLOCKED;
+    SemaphoreHandle_t       m_batchReady = nullptr;
+    NimBLEScanBatchStats    m_stats = {};
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // COMPONENTS_NIMBLESCANBATCH_H_
@@ -0,0 +1,157 @@
+/*
+ * NimBLEScanDedup.cpp
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEScanDedup.h"
+#include "FreeRTOS.h"
+
+#include <stdlib.h>
+
+/// Number of consecutive slots searched for a device before replacing one.
+#define NIMBLE_SCAN_DEDUP_PROBES    4
+
+
+/**
+ * @brief FNV-1a hash of a payload.
+ */
+static uint32_t payloadHash(const uint8_t* data, size_t length) {
+    uint32_t hash = 2166136261UL;
+    for(size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619UL;
+    }
+    return hash;
+} // payloadHash
+
+
+/**
+ * @brief Set the size of the table and when an unchanged report is forwarded anyway.
+ * @param [in] numEntries The number of devices tracked, rounded up to a power of 2, 0 disables the filter.
+ * @param [in] rssiThreshold Forward a report when the RSSI moved by at least this many dBm, 0 to ignore the RSSI.
+ * @param [in] refreshMs Forward a report of a device after this many milliseconds, 0 to only forward changes.
+ */
+void NimBLEScanDedup::configure(uint16_t numEntries, uint8_t rssiThreshold, uint32_t refreshMs) {
+    uint32_t size = 0;
+    if(numEntries > 0) {
+        size = NIMBLE_SCAN_DEDUP_PROBES;
+        while(size < numEntries) {
+            size <<= 1;
+        }
+    }
+
+    std::vector<Entry>(size).swap(m_entries);
+    m_rssiThreshold = rssiThreshold;
+    m_refreshMs = refreshMs;
+    clear();
+} // configure
+
+
+/**
+ * @brief Check if the filter is configured.
+ * @return True if the filter has a table.
+ */
+bool NimBLEScanDedup::isEnabled() {
+    return !m_entries.empty();
+} // isEnabled
+
+
+/**
+ * @brief Decide if a report should be forwarded and remember it if so.
+ * @param [in] disc The report received from the host.
+ * @param [in] length The length of the data of the report, more than length_data for a reassembled extended report.
+ * @param [in] isKnown True if the device is in the scan results, a report of an unknown device is always forwarded.
+ * @return True if the report should be forwarded.
+ */
+bool NimBLEScanDedup::shouldForward(const struct ble_gap_disc_desc* disc, size_t length, bool isKnown) {
+    uint64_t key = 0;
+    for(int i = 5; i >= 0; i--) {
+        key = (key << 8) | disc->addr.val[i];
+    }
+    key |= ((uint64_t)disc->addr.type << 48) | (1ULL << 56);
+    if(disc->event_type == BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP) {
+        key |= 1ULL << 57;
+    }
+
+    uint32_t hash = payloadHash(disc->data, length);
+    uint32_t now = FreeRTOS::getTimeSinceStart();
+    uint32_t mask = m_entries.size() - 1;
+    uint32_t slot = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+
+    m_stats.received++;
+
+    // Look for the device in its probe window, remembering the slot to use if it is not there.
+    Entry* pEntry = nullptr;
+    Entry* pVictim = nullptr;
+    for(uint32_t i = 0; i < NIMBLE_SCAN_DEDUP_PROBES; i++) {
+        Entry* pCandidate = &m_entries[(slot + i) & mask];
+        if(pCandidate->key == key) {
+            pEntry = pCandidate;
+            break;
+        }
+        // Prefer an unused slot, else the one forwarded least recently.
+        if(pVictim == nullptr || (pVictim->key != 0 && (pCandidate->key == 0 ||
+           now - pCandidate->lastForward > now - pVictim->lastForward)))
+        {
+            pVictim = pCandidate;
+        }
+    }
+
+    if(pEntry != nullptr && isKnown &&
+       pEntry->payloadHash == hash &&
+       (m_rssiThreshold == 0 || abs(disc->rssi - pEntry->rssi) < m_rssiThreshold) &&
+       (m_refreshMs == 0 || now - pEntry->lastForward < m_refreshMs))
+    {
+        m_stats.suppressed++;
+        return false;
+    }
+
+    if(pEntry == nullptr) {
+        if(pVictim->key != 0) {
+            m_stats.replaced++;
+        }
+        pEntry = pVictim;
+        pEntry->key = key;
+    }
+
+    pEntry->payloadHash = hash;
+    pEntry->rssi = disc->rssi;
+    pEntry->lastForward = now;
+    m_stats.forwarded++;
+    return true;
+} // shouldForward
+
+
+/**
+ * @brief Forget every device so their next reports are forwarded.
+ */
+void NimBLEScanDedup::clear() {
+    for(auto &entry : m_entries) {
+        entry.key = 0;
+    }
+} // clear
+
+
+/**
+ * @brief Get the filter counters.
+ * @return A copy of the counters with the suppression ratio.
+ */
+NimBLEScanDedupStats NimBLEScanDedup::getStats() {
+    NimBLEScanDedupStats stats = m_stats;
+    stats.suppressedRatio = stats.received > 0 ? (float)stats.suppressed / stats.received : 0;
+    return stats;
+} // getStats
+
+
+/**
+ * @brief Reset the filter counters.
+ */
+void NimBLEScanDedup::resetStats() {
+    m_stats = {};
+} // resetStats
+
+#endif // CONFIG_BT_ENABLED
@@ -0,0 +1,64 @@
+/*
+ * NimBLEScanDedup.h
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef COMPONENTS_NIMBLESCANDEDUP_H_
+#define COMPONENTS_NIMBLESCANDEDUP_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "host/ble_gap.h"
+
+#include <vector>
+
+
+/**
+ * @brief Counters of the host duplicate filter.
+ */
+struct NimBLEScanDedupStats {
+    uint32_t    received;       // Reports checked by the filter.
+    uint32_t    forwarded;      // Reports passed on to the scan results.
+    uint32_t    suppressed;     // Reports dropped as unchanged.
+    uint32_t    replaced;       // Devices forgotten to make room for another one in the table.
+    float       suppressedRatio;// suppressed / received.
+};
+
+
+/**
+ * @brief A host side duplicate filter for scans with the controller duplicate filter disabled.
+ *
+ * The filter remembers a hash of the last forwarded payload and the RSSI of each device in a
+ * fixed size table and only forwards a report when the payload changed, the RSSI moved by at
+ * least the threshold or the refresh interval elapsed.  Advertisements and scan responses are
+ * tracked separately.  When the table is full the entry forwarded least recently is replaced,
+ * so a forgotten device is forwarded again on its next report.
+ */
+class NimBLEScanDedup {
+public:
+    void                    configure(uint16_t numEntries, uint8_t rssiThreshold, uint32_t refreshMs);
+    bool                    isEnabled();
+    bool                    shouldForward(const struct ble_gap_disc_desc* disc, size_t length, bool isKnown);
+    void                    clear();
+    NimBLEScanDedupStats    getStats();
+    void                    resetStats();
+
+private:
+    struct Entry {
+        uint64_t            key;            // Address, address type and report kind, 0 when unused.
+        uint32_t            payloadHash;
+        uint32_t            lastForward;    // Milliseconds since boot.
+        int8_t              rssi;
+    };
+
+    std::vector<Entry>      m_entries;
+    uint8_t                 m_rssiThreshold = 0;
+    uint32_t                m_refreshMs = 0;
+    NimBLEScanDedupStats    m_stats = {};
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // COMPONENTS_NIMBLESCANDEDUP_H_
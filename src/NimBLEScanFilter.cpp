@@ -0,0 +1,330 @@
+/*
+ * NimBLEScanFilter.cpp
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEScanFilter.h"
+#include "NimBLEUtils.h"
+
+#include "host/ble_hs_adv.h"
+
+#include <algorithm>
+
+
+/**
+ * @brief Compare a UUID with one in little endian advertising format.
+ * @param [in] uuid The UUID to compare.
+ * @param [in] data The advertised UUID.
+ * @param [in] size The size of the advertised UUID in bytes.
+ * @return True if they are the same UUID of the same size.
+ */
+static bool uuidMatches(NimBLEUUID &uuid, const uint8_t* data, uint8_t size) {
+    if(uuid.bitSize() != size * 8) {
+        return false;
+    }
+
+    ble_uuid_any_t* native = uuid.getNative();
+    switch(size) {
+        case 2:
+            return native->u16.value == (uint16_t)(data[0] | (data[1] << 8));
+        case 4:
+            return native->u32.value == (uint32_t)(data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24));
+        default:
+            return memcmp(native->u128.value, data, 16) == 0;
+    }
+} // uuidMatches
+
+
+/**
+ * @brief Reject reports with a signal weaker than this value.
+ * @param [in] rssi The minimum RSSI in dBm.
+ */
+void NimBLEScanFilter::setMinRSSI(int8_t rssi) {
+    m_minRSSI = rssi;
+    m_haveMinRSSI = true;
+} // setMinRSSI
+
+
+/**
+ * @brief Only accept reports from these address types.
+ * @param [in] typeMask A bit for each accepted type, e.g. (1 << BLE_ADDR_PUBLIC) | (1 << BLE_ADDR_RANDOM).
+ */
+void NimBLEScanFilter::setAddressTypes(uint8_t typeMask) {
+    m_addressTypes = typeMask;
+} // setAddressTypes
+
+
+/**
+ * @brief Add an inclusive range of addresses to accept or reject.
+ * When allowed ranges are set a report must be in one of them, a report in a denied range is always rejected.
+ * @param [in] low The first address of the range.
+ * @param [in] high The last address of the range.
+ * @param [in] deny True to reject the addresses in the range instead of accepting them.
+ */
+void NimBLEScanFilter::addAddressRange(NimBLEAddress low, NimBLEAddress high, bool deny) {
+    uint64_t lowValue = (uint64_t)low;
+    uint64_t highValue = (uint64_t)high;
+    if(lowValue > highValue) {
+        std::swap(lowValue, highValue);
+    }
+    m_addressRanges.push_back({lowValue, highValue, deny});
+} // addAddressRange
+
+
+/**
+ * @brief Only accept reports advertising one of the added service UUIDs.
+ * @param [in] uuid The service UUID, it is compared with the advertised UUIDs of the same size.
+ */
+void NimBLEScanFilter::addServiceUUID(const NimBLEUUID &uuid) {
+    m_serviceUUIDs.push_back(uuid);
+} // addServiceUUID
+
+
+/**
+ * @brief Only accept reports with manufacturer data matching one of the added patterns.
+ * @param [in] companyId The company identifier at the start of the manufacturer data.
+ * @param [in] data The bytes expected after the company identifier, or nullptr to only match the company.
+ * @param [in] mask The bits of data to compare, or nullptr to compare all of them.
+ * @param [in] length The length of data and mask.
+ */
+void NimBLEScanFilter::addManufacturerData(uint16_t companyId, const uint8_t* data,
+                                           const uint8_t* mask, size_t length)
+{
+    ManufacturerData entry;
+    entry.companyId = companyId;
+    if(data != nullptr && length > 0) {
+        entry.data.assign((const char*)data, length);
+        if(mask != nullptr) {
+            entry.mask.assign((const char*)mask, length);
+        } else {
+            entry.mask.assign(length, (char)0xFF);
+        }
+    }
+    m_manufacturerData.push_back(entry);
+} // addManufacturerData
+
+
+/**
+ * @brief Only accept reports with a complete or shortened name starting with this prefix.
+ * Devices often only send their name in the scan response, which needs an active scan.
+ * @param [in] prefix The name prefix, an empty string removes the condition.
+ */
+void NimBLEScanFilter::setNamePrefix(const std::string &prefix) {
+    m_namePrefix = prefix;
+} // setNamePrefix
+
+
+/**
+ * @brief Remove all the conditions, every report is accepted.
+ */
+void NimBLEScanFilter::clear() {
+    m_haveMinRSSI = false;
+    m_addressTypes = NIMBLE_SCAN_FILTER_ALL_ADDR_TYPES;
+    m_addressRanges.clear();
+    m_serviceUUIDs.clear();
+    m_manufacturerData.clear();
+    m_namePrefix.clear();
+} // clear
+
+
+/**
+ * @brief Check if any condition is set.
+ * @return True if every report is accepted.
+ */
+bool NimBLEScanFilter::isEmpty() {
+    return !m_haveMinRSSI && m_addressTypes == NIMBLE_SCAN_FILTER_ALL_ADDR_TYPES &&
+           m_addressRanges.empty() && m_serviceUUIDs.empty() &&
+           m_manufacturerData.empty() && m_namePrefix.empty();
+} // isEmpty
+
+
+/**
+ * @brief Evaluate the conditions on an advertising report, the cheapest ones first.
+ * Only the data of this report is looked at, see the class description.
+ * @param [in] disc The report received from the host.
+ * @param [in] length The length of the data of the report, more than length_data for a reassembled extended report.
+ * @return True if the report is accepted.
+ */
+bool NimBLEScanFilter::matches(const struct ble_gap_disc_desc* disc, size_t length) {
+    if(m_haveMinRSSI && disc->rssi < m_minRSSI) {
+        m_stats.rssi++;
+        return false;
+    }
+
+    if(disc->addr.type > BLE_ADDR_RANDOM_ID || !(m_addressTypes & (1 << disc->addr.type))) {
+        m_stats.addressType++;
+        return false;
+    }
+
+    if(!m_addressRanges.empty() && !matchesAddress(disc->addr)) {
+        m_stats.addressRange++;
+        return false;
+    }
+
+    if(!m_serviceUUIDs.empty() && !matchesServiceUUID(disc->data, length)) {
+        m_stats.serviceUUID++;
+        return false;
+    }
+
+    if(!m_manufacturerData.empty() && !matchesManufacturerData(disc->data, length)) {
+        m_stats.manufacturerData++;
+        return false;
+    }
+
+    if(!m_namePrefix.empty() && !matchesName(disc->data, length)) {
+        m_stats.name++;
+        return false;
+    }
+
+    m_stats.passed++;
+    return true;
+} // matches
+
+
+/**
+ * @brief Get the filter counters.
+ * @return A copy of the counters.
+ */
+NimBLEScanFilterStats NimBLEScanFilter::getStats() {
+    return m_stats;
+} // getStats
+
+
+/**
+ * @brief Reset the filter counters.
+ */
+void NimBLEScanFilter::resetStats() {
+    m_stats = {};
+} // resetStats
+
+
+/**
+ * @brief Check an address against the allowed and denied ranges.
+ */
+bool NimBLEScanFilter::matchesAddress(const ble_addr_t &addr) {
+    uint64_t value = (uint64_t)NimBLEAddress(addr);
+    bool haveAllowed = false;
+    bool allowed = false;
+
+    for(auto &range : m_addressRanges) {
+        bool inRange = value >= range.low && value <= range.high;
+        if(range.deny) {
+            if(inRange) {
+                return false;
+            }
+        } else {
+            haveAllowed = true;
+            allowed = allowed || inRange;
+        }
+    }
+
+    return !haveAllowed || allowed;
+} // matchesAddress
+
+
+/**
+ * @brief Check if the payload advertises one of the service UUIDs.
+ */
+bool NimBLEScanFilter::matchesServiceUUID(const uint8_t* payload, size_t length) {
+    size_t pos = 0;
+    uint8_t type;
+    uint8_t fieldLength;
+    const uint8_t* field;
+
+    while((field = NimBLEUtils::nextAdvField(payload, length, &pos, &type, &fieldLength)) != nullptr) {
+        uint8_t size;
+        switch(type) {
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS16:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS16:
+            case BLE_HS_ADV_TYPE_SVC_DATA_UUID16:
+                size = 2;
+                break;
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS32:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS32:
+            case BLE_HS_ADV_TYPE_SVC_DATA_UUID32:
+                size = 4;
+                break;
+            case BLE_HS_ADV_TYPE_INCOMP_UUIDS128:
+            case BLE_HS_ADV_TYPE_COMP_UUIDS128:
+            case BLE_HS_ADV_TYPE_SVC_DATA_UUID128:
+                size = 16;
+                break;
+            default:
+                continue;
+        }
+
+        // Service data only carries one UUID, at the start of the field.
+        bool isServiceData = type == BLE_HS_ADV_TYPE_SVC_DATA_UUID16 ||
+                             type == BLE_HS_ADV_TYPE_SVC_DATA_UUID32 ||
+                             type == BLE_HS_ADV_TYPE_SVC_DATA_UUID128;
+        uint8_t count = isServiceData ? (fieldLength >= size) : fieldLength / size;
+
+        for(uint8_t i = 0; i < count; i++) {
+            for(auto &uuid : m_serviceUUIDs) {
+                if(uuidMatches(uuid, field + i * size, size)) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+} // matchesServiceUUID
+
+
+/**
+ * @brief Check if the payload has manufacturer data matching one of the patterns.
+ */
+bool NimBLEScanFilter::matchesManufacturerData(const uint8_t* payload, size_t length) {
+    uint8_t fieldLength;
+    const uint8_t* field = NimBLEUtils::findAdvField(payload, length, BLE_HS_ADV_TYPE_MFG_DATA, &fieldLength);
+    if(field == nullptr || fieldLength < 2) {
+        return false;
+    }
+
+    uint16_t companyId = field[0] | (field[1] << 8);
+    for(auto &entry : m_manufacturerData) {
+        if(entry.companyId != companyId || fieldLength - 2 < entry.data.length()) {
+            continue;
+        }
+
+        size_t i = 0;
+        for(; i < entry.data.length(); i++) {
+            uint8_t mask = entry.mask[i];
+            if((field[2 + i] & mask) != ((uint8_t)entry.data[i] & mask)) {
+                break;
+            }
+        }
+
+        if(i == entry.data.length()) {
+            return true;
+        }
+    }
+
+    return false;
+} // matchesManufacturerData
+
+
+/**
+ * @brief Check if the payload has a name starting with the prefix.
+ */
+bool NimBLEScanFilter::matchesName(const uint8_t* payload, size_t length) {
+    uint8_t fieldLength;
+    const uint8_t* field = NimBLEUtils::findAdvField(payload, length, BLE_HS_ADV_TYPE_COMP_NAME, &fieldLength);
+    if(field == nullptr) {
+        field = NimBLEUtils::findAdvField(payload, length, BLE_HS_ADV_TYPE_INCOMP_NAME, &fieldLength);
+    }
+
+    if(field == nullptr || fieldLength < m_namePrefix.length()) {
+        return false;
+    }
+
+    return memcmp(field, m_namePrefix.data(), m_namePrefix.length()) == 0;
+} // matchesName
+
+#endif // CONFIG_BT_ENABLED
@@ -0,0 +1,100 @@
+/*
+ * NimBLEScanFilter.h
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef COMPONENTS_NIMBLESCANFILTER_H_
+#define COMPONENTS_NIMBLESCANFILTER_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEAddress.h"
+#include "NimBLEUUID.h"
+
+#include "host/ble_gap.h"
+
+#include <string>
+#include <vector>
+
+/// Address type mask accepting every address type.
+#define NIMBLE_SCAN_FILTER_ALL_ADDR_TYPES   0x0F
+
+
+/**
+ * @brief Counters of the scan filter, each report is counted once by the first filter that rejects it.
+ */
+struct NimBLEScanFilterStats {
+    uint32_t    passed;             // Reports accepted by all the filters.
+    uint32_t    rssi;               // Reports below the minimum RSSI.
+    uint32_t    addressType;        // Reports from an address type that is not allowed.
+    uint32_t    addressRange;       // Reports from an address outside the allowed ranges or in a denied one.
+    uint32_t    serviceUUID;        // Reports without any of the service UUIDs.
+    uint32_t    manufacturerData;   // Reports without matching manufacturer data.
+    uint32_t    name;               // Reports without a name starting with the prefix.
+};
+
+
+/**
+ * @brief A set of conditions evaluated on the raw advertising reports before any scan result is created.
+ *
+ * A report is accepted when it meets every condition that is set.  Within the service UUID,
+ * manufacturer data and allowed address range lists a single match is enough.
+ * The filters should only be changed while not scanning.
+ *
+ * Each report is evaluated on its own data, the advertisement and the scan response of a device
+ * are never combined.  A device is added to the results by the first report that passes, a scan
+ * response of a device already in the results is always accepted.  A condition on a field only
+ * sent in the scan response, often the name, is therefore met by the scan response alone and the
+ * device is stored without its advertisement data until the next advertisement passes too.  A
+ * device whose matching fields are split between the advertisement and the scan response never
+ * meets conditions on both at once.
+ */
+class NimBLEScanFilter {
+public:
+    void                    setMinRSSI(int8_t rssi);
+    void                    setAddressTypes(uint8_t typeMask);
+    void                    addAddressRange(NimBLEAddress low, NimBLEAddress high, bool deny = false);
+    void                    addServiceUUID(const NimBLEUUID &uuid);
+    void                    addManufacturerData(uint16_t companyId, const uint8_t* data = nullptr,
+                                                const uint8_t* mask = nullptr, size_t length = 0);
+    void                    setNamePrefix(const std::string &prefix);
+    void                    clear();
+    bool                    isEmpty();
+
+    bool                    matches(const struct ble_gap_disc_desc* disc, size_t length);
+    NimBLEScanFilterStats   getStats();
+    void                    resetStats();
+
+private:
+    struct AddressRange {
+        uint64_t            low;
+        uint64_t            high;
+        bool                deny;
+    };
+
+    struct ManufacturerData {
+        uint16_t            companyId;
+        std::string         data;
+        std::string         mask;
+    };
+
+    bool                    matchesAddress(const ble_addr_t &addr);
+    bool                    matchesServiceUUID(const uint8_t* payload, size_t length);
+    bool                    matchesManufacturerData(const uint8_t* payload, size_t length);
+    bool                    matchesName(const uint8_t* payload, size_t length);
+
+    bool                            m_haveMinRSSI = false;
+    int8_t                          m_minRSSI = 0;
+    uint8_t                         m_addressTypes = NIMBLE_SCAN_FILTER_ALL_ADDR_TYPES;
+    std::vector<AddressRange>       m_addressRanges;
+    std::vector<NimBLEUUID>         m_serviceUUIDs;
+    std::vector<ManufacturerData>   m_manufacturerData;
+    std::string                     m_namePrefix;
+    NimBLEScanFilterStats           m_stats = {};
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // COMPONENTS_NIMBLESCANFILTER_H_
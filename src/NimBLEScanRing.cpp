@@ -0,0 +1,144 @@
+/*
+ * NimBLEScanRing.cpp
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEScanRing.h"
+#include "FreeRTOS.h"
+
+
+/**
+ * @brief Constructor.
+ * @param [in] capacity The number of records, rounded up to a power of 2.
+ */
+NimBLEScanRing::NimBLEScanRing(uint16_t capacity) {
+    uint32_t size = 2;
+    while(size < capacity) {
+        size <<= 1;
+    }
+    m_records.resize(size);
+    m_mask = size - 1;
+} // NimBLEScanRing
+
+
+/**
+ * @brief Copy a report into the ring, called from the host task only.
+ * @param [in] disc The report received from the host.
+ * @return False if the ring was full and the report was dropped.
+ */
+bool NimBLEScanRing::push(const struct ble_gap_disc_desc* disc) {
+    uint32_t head = m_head.load(std::memory_order_relaxed);
+    uint32_t tail = m_tail.load(std::memory_order_acquire);
+    uint32_t depth = head - tail;
+
+    if(depth > m_mask) {
+        m_overflows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_records[head & m_mask].set(disc, FreeRTOS::getTimeSinceStart());
+    m_head.store(head + 1, std::memory_order_release);
+
+    if(depth + 1 > m_highWater.load(std::memory_order_relaxed)) {
+        m_highWater.store(depth + 1, std::memory_order_relaxed);
+    }
+
+    TaskHandle_t consumer = m_consumer.exchange(nullptr, std::memory_order_acq_rel);
+    if(consumer != nullptr) {
+        xTaskNotifyGive(consumer);
+    }
+
+    return true;
+} // push
+
+
+/**
+ * @brief Copy the oldest report out of the ring, called from the consumer task only.
+ * @param [out] report The report read.
+ * @return False if the ring is empty.
+ */
+bool NimBLEScanRing::pop(NimBLEScanReport* report) {
+    const NimBLEScanReport* pRecord = peek();
+    if(pRecord == nullptr) {
+        return false;
+    }
+
+    *report = *pRecord;
+    consume();
+    return true;
+} // pop
+
+
+/**
+ * @brief Get the oldest report without copying it, called from the consumer task only.
+ * @return A pointer to the record, valid until consume(), or nullptr if the ring is empty.
+ */
+const NimBLEScanReport* NimBLEScanRing::peek() {
+    uint32_t tail = m_tail.load(std::memory_order_relaxed);
+    if(m_head.load(std::memory_order_acquire) == tail) {
+        return nullptr;
+    }
+    return &m_records[tail & m_mask];
+} // peek
+
+
+/**
+ * @brief Release the record returned by peek() to the producer.
+ */
+void NimBLEScanRing::consume() {
+    uint32_t tail = m_tail.load(std::memory_order_relaxed);
+    if(m_head.load(std::memory_order_acquire) != tail) {
+        m_tail.store(tail + 1, std::memory_order_release);
+    }
+} // consume
+
+
+/**
+ * @brief Block the consumer task until a report is available.
+ * @param [in] timeoutMs How long to wait in milliseconds, UINT32_MAX to wait forever.
+ * @return True if a report is available.
+ */
+bool NimBLEScanRing::wait(uint32_t timeoutMs) {
+    if(available() > 0) {
+        return true;
+    }
+
+    // Register before checking again so a report pushed in between still wakes us up.
+    m_consumer.store(xTaskGetCurrentTaskHandle(), std::memory_order_release);
+    if(available() == 0) {
+        ulTaskNotifyTake(pdTRUE, timeoutMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs));
+    }
+    m_consumer.store(nullptr, std::memory_order_release);
+
+    return available() > 0;
+} // wait
+
+
+/**
+ * @brief Get the number of reports waiting to be read.
+ */
+size_t NimBLEScanRing::available() {
+    return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+} // available
+
+
+/**
+ * @brief Get the ring counters.
+ * @return A copy of the counters.
+ */
+NimBLEScanRingStats NimBLEScanRing::getStats() {
+    NimBLEScanRingStats stats;
+    stats.capacity = m_records.size();
+    stats.depth = available();
+    stats.highWater = m_highWater.load(std::memory_order_relaxed);
+    stats.written = m_head.load(std::memory_order_relaxed);
+    stats.overflows = m_overflows.load(std::memory_order_relaxed);
+    return stats;
+} // getStats
+
+#endif // CONFIG_BT_ENABLED
@@ -0,0 +1,65 @@
+/*
+ * NimBLEScanRing.h
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef COMPONENTS_NIMBLESCANRING_H_
+#define COMPONENTS_NIMBLESCANRING_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEScanBatch.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <atomic>
+#include <vector>
+
+
+/**
+ * @brief Counters of the scan report stream.
+ */
+struct NimBLEScanRingStats {
+    uint32_t    capacity;
+    uint32_t    depth;          // Reports waiting to be read.
+    uint32_t    highWater;      // Largest depth seen.
+    uint32_t    written;        // Reports written by the host task.
+    uint32_t    overflows;      // Reports dropped because the ring was full.
+};
+
+
+/**
+ * @brief A single producer, single consumer ring of scan reports.
+ *
+ * The host task is the only writer and one application task the only reader, the positions are
+ * atomics so neither side takes a lock and the records are preallocated.  When the ring is full
+ * the new report is dropped, the records already queued are delivered in order.
+ */
+class NimBLEScanRing {
+public:
+    NimBLEScanRing(uint16_t capacity);
+
+    bool                    push(const struct ble_gap_disc_desc* disc);
+    bool                    pop(NimBLEScanReport* report);
+    const NimBLEScanReport* peek();
+    void                    consume();
+    bool                    wait(uint32_t timeoutMs);
+    size_t                  available();
+    NimBLEScanRingStats     getStats();
+
+private:
+    std::vector<NimBLEScanReport>   m_records;
+    uint32_t                        m_mask;
+    std::atomic<uint32_t>           m_head{0};              // Next record written, only changed by the producer.
+    std::atomic<uint32_t>           m_tail{0};              // Next record read, only changed by the consumer.
+    std::atomic<TaskHandle_t>       m_consumer{nullptr};    // Task blocked in wait().
+    std::atomic<uint32_t>           m_highWater{0};
+    std::atomic<uint32_t>           m_overflows{0};
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // COMPONENTS_NIMBLESCANRING_H_
@@ -0,0 +1,278 @@
+/*
+ * NimBLEScanTracker.cpp
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEScanTracker.h"
+
+#define NIMBLE_SCAN_TRACKER_WHEEL_MASK (NIMBLE_SCAN_TRACKER_WHEEL_SLOTS - 1)
+
+
+/**
+ * @brief Smooth the RSSI with an exponentially weighted moving average.
+ * @param [in] alpha The weight of a new report, between 0 and 1.
+ */
+void NimBLEScanTracker::setEWMA(float alpha) {
+    m_filter = TRACKER_RSSI_EWMA;
+    m_alpha = alpha;
+} // setEWMA
+
+
+/**
+ * @brief Smooth the RSSI with a one dimensional Kalman filter.
+ * @param [in] processNoise How much the real RSSI is expected to change between reports, in dBm².
+ * @param [in] measurementNoise The variance of the reported RSSI, in dBm².
+ */
+void NimBLEScanTracker::setKalman(float processNoise, float measurementNoise) {
+    m_filter = TRACKER_RSSI_KALMAN;
+    m_processNoise = processNoise;
+    m_measurementNoise = measurementNoise;
+} // setKalman
+
+
+/**
+ * @brief Check if presence tracking is enabled.
+ */
+bool NimBLEScanTracker::isEnabled() {
+    return m_departMs > 0;
+} // isEnabled
+
+
+/**
+ * @brief Get the time after which a device that was not seen departs, in milliseconds.
+ */
+uint32_t NimBLEScanTracker::getDepartTimeout() {
+    return m_departMs;
+} // getDepartTimeout
+
+
+/**
+ * @brief Get the period of the timeout wheel, in milliseconds.
+ */
+uint32_t NimBLEScanTracker::getTickMs() {
+    return m_tickMs;
+} // getTickMs
+
+
+/**
+ * @brief Get the presence state of a device.
+ * @param [in] pos The position of the device in the result store.
+ * @return The state or nullptr if tracking is disabled.
+ */
+const NimBLEPresence* NimBLEScanTracker::get(uint16_t pos) {
+    if(pos >= m_entries.size()) {
+        return nullptr;
+    }
+    return &m_entries[pos].info;
+} // get
+
+
+/**
+ * @brief Get the tracker counters.
+ * @return A copy of the counters.
+ */
+NimBLEScanTrackerStats NimBLEScanTracker::getStats() {
+    return m_stats;
+} // getStats
+
+
+/**
+ * @brief Reset the arrival and departure counters.
+ */
+void NimBLEScanTracker::resetStats() {
+    m_stats.arrivals = 0;
+    m_stats.departures = 0;
+} // resetStats
+
+
+/**
+ * @brief Set the departure timeout, the wheel period follows from it.
+ * @param [in] departMs The time after which a device that was not seen departs, 0 disables tracking.
+ */
+void NimBLEScanTracker::configure(uint32_t departMs) {
+    m_departMs = departMs;
+    // Keep every deadline within half a turn of the wheel.
+    m_tickMs = (departMs + NIMBLE_SCAN_TRACKER_WHEEL_SLOTS / 2 - 1) / (NIMBLE_SCAN_TRACKER_WHEEL_SLOTS / 2);
+    if(m_tickMs == 0) {
+        m_tickMs = 1;
+    }
+} // configure
+
+
+/**
+ * @brief Size the table for the result store, every device is forgotten.
+ * @param [in] numDevices The capacity of the result store.
+ */
+void NimBLEScanTracker::allocate(uint16_t numDevices) {
+    std::vector<Entry>(isEnabled() ? numDevices : 0).swap(m_entries);
+    clear();
+} // allocate
+
+
+/**
+ * @brief Record a report of a device.
+ * @param [in] pos The position of the device in the result store.
+ * @param [in] rssi The RSSI of the report.
+ * @param [in] isScanResponse True if the report is a scan response, it does not count for the interval.
+ * @param [in] now The time of the report in milliseconds since boot.
+ * @return True if the device arrived with this report.
+ */
+bool NimBLEScanTracker::update(uint16_t pos, int8_t rssi, bool isScanResponse, uint32_t now) {
+    if(pos >= m_entries.size()) {
+        return false;
+    }
+
+    Entry &entry = m_entries[pos];
+    NimBLEPresence &info = entry.info;
+    bool arrived = !info.present;
+
+    if(arrived) {
+        if(m_stats.present == 0) {
+            m_wheelTick = now / m_tickMs;
+        }
+        info = NimBLEPresence();
+        info.present = true;
+        info.firstSeen = now;
+        info.rssi = rssi;
+        info.rssiVariance = m_filter == TRACKER_RSSI_KALMAN ? m_measurementNoise : 0;
+        entry.lastAdv = now;
+        entry.slot = NIMBLE_SCAN_TRACKER_WHEEL_SLOTS;
+        m_stats.present++;
+        m_stats.arrivals++;
+    } else if(m_filter == TRACKER_RSSI_KALMAN) {
+        float variance = info.rssiVariance + m_processNoise;
+        float gain = variance / (variance + m_measurementNoise);
+        info.rssi += gain * (rssi - info.rssi);
+        info.rssiVariance = (1 - gain) * variance;
+    } else {
+        info.rssi += m_alpha * (rssi - info.rssi);
+    }
+
+    // Average the gaps between advertisements, a gap longer than the timeout is a missed device, not an interval.
+    if(!arrived && !isScanResponse) {
+        uint32_t gap = now - entry.lastAdv;
+        if(gap > 0 && gap < m_departMs) {
+            if(info.intervalMs == 0) {
+                info.intervalMs = gap;
+            } else {
+                info.intervalMs = (int32_t)info.intervalMs + ((int32_t)gap - (int32_t)info.intervalMs) / 8;
+            }
+        }
+        entry.lastAdv = now;
+    }
+
+    info.lastSeen = now;
+    info.reports++;
+
+    uint16_t slot = ((now + m_departMs) / m_tickMs) & NIMBLE_SCAN_TRACKER_WHEEL_MASK;
+    if(slot != entry.slot) {
+        unlink(pos);
+        link(pos, slot);
+    }
+
+    return arrived;
+} // update
+
+
+/**
+ * @brief Forget a device that left the result store.
+ * @param [in] pos The position of the device in the result store.
+ * @return True if the device was present.
+ */
+bool NimBLEScanTracker::remove(uint16_t pos) {
+    if(pos >= m_entries.size() || !m_entries[pos].info.present) {
+        return false;
+    }
+
+    unlink(pos);
+    m_entries[pos].info.present = false;
+    m_stats.present--;
+    m_stats.departures++;
+    return true;
+} // remove
+
+
+/**
+ * @brief Find the next device whose departure timeout expired and mark it departed.
+ * @param [in] now The current time in milliseconds since boot.
+ * @return The position + 1 of the device in the result store, 0 when no more devices are due.
+ */
+uint16_t NimBLEScanTracker::nextDeparted(uint32_t now) {
+    uint32_t nowTick = now / m_tickMs;
+
+    while(m_stats.present > 0 && (int32_t)(nowTick - m_wheelTick) >= 0) {
+        uint16_t slot = m_wheelTick & NIMBLE_SCAN_TRACKER_WHEEL_MASK;
+        for(uint16_t p = m_wheel[slot]; p != 0; p = m_entries[p - 1].next) {
+            if(now - m_entries[p - 1].info.lastSeen >= m_departMs) {
+                remove(p - 1);
+                return p;
+            }
+        }
+
+        // The deadlines of the current tick may not all have passed yet.
+        if(m_wheelTick == nowTick) {
+            break;
+        }
+        m_wheelTick++;
+    }
+
+    return 0;
+} // nextDeparted
+
+
+/**
+ * @brief Forget every device without reporting departures.
+ */
+void NimBLEScanTracker::clear() {
+    for(auto &entry : m_entries) {
+        entry.info.present = false;
+        entry.slot = NIMBLE_SCAN_TRACKER_WHEEL_SLOTS;
+    }
+    for(auto &head : m_wheel) {
+        head = 0;
+    }
+    m_stats.present = 0;
+} // clear
+
+
+/**
+ * @brief Put a device at the head of a wheel slot.
+ */
+void NimBLEScanTracker::link(uint16_t pos, uint16_t slot) {
+    Entry &entry = m_entries[pos];
+    entry.slot = slot;
+    entry.prev = 0;
+    entry.next = m_wheel[slot];
+    if(entry.next != 0) {
+        m_entries[entry.next - 1].prev = pos + 1;
+    }
+    m_wheel[slot] = pos + 1;
+} // link
+
+
+/**
+ * @brief Take a device out of its wheel slot, if it is in one.
+ */
+void NimBLEScanTracker::unlink(uint16_t pos) {
+    Entry &entry = m_entries[pos];
+    if(entry.slot >= NIMBLE_SCAN_TRACKER_WHEEL_SLOTS) {
+        return;
+    }
+
+    if(entry.prev != 0) {
+        m_entries[entry.prev - 1].next = entry.next;
+    } else {
+        m_wheel[entry.slot] = entry.next;
+    }
+    if(entry.next != 0) {
+        m_entries[entry.next - 1].prev = entry.prev;
+    }
+    entry.slot = NIMBLE_SCAN_TRACKER_WHEEL_SLOTS;
+} // unlink
+
+#endif // CONFIG_BT_ENABLED
@@ -0,0 +1,106 @@
+/*
+ * NimBLEScanTracker.h
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef COMPONENTS_NIMBLESCANTRACKER_H_
+#define COMPONENTS_NIMBLESCANTRACKER_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include <stdint.h>
+#include <vector>
+
+/// Number of slots in the departure timeout wheel, a power of 2.
+#define NIMBLE_SCAN_TRACKER_WHEEL_SLOTS 32
+
+
+/**
+ * @brief How the RSSI of the tracked devices is smoothed.
+ */
+typedef enum {
+    TRACKER_RSSI_EWMA,      // Exponentially weighted moving average.
+    TRACKER_RSSI_KALMAN,    // One dimensional Kalman filter.
+} tracker_rssi_filter;
+
+
+/**
+ * @brief The presence state of a device in the scan results.
+ */
+struct NimBLEPresence {
+    float       rssi;           // Smoothed RSSI in dBm.
+    float       rssiVariance;   // Estimate variance of the Kalman filter, 0 with the moving average.
+    uint32_t    firstSeen;      // Milliseconds since boot when the device arrived.
+    uint32_t    lastSeen;       // Milliseconds since boot of the last report.
+    uint32_t    intervalMs;     // Estimated advertising interval, 0 until two advertisements were received.
+    uint32_t    reports;        // Reports received since the device arrived.
+    bool        present;
+};
+
+
+/**
+ * @brief Counters of the presence tracker.
+ */
+struct NimBLEScanTrackerStats {
+    uint32_t    present;        // Devices currently present.
+    uint32_t    arrivals;
+    uint32_t    departures;     // Devices that timed out or were evicted from the results.
+};
+
+
+/**
+ * @brief Tracks the presence and smoothed RSSI of the devices in the scan results.
+ *
+ * The state is kept in one preallocated table indexed by the position of the device in the
+ * result store and only changed from the host task.  A device departs when it has not been
+ * seen for the departure timeout, the deadlines are kept in a timeout wheel so expiring them
+ * costs the same however many devices are tracked.
+ */
+class NimBLEScanTracker {
+public:
+    void                    setEWMA(float alpha);
+    void                    setKalman(float processNoise, float measurementNoise);
+    bool                    isEnabled();
+    uint32_t                getDepartTimeout();
+    uint32_t                getTickMs();
+    const NimBLEPresence*   get(uint16_t pos);
+    NimBLEScanTrackerStats  getStats();
+    void                    resetStats();
+
+private:
+    friend class NimBLEScan;
+
+    void                    configure(uint32_t departMs);
+    void                    allocate(uint16_t numDevices);
+    bool                    update(uint16_t pos, int8_t rssi, bool isScanResponse, uint32_t now);
+    bool                    remove(uint16_t pos);
+    uint16_t                nextDeparted(uint32_t now);
+    void                    clear();
+    void                    link(uint16_t pos, uint16_t slot);
+    void                    unlink(uint16_t pos);
+
+    struct Entry {
+        NimBLEPresence      info;
+        uint32_t            lastAdv;        // Time of the last report that was not a scan response.
+        uint16_t            next;           // Wheel slot list links, position + 1, 0 for none.
+        uint16_t            prev;
+        uint16_t            slot;
+    };
+
+    std::vector<Entry>      m_entries;
+    uint16_t                m_wheel[NIMBLE_SCAN_TRACKER_WHEEL_SLOTS] = {};
+    uint32_t                m_wheelTick = 0;    // Next tick of the wheel to expire.
+    uint32_t                m_departMs = 0;
+    uint32_t                m_tickMs = 1;
+    tracker_rssi_filter     m_filter = TRACKER_RSSI_EWMA;
+    float                   m_alpha = 0.25f;
+    float                   m_processNoise = 0.05f;
+    float                   m_measurementNoise = 4.0f;
+    NimBLEScanTrackerStats  m_stats = {};
+};
+
+#endif // CONFIG_BT_ENABLED
+#endif // COMPONENTS_NIMBLESCANTRACKER_H_
@@ -82,61 +82,16 @@ static void memrcpy(uint8_t* target, uint8_t* source, uint32_t size) {
  * ```
  *
  * This has a length of 36 characters.  We need to parse this into 16 bytes.
+ * The parsing is shared with the constexpr constructor from a string literal.
  *
  * @param [in] value The string to build a UUID from.
  */
- NimBLEUUID::NimBLEUUID(std::string value) {
-    m_valueSet = true;
-    if (value.length() == 4) {
-        m_uuid.u.type         = BLE_UUID_TYPE_16;
-        m_uuid.u16.value      = 0;
-        for(int i=0;i<value.length();){
-            uint8_t MSB = value.c_str()[i];
-            uint8_t LSB = value.c_str()[i+1];
-            
-            if(MSB > '9') MSB -= 7;
-            if(LSB > '9') LSB -= 7;
-            m_uuid.u16.value += (((MSB&0x0F) <<4) | (LSB & 0x0F))<<(2-i)*4;
-            i+=2;   
-        }
-    }
-    else if (value.length() == 8) {
-        m_uuid.u.type         = BLE_UUID_TYPE_32;
-        m_uuid.u32.value      = 0;
-        for(int i=0;i<value.length();){
-            uint8_t MSB = value.c_str()[i];
-            uint8_t LSB = value.c_str()[i+1];
-            
-            if(MSB > '9') MSB -= 7; 
-            if(LSB > '9') LSB -= 7;
-            m_uuid.u32.value += (((MSB&0x0F) <<4) | (LSB & 0x0F))<<(6-i)*4;
-            i+=2;
-        }       
-    }
-    else if (value.length() == 16) {  // how we can have 16 byte length string reprezenting 128 bit uuid??? needs to be investigated (lack of time)
-        m_uuid.u.type = BLE_UUID_TYPE_128;
-        NimBLEUtils::memrcpy(m_uuid.u128.value, (uint8_t*)value.data(), 16);
-    }
-    else if (value.length() == 36) {
-        // If the length of the string is 36 bytes then we will assume it is a long hex string in
-        // UUID format.
-        m_uuid.u.type = BLE_UUID_TYPE_128;
-        int n = 0;
-        for(int i=0;i<value.length();){
-            if(value.c_str()[i] == '-')
-                i++;
-            uint8_t MSB = value.c_str()[i];
-            uint8_t LSB = value.c_str()[i+1];
-            
-            if(MSB > '9') MSB -= 7; 
-            if(LSB > '9') LSB -= 7;
-            m_uuid.u128.value[15-n++] = ((MSB&0x0F) <<4) | (LSB & 0x0F);
-            i+=2;   
-        }
-    }
-    else {
+NimBLEUUID::NimBLEUUID(const std::string &value)
+    : NimBLEUUID(value.length() == 16 ? value.data() : skipPrefix(value.c_str()),
+                 value.length() == 16 ? 16 : value.length() - (skipPrefix(value.c_str()) - value.c_str()))
+{
+    if (!m_valueSet) {
         NIMBLE_LOGE(LOG_TAG,"ERROR: UUID value not 2, 4, 16 or 36 bytes");
-        m_valueSet = false;
     }
 } // NimBLEUUID(std::string)
 
@@ -148,7 +103,7 @@ static void memrcpy(uint8_t* target, uint8_t* source, uint32_t size) {
  * @param [in] size The size of the data.
  * @param [in] msbFirst Is the MSB first in pData memory?
  */
-NimBLEUUID::NimBLEUUID(uint8_t* pData, size_t size, bool msbFirst) {
+NimBLEUUID::NimBLEUUID(uint8_t* pData, size_t size, bool msbFirst) : NimBLEUUID() {
 /*** TODO: change this to use the Nimble function for various lenght UUIDs:
     int ble_uuid_init_from_buf(ble_uuid_any_t *uuid, const void *buf, size_t len);
 ***/
@@ -156,65 +111,36 @@ NimBLEUUID::NimBLEUUID(uint8_t* pData, size_t size, bool msbFirst) {
         NIMBLE_LOGE(LOG_TAG,"ERROR: UUID length not 16 bytes");
         return;
     }
-    m_uuid.u.type = BLE_UUID_TYPE_128;
+    native().u.type = BLE_UUID_TYPE_128;
     if (msbFirst) {
-        NimBLEUtils::memrcpy(m_uuid.u128.value, pData, 16);
+        NimBLEUtils::memrcpy(native().u128.value, pData, 16);
     } else {
-        memcpy(m_uuid.u128.value, pData, 16);
+        memcpy(native().u128.value, pData, 16);
     }
     m_valueSet = true;
 } // NimBLEUUID
 
 
-/**
- * @brief Create a UUID from the 16bit value.
- *
- * @param [in] uuid The 16bit short form UUID.
- */
-NimBLEUUID::NimBLEUUID(uint16_t uuid) {
-    m_uuid.u.type        = BLE_UUID_TYPE_16;
-    m_uuid.u16.value     = uuid;
-    m_valueSet           = true;
-} // NimBLEUUID
-
-
-/**
- * @brief Create a UUID from the 32bit value.
- *
- * @param [in] uuid The 32bit short form UUID.
- */
-NimBLEUUID::NimBLEUUID(uint32_t uuid) {
-    m_uuid.u.type        = BLE_UUID_TYPE_32;
-    m_uuid.u32.value     = uuid;
-    m_valueSet           = true;
-} // NimBLEUUID
-
-
 /**
  * @brief Create a UUID from the native UUID.
  *
  * @param [in] uuid The native UUID.
  */
  
-NimBLEUUID::NimBLEUUID(ble_uuid128_t* uuid) {
-    m_uuid.u.type        = BLE_UUID_TYPE_128;
-    memcpy(m_uuid.u128.value, uuid->value, 16);
+NimBLEUUID::NimBLEUUID(ble_uuid128_t* uuid) : NimBLEUUID() {
+    native().u.type      = BLE_UUID_TYPE_128;
+    memcpy(native().u128.value, uuid->value, 16);
     m_valueSet = true;
 } // NimBLEUUID
 
 
-NimBLEUUID::NimBLEUUID() {
-    m_valueSet = false;
-} // NimBLEUUID
-
-
 /**
  * @brief Get the number of bits in this uuid.
  * @return The number of bits in the UUID.  One of 16, 32 or 128.
  */
-uint8_t NimBLEUUID::bitSize() {
+uint8_t NimBLEUUID::bitSize() const {
     if (!m_valueSet) return 0;
-    return m_uuid.u.type;
+    return native().u.type;
 } // bitSize
 
 
@@ -224,12 +150,112 @@ uint8_t NimBLEUUID::bitSize() {
  * @param [in] uuid The UUID to compare against.
  * @return True if the UUIDs are equal and false otherwise.
  */
-bool NimBLEUUID::equals(NimBLEUUID uuid) {
-    if(ble_uuid_cmp(&m_uuid.u, &uuid.getNative()->u) == 0){
-        return true;
+bool NimBLEUUID::equals(const NimBLEUUID &uuid) const {
+    return *this == uuid;
+} // equals
+
+
+/**
+ * @brief Get the 16 or 32 bit value of a UUID, also for a 128 bit UUID built on the Bluetooth base UUID.
+ * @param [out] value The short value.
+ * @return False if the UUID has no short form.
+ */
+bool NimBLEUUID::shortValue(uint32_t* value) const {
+    // The Bluetooth base UUID 00000000-0000-1000-8000-00805f9b34fb, least significant byte first.
+    static const uint8_t base[12] = {0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00};
+    const ble_uuid_any_t &uuid = native();
+
+    switch (uuid.u.type) {
+        case BLE_UUID_TYPE_16:
+            *value = uuid.u16.value;
+            return true;
+        case BLE_UUID_TYPE_32:
+            *value = uuid.u32.value;
+            return true;
+        default:
+            if (memcmp(uuid.u128.value, base, sizeof(base)) != 0) {
+                return false;
+            }
+            *value = uuid.u128.value[12] | (uuid.u128.value[13] << 8) |
+                     (uuid.u128.value[14] << 16) | ((uint32_t)uuid.u128.value[15] << 24);
+            return true;
+    }
+} // shortValue
+
+
+/**
+ * @brief Compare two UUIDs, a 16 or 32 bit UUID equals its 128 bit form.
+ */
+bool NimBLEUUID::operator==(const NimBLEUUID &other) const {
+    if (!m_valueSet || !other.m_valueSet) {
+        return m_valueSet == other.m_valueSet;
     }
-    return false;
-}
+
+    const ble_uuid_any_t &a = native();
+    const ble_uuid_any_t &b = other.native();
+
+    // Most comparisons are between UUIDs of the same size, the 16 bit ones first.
+    if (a.u.type == b.u.type) {
+        if (a.u.type == BLE_UUID_TYPE_16) {
+            return a.u16.value == b.u16.value;
+        }
+        if (a.u.type == BLE_UUID_TYPE_32) {
+            return a.u32.value == b.u32.value;
+        }
+        return memcmp(a.u128.value, b.u128.value, 16) == 0;
+    }
+
+    uint32_t aValue, bValue;
+    return shortValue(&aValue) && other.shortValue(&bValue) && aValue == bValue;
+} // operator==
+
+
+bool NimBLEUUID::operator!=(const NimBLEUUID &other) const {
+    return !(*this == other);
+} // operator!=
+
+
+/**
+ * @brief Order UUIDs for sorted containers, consistently with operator==.
+ * Unset UUIDs come first, then the ones with a short form by value, then the other 128 bit UUIDs.
+ */
+bool NimBLEUUID::operator<(const NimBLEUUID &other) const {
+    if (!m_valueSet || !other.m_valueSet) {
+        return !m_valueSet && other.m_valueSet;
+    }
+
+    uint32_t aValue, bValue;
+    bool aShort = shortValue(&aValue);
+    bool bShort = other.shortValue(&bValue);
+
+    if (aShort != bShort) {
+        return aShort;
+    }
+    if (aShort) {
+        return aValue < bValue;
+    }
+    return memcmp(native().u128.value, other.native().u128.value, 16) < 0;
+} // operator<
+
+
+/**
+ * @brief Hash the UUID, a 16 or 32 bit UUID hashes like its 128 bit form.
+ */
+size_t NimBLEUUID::hash() const {
+    uint32_t value;
+    if (!m_valueSet) {
+        return 0;
+    }
+    if (shortValue(&value)) {
+        return value;
+    }
+
+    uint32_t hash = 2166136261UL;
+    for (int i = 0; i < 16; i++) {
+        hash = (hash ^ native().u128.value[i]) * 16777619UL;
+    }
+    return hash;
+} // hash
 
 
 /**
@@ -272,7 +298,7 @@ ble_uuid_any_t* NimBLEUUID::getNative() {
         NIMBLE_LOGD(LOG_TAG,"<< Return of un-initialized UUID!");
         return nullptr;
     }
-    return &m_uuid;
+    return &native();
 } // getNative
 
 
@@ -284,45 +310,46 @@ ble_uuid_any_t* NimBLEUUID::getNative() {
  */
 NimBLEUUID NimBLEUUID::to128() {
     // If we either don't have a value or are already a 128 bit UUID, nothing further to do.
-    if (!m_valueSet || m_uuid.u.type == BLE_UUID_TYPE_128) {
+    ble_uuid_any_t &uuid = native();
+    if (!m_valueSet || uuid.u.type == BLE_UUID_TYPE_128) {
         return *this;
     }
 
     // If we are 16 bit or 32 bit, then set the 4 bytes of the variable part of the UUID.
-    if (m_uuid.u.type == BLE_UUID_TYPE_16) {
-        uint16_t temp = m_uuid.u16.value;
-        m_uuid.u128.value[15] = 0;
-        m_uuid.u128.value[14] = 0;
-        m_uuid.u128.value[13] = (temp >> 8) & 0xff;
-        m_uuid.u128.value[12] = temp & 0xff;
+    if (uuid.u.type == BLE_UUID_TYPE_16) {
+        uint16_t temp = uuid.u16.value;
+        uuid.u128.value[15] = 0;
+        uuid.u128.value[14] = 0;
+        uuid.u128.value[13] = (temp >> 8) & 0xff;
+        uuid.u128.value[12] = temp & 0xff;
 
     }
-    else if (m_uuid.u.type == BLE_UUID_TYPE_32) {
-        uint32_t temp = m_uuid.u32.value;
-        m_uuid.u128.value[15] = (temp >> 24) & 0xff;
-        m_uuid.u128.value[14] = (temp >> 16) & 0xff;
-        m_uuid.u128.value[13] = (temp >> 8) & 0xff;
-        m_uuid.u128.value[12] = temp & 0xff;
+    else if (uuid.u.type == BLE_UUID_TYPE_32) {
+        uint32_t temp = uuid.u32.value;
+        uuid.u128.value[15] = (temp >> 24) & 0xff;
+        uuid.u128.value[14] = (temp >> 16) & 0xff;
+        uuid.u128.value[13] = (temp >> 8) & 0xff;
+        uuid.u128.value[12] = temp & 0xff;
     }
 
     // Set the fixed parts of the UUID.
-    m_uuid.u128.value[11] = 0x00;
-    m_uuid.u128.value[10] = 0x00;
+    uuid.u128.value[11] = 0x00;
+    uuid.u128.value[10] = 0x00;
 
-    m_uuid.u128.value[9]  = 0x10;
-    m_uuid.u128.value[8]  = 0x00;
+    uuid.u128.value[9]  = 0x10;
+    uuid.u128.value[8]  = 0x00;
 
-    m_uuid.u128.value[7]  = 0x80;
-    m_uuid.u128.value[6]  = 0x00;
+    uuid.u128.value[7]  = 0x80;
+    uuid.u128.value[6]  = 0x00;
 
-    m_uuid.u128.value[5]  = 0x00;
-    m_uuid.u128.value[4]  = 0x80;
-    m_uuid.u128.value[3]  = 0x5f;
-    m_uuid.u128.value[2]  = 0x9b;
-    m_uuid.u128.value[1]  = 0x34;
-    m_uuid.u128.value[0]  = 0xfb;
+    uuid.u128.value[5]  = 0x00;
+    uuid.u128.value[4]  = 0x80;
+    uuid.u128.value[3]  = 0x5f;
+    uuid.u128.value[2]  = 0x9b;
+    uuid.u128.value[1]  = 0x34;
+    uuid.u128.value[0]  = 0xfb;
 
-    m_uuid.u.type = BLE_UUID_TYPE_128;
+    uuid.u.type = BLE_UUID_TYPE_128;
     return *this;
 } // to128
 
@@ -337,12 +364,23 @@ NimBLEUUID NimBLEUUID::to128() {
  *
  * @return A string representation of the UUID.
  */
-std::string NimBLEUUID::toString() {
-    if (!m_valueSet) return "<NULL>";   // If we have no value, nothing to format.
-
+std::string NimBLEUUID::toString() const {
     char buf[BLE_UUID_STR_LEN];
+    return toString(buf);
+} // toString
+
 
-    return ble_uuid_to_str(&m_uuid.u, buf);
+/**
+ * @brief Format the UUID into a caller buffer, without allocating.
+ * @param [out] buf A buffer of at least BLE_UUID_STR_LEN bytes.
+ * @return buf, holding "<NULL>" if the UUID has no value.
+ */
+char* NimBLEUUID::toString(char* buf) const {
+    if (!m_valueSet) {   // If we have no value, nothing to format.
+        strcpy(buf, "<NULL>");
+        return buf;
+    }
+    return ble_uuid_to_str(&native().u, buf);
 } // toString
 
 #endif /* CONFIG_BT_ENABLED */
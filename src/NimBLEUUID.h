@@ -20,29 +20,108 @@
 #include "host/ble_uuid.h"
 
 #include <string>
+#include <functional>
+
+static_assert(sizeof(ble_uuid_any_t) == 20, "NimBLEUUID expects the layout of ble_uuid_any_t");
 
 /**
  * @brief A model of a %BLE UUID.
+ *
+ * The UUID is stored as a ble_uuid_any_t so it can be given to the host as is, the
+ * constructors from a value or a string literal are constexpr, e.g.
+ * `constexpr NimBLEUUID uuid("beb5483e-36e1-4688-b7f5-ea07361b26a8");`
  */
 class NimBLEUUID {
 public:
-    NimBLEUUID(std::string uuid);
-    NimBLEUUID(uint16_t uuid);
-    NimBLEUUID(uint32_t uuid);
+    /**
+     * @brief Create a UUID from a hex string of 4, 8 or 36 characters, with an optional 0x prefix,
+     * or from 16 raw bytes, most significant first.
+     */
+    constexpr NimBLEUUID(const char* uuid)
+        : NimBLEUUID(skipPrefix(uuid), strLength(skipPrefix(uuid), 0)) {}
+    NimBLEUUID(const std::string &uuid);
+    /**
+     * @brief Create a UUID from the 16bit value.
+     */
+    constexpr NimBLEUUID(uint16_t uuid)
+        : m_uuid{.u16 = {{BLE_UUID_TYPE_16}, uuid}}, m_valueSet(true) {}
+    /**
+     * @brief Create a UUID from the 32bit value.
+     */
+    constexpr NimBLEUUID(uint32_t uuid)
+        : m_uuid{.u32 = {{BLE_UUID_TYPE_32}, uuid}}, m_valueSet(true) {}
     NimBLEUUID(ble_uuid128_t* uuid);
     NimBLEUUID(uint8_t* pData, size_t size, bool msbFirst);
 //  BLEUUID(esp_gatt_id_t gattId);
-    NimBLEUUID();
-    uint8_t        bitSize();   // Get the number of bits in this uuid.
-    bool           equals(NimBLEUUID uuid);
+    constexpr NimBLEUUID() : m_uuid{}, m_valueSet(false) {}
+    uint8_t        bitSize() const;   // Get the number of bits in this uuid.
+    bool           equals(const NimBLEUUID &uuid) const;
     ble_uuid_any_t* getNative();
+    size_t         hash() const;
     NimBLEUUID        to128();
-    std::string    toString();
+    std::string    toString() const;
+    char*          toString(char* buf) const;
     static NimBLEUUID fromString(std::string uuid);  // Create a NimBLEUUID from a string
 
+    bool           operator==(const NimBLEUUID &other) const;
+    bool           operator!=(const NimBLEUUID &other) const;
+    bool           operator<(const NimBLEUUID &other) const;
+
 private:
-    ble_uuid_any_t m_uuid;              // The underlying UUID structure that this class wraps.
-    bool           m_valueSet = false;   // Is there a value set for this instance.
+    // A string may hold a 16, 32 or 128 bit UUID but a constexpr constructor can only initialize one
+    // member of the union, the bytes are written through u128 in the layout of the actual type.
+    constexpr NimBLEUUID(const char* uuid, size_t len)
+        : m_uuid{.u128 = {{rawByte(uuid, len, 0)},
+                 {rawByte(uuid, len, 1),  rawByte(uuid, len, 2),  rawByte(uuid, len, 3),  rawByte(uuid, len, 4),
+                  rawByte(uuid, len, 5),  rawByte(uuid, len, 6),  rawByte(uuid, len, 7),  rawByte(uuid, len, 8),
+                  rawByte(uuid, len, 9),  rawByte(uuid, len, 10), rawByte(uuid, len, 11), rawByte(uuid, len, 12),
+                  rawByte(uuid, len, 13), rawByte(uuid, len, 14), rawByte(uuid, len, 15), rawByte(uuid, len, 16)}}},
+          m_valueSet(len == 4 || len == 8 || len == 16 || len == 36) {}
+
+    static constexpr const char* skipPrefix(const char* s) {
+        return (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) ? s + 2 : s;
+    }
+    static constexpr size_t strLength(const char* s, size_t n) {
+        return s[n] == '\0' ? n : strLength(s, n + 1);
+    }
+    static constexpr uint8_t hexNibble(char c) {
+        return (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+               (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 0;
+    }
+    static constexpr uint8_t hexByte(const char* s, size_t pos) {
+        return (uint8_t)((hexNibble(s[pos]) << 4) | hexNibble(s[pos + 1]));
+    }
+    // Position in a 36 character UUID string of byte n, counted from the most significant.
+    static constexpr size_t strPos(size_t n) {
+        return 2 * n + (n >= 4) + (n >= 6) + (n >= 8) + (n >= 10);
+    }
+    // Byte i of the ble_uuid_any_t layout for a string of length len.
+    static constexpr uint8_t rawByte(const char* s, size_t len, size_t i) {
+        return len == 4  ? (i == 0 ? BLE_UUID_TYPE_16 : i == 2 ? hexByte(s, 2) : i == 3 ? hexByte(s, 0) : 0) :
+               len == 8  ? (i == 0 ? BLE_UUID_TYPE_32 : (i >= 4 && i < 8) ? hexByte(s, 2 * (7 - i)) : 0) :
+               len == 16 ? (i == 0 ? BLE_UUID_TYPE_128 : (i >= 1 && i <= 16) ? (uint8_t)s[16 - i] : 0) :
+               len == 36 ? (i == 0 ? BLE_UUID_TYPE_128 : (i >= 1 && i <= 16) ? hexByte(s, strPos(16 - i)) : 0) :
+               0;
+    }
+
+    ble_uuid_any_t&       native() { return m_uuid; }
+    const ble_uuid_any_t& native() const { return m_uuid; }
+    bool           shortValue(uint32_t* value) const;
+
+    ble_uuid_any_t m_uuid;              // The underlying ble_uuid_any_t that this class wraps.
+    bool           m_valueSet;          // Is there a value set for this instance.
 }; // NimBLEUUID
+
+
+namespace std {
+/**
+ * @brief Hash of a UUID for the unordered containers.
+ */
+template<> struct hash<NimBLEUUID> {
+    size_t operator()(const NimBLEUUID &uuid) const {
+        return uuid.hash();
+    }
+};
+}
 #endif /* CONFIG_BT_ENABLED */
 #endif /* COMPONENTS_NIMBLEUUID_H_ */
@@ -0,0 +1,93 @@
+/*
+ * NimBLEUUIDMap.h
+ *
+ *  Created: on Oct 16 2026
+ *      Author H2zero
+ *
+ */
+
+#ifndef COMPONENTS_NIMBLEUUIDMAP_H_
+#define COMPONENTS_NIMBLEUUIDMAP_H_
+#include "sdkconfig.h"
+#if defined(CONFIG_BT_ENABLED)
+
+#include "NimBLEUUID.h"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+
+/**
+ * @brief A compact map keyed by UUID, stored as a vector sorted by UUID.
+ *
+ * Lookups are a binary search on the UUID values, nothing is formatted or allocated.
+ * Like std::map an insert keeps the existing entry when the UUID is already present, and the
+ * entries are iterated in UUID order as pairs with first the UUID and second the value.
+ * Inserting invalidates the iterators.
+ */
+template<typename T>
+class NimBLEUUIDMap {
+public:
+    typedef std::pair<NimBLEUUID, T>                            value_type;
+    typedef typename std::vector<value_type>::iterator          iterator;
+    typedef typename std::vector<value_type>::const_iterator    const_iterator;
+
+    iterator        begin()         { return m_entries.begin(); }
+    iterator        end()           { return m_entries.end(); }
+    const_iterator  begin() const   { return m_entries.begin(); }
+    const_iterator  end() const     { return m_entries.end(); }
+    size_t          size() const    { return m_entries.size(); }
+    bool            empty() const   { return m_entries.empty(); }
+    void            clear()         { m_entries.clear(); }
+    void            reserve(size_t count) { m_entries.reserve(count); }
+
+    /**
+     * @brief Find the entry of a UUID.
+     * @return An iterator to the entry or end() if the UUID is not in the map.
+     */
+    iterator find(const NimBLEUUID &uuid) {
+        iterator it = lowerBound(uuid);
+        return (it != m_entries.end() && it->first == uuid) ? it : m_entries.end();
+    }
+
+    /**
+     * @brief Insert an entry at its sorted position unless its UUID is already present.
+     * @return The entry of the UUID and true if it was inserted.
+     */
+    std::pair<iterator, bool> insert(const value_type &entry) {
+        iterator it = lowerBound(entry.first);
+        if(it != m_entries.end() && it->first == entry.first) {
+            return std::make_pair(it, false);
+        }
+        return std::make_pair(m_entries.insert(it, entry), true);
+    }
+
+    /**
+     * @brief Remove the entry of a UUID.
+     * @return The number of entries removed.
+     */
+    size_t erase(const NimBLEUUID &uuid) {
+        iterator it = find(uuid);
+        if(it == m_entries.end()) {
+            return 0;
+        }
+        m_entries.erase(it);
+        return 1;
+    }
+
+    iterator erase(iterator it) { return m_entries.erase(it); }
+
+private:
+    iterator lowerBound(const NimBLEUUID &uuid) {
+        return std::lower_bound(m_entries.begin(), m_entries.end(), uuid,
+                                [](const value_type &entry, const NimBLEUUID &key) {
+                                    return entry.first < key;
+                                });
+    }
+
+    std::vector<value_type> m_entries;
+};
+
+#endif /* CONFIG_BT_ENABLED */
+#endif /* COMPONENTS_NIMBLEUUIDMAP_H_ */
@@ -57,6 +57,70 @@ void NimBLEUtils::memrcpy(uint8_t* target, uint8_t* source, uint32_t size) {
 } // memrcpy
 
 
+/**
+ * @brief Walk the AD structures of an advertising payload.
+ *
+ * Each structure has the format: [length][type][data...], the length includes the type.
+ * A structure with a length of 0 is padding and is skipped, a truncated structure ends the walk.
+ *
+ * @param [in] payload The advertising data.
+ * @param [in] length The length of the advertising data.
+ * @param [in,out] pos The offset of the next structure, start with 0.
+ * @param [out] type The AD type of the structure.
+ * @param [out] fieldLength The length of the structure data.
+ * @return A pointer to the structure data or nullptr when there are no more.
+ */
+const uint8_t* NimBLEUtils::nextAdvField(const uint8_t* payload, size_t length, size_t* pos,
+                                         uint8_t* type, uint8_t* fieldLength)
+{
+    while(*pos < length) {
+        uint8_t len = payload[*pos];
+        if(len == 0) {
+            (*pos)++;
+            continue;
+        }
+
+        if(*pos + 1 + len > length) {
+            break;
+        }
+
+        const uint8_t* data = &payload[*pos + 2];
+        *type = payload[*pos + 1];
+        *fieldLength = len - 1;
+        *pos += 1 + len;
+        return data;
+    }
+
+    *pos = length;
+    return nullptr;
+} // nextAdvField
+
+
+/**
+ * @brief Find the first AD structure of a type in an advertising payload.
+ * @param [in] payload The advertising data.
+ * @param [in] length The length of the advertising data.
+ * @param [in] type The AD type to look for.
+ * @param [out] fieldLength The length of the structure data.
+ * @return A pointer to the structure data or nullptr if not present.
+ */
+const uint8_t* NimBLEUtils::findAdvField(const uint8_t* payload, size_t length, uint8_t type,
+                                         uint8_t* fieldLength)
+{
+    size_t pos = 0;
+    uint8_t fieldType;
+    const uint8_t* data;
+
+    while((data = nextAdvField(payload, length, &pos, &fieldType, fieldLength)) != nullptr) {
+        if(fieldType == type) {
+            return data;
+        }
+    }
+
+    return nullptr;
+} // findAdvField
+
+
 const char* NimBLEUtils::returnCodeToString(int rc) {
     switch(rc) {
         case BLE_HS_EAGAIN:
@@ -29,6 +29,10 @@ public:
     static const char*          advTypeToString(uint8_t advType);
     static const char*          returnCodeToString(int rc);
     static void                 memrcpy(uint8_t* target, uint8_t* source, uint32_t size);
+    static const uint8_t*       nextAdvField(const uint8_t* payload, size_t length, size_t* pos,
+                                             uint8_t* type, uint8_t* fieldLength);
+    static const uint8_t*       findAdvField(const uint8_t* payload, size_t length, uint8_t type,
+                                             uint8_t* fieldLength);
 };
 
 
@@ -42,8 +42,12 @@
 
 /*** nimble */
 #ifndef MYNEWT_VAL_BLE_EXT_ADV
+#ifdef CONFIG_BT_NIMBLE_EXT_ADV
+#define MYNEWT_VAL_BLE_EXT_ADV (1)
+#else
 #define MYNEWT_VAL_BLE_EXT_ADV (0)
 #endif
+#endif
 
 #ifndef MYNEWT_VAL_BLE_EXT_ADV_MAX_SIZE
 #define MYNEWT_VAL_BLE_EXT_ADV_MAX_SIZE (31)
@@ -610,6 +614,18 @@
 #endif
 #endif
 
+#ifndef MYNEWT_VAL_BLE_STORE_GATT_CACHE
+#if defined(CONFIG_BT_NIMBLE_GATT_CACHE) && CONFIG_BT_NIMBLE_GATT_CACHE
+#define MYNEWT_VAL_BLE_STORE_GATT_CACHE (1)
+#else
+#define MYNEWT_VAL_BLE_STORE_GATT_CACHE (0)
+#endif
+#endif
+
+#ifndef MYNEWT_VAL_BLE_STORE_GATT_CACHE_DIR
+#define MYNEWT_VAL_BLE_STORE_GATT_CACHE_DIR ("/tmp")
+#endif
+
 /*** nimble/host/services/ans */
 #ifndef MYNEWT_VAL_BLE_SVC_ANS_NEW_ALERT_CAT
 #define MYNEWT_VAL_BLE_SVC_ANS_NEW_ALERT_CAT (0)
@@ -179,6 +179,13 @@ typedef void ble_hs_reset_fn(int reason);
 /** @brief Stack sync callback */
 typedef void ble_hs_sync_fn(void);
 
+/** @brief ACL transmit complete callback
+ *
+ * @param conn_handle Connection the packets were sent on
+ * @param num_pkts Number of packets the controller has completed
+ */
+typedef void ble_hs_tx_cmpl_fn(uint16_t conn_handle, uint16_t num_pkts);
+
 /** @brief Bluetooth Host main configuration structure
  *
  * Those can be used by application to configure stack.
@@ -257,6 +264,14 @@ struct ble_hs_cfg {
      */
     ble_hs_sync_fn *sync_cb;
 
+    /** @brief ACL transmit complete callback
+     *
+     * This callback is executed in the host task when the controller reports
+     * completed packets for a connection (Number Of Completed Packets event),
+     * i.e. when controller buffers are freed and more data can be queued.
+     */
+    ble_hs_tx_cmpl_fn *tx_cmpl_cb;
+
     /* XXX: These need to go away. Instead, the nimble host package should
      * require the host-store API (not yet implemented)..
      */
@@ -255,6 +255,10 @@ ble_hs_hci_evt_num_completed_pkts(uint8_t event_code, uint8_t *data,
                 ble_hs_hci_add_avail_pkts(num_pkts);
             }
             ble_hs_unlock();
+
+            if (conn != NULL && ble_hs_cfg.tx_cmpl_cb != NULL) {
+                ble_hs_cfg.tx_cmpl_cb(handle, num_pkts);
+            }
         }
     }
 
@@ -0,0 +1,252 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Persistent storage of discovered GATT databases.
+ *
+ * Each peer identity address owns a single opaque blob written by the GATT
+ * client.  On ESP32 the blobs live in their own NVS namespace next to the
+ * bonding information kept by ble_store_nvs.c; on other platforms (Linux
+ * test builds) each blob is a file in MYNEWT_VAL(BLE_STORE_GATT_CACHE_DIR).
+ */
+
+#include "syscfg/syscfg.h"
+
+#if MYNEWT_VAL(BLE_STORE_GATT_CACHE)
+
+#include <stdio.h>
+#include <string.h>
+#include "host/ble_hs.h"
+#include "store/config/ble_store_config.h"
+
+#define NIMBLE_GATT_CACHE_KEY_MAX_LEN           16
+#define NIMBLE_GATT_CACHE_NAMESPACE             "nimble_gattc"
+
+/*****************************************************************************
+ * $ MISC                                                                    *
+ *****************************************************************************/
+
+/* Key format: "g<type><addr>" e.g. "g0a4cf12345678", at most 14 characters
+ * so it fits within the NVS key length limit.
+ */
+static void
+get_gatt_cache_key_string(const ble_addr_t *peer_addr, char *key_string)
+{
+    sprintf(key_string, "g%x%02x%02x%02x%02x%02x%02x", peer_addr->type,
+            peer_addr->val[5], peer_addr->val[4], peer_addr->val[3],
+            peer_addr->val[2], peer_addr->val[1], peer_addr->val[0]);
+}
+
+#if defined(ESP_PLATFORM)
+
+#include "esp_log.h"
+#include "nvs.h"
+
+typedef uint32_t nvs_handle_t;
+
+static const char *TAG = "NIMBLE_GATT_CACHE";
+
+/*****************************************************************************
+ * $ NVS                                                                     *
+ *****************************************************************************/
+
+int
+ble_store_gatt_cache_read(const ble_addr_t *peer_addr, void *buf,
+                          size_t *len)
+{
+    char key_string[NIMBLE_GATT_CACHE_KEY_MAX_LEN];
+    nvs_handle_t nimble_handle;
+    esp_err_t err;
+
+    get_gatt_cache_key_string(peer_addr, key_string);
+
+    err = nvs_open(NIMBLE_GATT_CACHE_NAMESPACE, NVS_READWRITE, &nimble_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS open operation failed");
+        return BLE_HS_ESTORE_FAIL;
+    }
+
+    err = nvs_get_blob(nimble_handle, key_string, buf, len);
+    nvs_close(nimble_handle);
+
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return BLE_HS_ENOENT;
+    }
+
+    return (err == ESP_OK) ? 0 : BLE_HS_ESTORE_FAIL;
+}
+
+int
+ble_store_gatt_cache_write(const ble_addr_t *peer_addr, const void *buf,
+                           size_t len)
+{
+    char key_string[NIMBLE_GATT_CACHE_KEY_MAX_LEN];
+    nvs_handle_t nimble_handle;
+    esp_err_t err;
+
+    get_gatt_cache_key_string(peer_addr, key_string);
+
+    err = nvs_open(NIMBLE_GATT_CACHE_NAMESPACE, NVS_READWRITE, &nimble_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS open operation failed !!");
+        return BLE_HS_ESTORE_FAIL;
+    }
+
+    err = nvs_set_blob(nimble_handle, key_string, buf, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS write operation failed !!");
+        goto error;
+    }
+
+    err = nvs_commit(nimble_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS commit operation failed !!");
+        goto error;
+    }
+
+    nvs_close(nimble_handle);
+    return 0;
+error:
+    nvs_close(nimble_handle);
+    return (err == ESP_ERR_NVS_NOT_ENOUGH_SPACE) ? BLE_HS_ESTORE_CAP :
+                                                  BLE_HS_ESTORE_FAIL;
+}
+
+int
+ble_store_gatt_cache_delete(const ble_addr_t *peer_addr)
+{
+    char key_string[NIMBLE_GATT_CACHE_KEY_MAX_LEN];
+    nvs_handle_t nimble_handle;
+    esp_err_t err;
+
+    get_gatt_cache_key_string(peer_addr, key_string);
+
+    err = nvs_open(NIMBLE_GATT_CACHE_NAMESPACE, NVS_READWRITE, &nimble_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS open operation failed !!");
+        return BLE_HS_ESTORE_FAIL;
+    }
+
+    err = nvs_erase_key(nimble_handle, key_string);
+    if (err == ESP_OK) {
+        err = nvs_commit(nimble_handle);
+    }
+    nvs_close(nimble_handle);
+
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return BLE_HS_ENOENT;
+    }
+
+    return (err == ESP_OK) ? 0 : BLE_HS_ESTORE_FAIL;
+}
+
+#else
+
+/*****************************************************************************
+ * $ FILE                                                                    *
+ *****************************************************************************/
+
+static void
+get_gatt_cache_path(const ble_addr_t *peer_addr, char *path, size_t size)
+{
+    char key_string[NIMBLE_GATT_CACHE_KEY_MAX_LEN];
+
+    get_gatt_cache_key_string(peer_addr, key_string);
+    snprintf(path, size, "%s/%s.bin", MYNEWT_VAL(BLE_STORE_GATT_CACHE_DIR),
+             key_string);
+}
+
+int
+ble_store_gatt_cache_read(const ble_addr_t *peer_addr, void *buf,
+                          size_t *len)
+{
+    char path[256];
+    FILE *fp;
+    long size;
+    int rc;
+
+    get_gatt_cache_path(peer_addr, path, sizeof path);
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return BLE_HS_ENOENT;
+    }
+
+    rc = BLE_HS_ESTORE_FAIL;
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0) {
+        goto end;
+    }
+
+    if (buf == NULL) {
+        *len = size;
+        rc = 0;
+        goto end;
+    }
+
+    if ((size_t)size > *len) {
+        rc = BLE_HS_EMSGSIZE;
+        goto end;
+    }
+
+    rewind(fp);
+    if (fread(buf, 1, size, fp) == (size_t)size) {
+        *len = size;
+        rc = 0;
+    }
+
+end:
+    fclose(fp);
+    return rc;
+}
+
+int
+ble_store_gatt_cache_write(const ble_addr_t *peer_addr, const void *buf,
+                           size_t len)
+{
+    char path[256];
+    FILE *fp;
+    int rc;
+
+    get_gatt_cache_path(peer_addr, path, sizeof path);
+
+    fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return BLE_HS_ESTORE_FAIL;
+    }
+
+    rc = (fwrite(buf, 1, len, fp) == len) ? 0 : BLE_HS_ESTORE_FAIL;
+    if (fclose(fp) != 0) {
+        rc = BLE_HS_ESTORE_FAIL;
+    }
+
+    return rc;
+}
+
+int
+ble_store_gatt_cache_delete(const ble_addr_t *peer_addr)
+{
+    char path[256];
+
+    get_gatt_cache_path(peer_addr, path, sizeof path);
+
+    return (remove(path) == 0) ? 0 : BLE_HS_ENOENT;
+}
+
+#endif /* ESP_PLATFORM */
+
+#endif /* MYNEWT_VAL(BLE_STORE_GATT_CACHE) */
@@ -26,6 +26,8 @@
 #define CONFIG_BT_NIMBLE_ROLE_BROADCASTER 1
 #define CONFIG_BT_NIMBLE_ROLE_OBSERVER 1
 #define CONFIG_BT_NIMBLE_NVS_PERSIST 1
+#define CONFIG_BT_NIMBLE_GATT_CACHE 0
+#define CONFIG_BT_NIMBLE_MAX_SCAN_RESULTS 64
 #define CONFIG_BT_NIMBLE_SM_LEGACY 1
 #define CONFIG_BT_NIMBLE_SM_SC 1
 #define CONFIG_BT_NIMBLE_SVC_GAP_DEVICE_NAME "nimble"
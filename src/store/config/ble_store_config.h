@@ -20,6 +20,9 @@
 #ifndef H_BLE_STORE_CONFIG_
 #define H_BLE_STORE_CONFIG_
 
+#include <stddef.h>
+#include "nimble/ble.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -34,6 +37,13 @@ int ble_store_config_delete(int obj_type, const union ble_store_key *key);
 
 void ble_store_config_init(void);
 
+/* Discovered GATT database cache, one opaque blob per peer identity. */
+int ble_store_gatt_cache_read(const ble_addr_t *peer_addr, void *buf,
+                              size_t *len);
+int ble_store_gatt_cache_write(const ble_addr_t *peer_addr, const void *buf,
+                               size_t len);
+int ble_store_gatt_cache_delete(const ble_addr_t *peer_addr);
+
 #ifdef __cplusplus
 }
 #endif